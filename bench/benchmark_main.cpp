@@ -0,0 +1,444 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// Per-stage microbenchmarks on synthetic frames.
+// Every stage of EulerianMotionMag::process() is timed in isolation for each
+// resolution / pyramid depth combination and reported as JSON lines or CSV:
+//   frames/s, ns/pixel and logical bytes moved (bytes read + bytes written by the stage)
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "eulerian_motion_mag.h"
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+struct Resolution
+{
+    const char* name;
+    int width;
+    int height;
+};
+
+const Resolution kResolutions[] =
+{
+    {"480p", 640, 480},
+    {"720p", 1280, 720},
+    {"1080p", 1920, 1080},
+    {"4k", 3840, 2160},
+};
+
+struct StageResult
+{
+    std::string stage;
+    double ns_per_frame;
+    double bytes_per_frame;
+};
+
+// Mean time of one call in nsec, after one untimed warm-up call
+template <typename Fn>
+double timeStage(int iterations, Fn fn)
+{
+    fn();
+    Timer timer;
+    for (int i = 0; i < iterations; ++i)
+        fn();
+    return timer.getTimeNanoSec() / iterations;
+}
+
+double pyramidPixels(const std::vector<cv::Mat>& pyramid, int first, int last)
+{
+    double pixels = 0;
+    for (int l = first; l <= last; ++l)
+        pixels += pyramid[l].total();
+    return pixels;
+}
+
+class Report
+{
+ public:
+    Report(std::ostream& out, bool csv)
+        : out_(out)
+        , csv_(csv)
+    {
+        if (csv_)
+            out_ << "stage,resolution,width,height,levels,iterations,ns_per_frame,fps,ns_per_pixel,bytes_per_frame,gb_per_s"
+                 << std::endl;
+    }
+
+    void add(const Resolution& res, int levels, int iterations, const StageResult& r)
+    {
+        const double pixels = static_cast<double>(res.width) * res.height;
+        const double fps = 1e9 / r.ns_per_frame;
+        const double ns_per_pixel = r.ns_per_frame / pixels;
+        const double gb_per_s = r.bytes_per_frame / r.ns_per_frame;
+
+        if (csv_)
+        {
+            out_ << r.stage << "," << res.name << "," << res.width << "," << res.height << "," << levels << ","
+                 << iterations << "," << r.ns_per_frame << "," << fps << "," << ns_per_pixel << ","
+                 << r.bytes_per_frame << "," << gb_per_s << std::endl;
+        }
+        else
+        {
+            out_ << "{\"stage\": \"" << r.stage << "\", \"resolution\": \"" << res.name << "\", \"width\": " << res.width
+                 << ", \"height\": " << res.height << ", \"levels\": " << levels << ", \"iterations\": " << iterations
+                 << ", \"ns_per_frame\": " << r.ns_per_frame << ", \"fps\": " << fps << ", \"ns_per_pixel\": " << ns_per_pixel
+                 << ", \"bytes_per_frame\": " << r.bytes_per_frame << ", \"gb_per_s\": " << gb_per_s << "}" << std::endl;
+        }
+    }
+
+ private:
+    std::ostream& out_;
+    bool csv_;
+};
+
+void benchmarkConfig(const Resolution& res, int levels, int iterations, bool fast_pyramid, bool fused_kernel,
+                     Report& report)
+{
+    const cv::Size size(res.width, res.height);
+    const double pixels = size.area();
+    const double px_f32 = 3 * sizeof(float);    // bytes per CV_32FC3 pixel
+    const double px_s16 = 3 * sizeof(int16_t);  // bytes per CV_16SC3 pixel
+    const double px_u8 = 3;                     // bytes per CV_8UC3 pixel
+
+    MotionMagConfig config;
+    config.levels = levels;
+    config.fast_pyramid = fast_pyramid;
+    config.fused_kernel = fused_kernel;
+    EulerianMotionMag motion_mag;
+    if (!motion_mag.init(config, size))
+        return;
+
+    // Synthetic frame, pushed twice so that the filter state is initialized
+    cv::Mat frame(size, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(256));
+    cv::Mat output;
+    motion_mag.process(frame, output);
+    motion_mag.process(frame, output);
+
+    cv::Mat lab, motion, attenuated, bgr;
+    std::vector<cv::Mat> pyramid;
+    motion_mag.convertInputColor(frame, lab);
+    motion_mag.buildLaplacianPyramid(lab, levels, pyramid);
+
+    std::vector<cv::Mat> filtered(levels + 1);
+    std::vector<cv::Mat> amplified(levels + 1);
+    std::vector<cv::Mat> lowpass_1(levels + 1);
+    std::vector<cv::Mat> lowpass_2(levels + 1);
+    for (int l = 0; l <= levels; ++l)
+    {
+        filtered[l] = pyramid[l].clone();
+        lowpass_1[l] = pyramid[l].clone();
+        lowpass_2[l] = pyramid[l].clone();
+    }
+
+    const double band_pixels = pyramidPixels(pyramid, 0, levels - 1);
+
+    // Only the bands with non-zero gain keep temporal filter state
+    const std::vector<cv::Mat>& state = motion_mag.getLowpassState1();
+    double state_pixels = 0;
+    for (int l = 0; l < levels; ++l)
+        state_pixels += state[l].total();
+    const double all_pixels = pyramidPixels(pyramid, 0, levels);
+    const float chrom_scale[3] = {1.0f, 0.1f, 0.1f};
+
+    std::vector<StageResult> results;
+    StageResult r;
+
+    r.stage = "color_in";
+    r.ns_per_frame = timeStage(iterations, [&]() { motion_mag.convertInputColor(frame, lab); });
+    r.bytes_per_frame = pixels * (px_u8 + px_f32);
+    results.push_back(r);
+
+    cv::Mat color;
+    r.stage = "color_in_fused_lab";
+    r.ns_per_frame = timeStage(iterations, [&]() { convertBGR8ToLab(frame, color); });
+    results.push_back(r);
+
+    r.stage = "color_in_yiq";
+    r.ns_per_frame = timeStage(iterations, [&]() { convertBGR8ToYIQ(frame, color); });
+    results.push_back(r);
+
+    // Each level reads its source and writes the residual and the downsampled image
+    r.stage = "pyramid_build";
+    r.ns_per_frame = timeStage(iterations, [&]() { motion_mag.buildLaplacianPyramid(lab, levels, pyramid); });
+    r.bytes_per_frame = band_pixels * px_f32 * 2.25;
+    results.push_back(r);
+
+    // src, lowpass_1 and lowpass_2 read, both lowpass states and dst written
+    r.stage = "temporal_filter";
+    r.ns_per_frame = timeStage(iterations, [&]()
+    {
+        for (int l = 0; l < levels; ++l)
+            if (!state[l].empty())
+                motion_mag.temporalIIRFilter(pyramid[l], filtered[l], l);
+    });  // NOLINT [whitespace/braces]
+    r.bytes_per_frame = state_pixels * px_f32 * 6;
+    results.push_back(r);
+
+    // Sliding DFT over 32 frames, 0.4 - 3 Hz at 30 fps, on the same levels as the IIR.
+    // Per level: src and the oldest sample read, the sample and every bin (re, im)
+    // read and written, dst written; plus the same again for the rows refreshed.
+    int bin_low = 0;
+    int bin_high = 0;
+    SlidingDFTFilter::getBandBins(32, 30.0, 0.4, 3.0, bin_low, bin_high);
+    const int num_bins = bin_high - bin_low + 1;
+    std::vector<SlidingDFTFilter> sdft(levels, SlidingDFTFilter(32, bin_low, bin_high));
+    for (int l = 0; l < levels; ++l)
+        if (!state[l].empty())
+            sdft[l].init(pyramid[l]);
+
+    r.stage = "sdft_temporal_filter";
+    r.ns_per_frame = timeStage(iterations, [&]()
+    {
+        for (int l = 0; l < levels; ++l)
+            if (!state[l].empty())
+                sdft[l].apply(pyramid[l], filtered[l]);
+    });  // NOLINT [whitespace/braces]
+    r.bytes_per_frame = state_pixels * px_f32 * (3 + 4 * num_bins) * 2;
+    results.push_back(r);
+
+    r.stage = "amplify";
+    r.ns_per_frame = timeStage(iterations, [&]()
+    {
+        for (int l = 0; l <= levels; ++l)
+            motion_mag.amplify(filtered[l], amplified[l], l);
+    });  // NOLINT [whitespace/braces]
+    r.bytes_per_frame = all_pixels * px_f32 * 2;
+    results.push_back(r);
+
+    // int16 precision: levels, bands and states all fixed-point
+    std::vector<cv::Mat> fixed_levels(levels + 1);
+    std::vector<cv::Mat> fixed_filtered(levels + 1);
+    std::vector<cv::Mat> fixed_1(levels + 1);
+    std::vector<cv::Mat> fixed_2(levels + 1);
+    for (int l = 0; l <= levels; ++l)
+    {
+        pyramid[l].convertTo(fixed_levels[l], CV_16S, IIR_FIXED_POINT_SCALE);
+        fixed_levels[l].copyTo(fixed_1[l]);
+        fixed_levels[l].copyTo(fixed_2[l]);
+    }
+
+    r.stage = "fused_temporal_amplify_int16";
+    r.ns_per_frame = timeStage(iterations, [&]()
+    {
+        for (int l = 0; l < levels; ++l)
+            fusedTemporalAmplifyFixed(fixed_levels[l], fixed_1[l], fixed_2[l], fixed_filtered[l], 0.4f, 0.05f, 10.0f,
+                                      chrom_scale, 0);
+    });  // NOLINT [whitespace/braces]
+    r.bytes_per_frame = band_pixels * px_s16 * 6;
+    results.push_back(r);
+
+    r.stage = "fused_temporal_amplify";
+    r.ns_per_frame = timeStage(iterations, [&]()
+    {
+        for (int l = 0; l < levels; ++l)
+            fusedTemporalAmplify(pyramid[l], lowpass_1[l], lowpass_2[l], filtered[l], 0.4f, 0.05f, 10.0f, chrom_scale);
+    });  // NOLINT [whitespace/braces]
+    r.bytes_per_frame = band_pixels * px_f32 * 6;
+    results.push_back(r);
+
+    // Each level reads the coarser image and the band, and writes the sum
+    r.stage = "pyramid_reconstruct";
+    r.ns_per_frame = timeStage(iterations, [&]() { motion_mag.reconImgFromLaplacianPyramid(amplified, levels, motion); });
+    r.bytes_per_frame = band_pixels * px_f32 * 2.25;
+    results.push_back(r);
+
+    r.stage = "attenuate";
+    r.ns_per_frame = timeStage(iterations, [&]() { motion_mag.attenuate(motion, attenuated); });
+    r.bytes_per_frame = pixels * px_f32 * 2;
+    results.push_back(r);
+
+    r.stage = "color_out";
+    r.ns_per_frame = timeStage(iterations, [&]() { motion_mag.convertOutputColor(lab, bgr); });
+    r.bytes_per_frame = pixels * (px_f32 + px_u8);
+    results.push_back(r);
+
+    r.stage = "color_out_fused_lab";
+    r.ns_per_frame = timeStage(iterations, [&]() { convertLabToBGR8(lab, bgr); });
+    results.push_back(r);
+
+    convertBGR8ToYIQ(frame, color);
+    r.stage = "color_out_yiq";
+    r.ns_per_frame = timeStage(iterations, [&]() { convertYIQToBGR8(color, bgr); });
+    results.push_back(r);
+
+    // Direct output: color in, level 1 motion upsampled and added, color out, in one pass
+    const float direct_scale[3] = {1.0f, 0.1f, 0.1f};
+    MotionCompositor compositor;
+    r.stage = "composite_direct_lab";
+    r.ns_per_frame = timeStage(iterations, [&]() { compositor.compositeLab(frame, pyramid[1], 1, size, direct_scale, bgr); });
+    r.bytes_per_frame = pixels * (px_u8 * 2 + px_f32 / 4);
+    results.push_back(r);
+
+    r.stage = "composite_direct_yiq";
+    r.ns_per_frame = timeStage(iterations, [&]() { compositor.compositeYIQ(frame, pyramid[1], 1, size, direct_scale, bgr); });
+    results.push_back(r);
+
+    r.stage = "process_frame";
+    r.ns_per_frame = timeStage(iterations, [&]() { motion_mag.process(frame, output); });
+    r.bytes_per_frame = pixels * px_u8 * 2;
+    results.push_back(r);
+
+    // 1.5x output size (as test_baby.param), with the final resize and composited directly
+    for (int direct = 0; direct < 2; ++direct)
+    {
+        MotionMagConfig upscaled_config = config;
+        upscaled_config.output_width = size.width * 3 / 2;
+        upscaled_config.output_height = size.height * 3 / 2;
+        upscaled_config.direct_output = (direct != 0);
+        EulerianMotionMag upscaled;
+        if (!upscaled.init(upscaled_config, size))
+            continue;
+        upscaled.process(frame, output);
+
+        r.stage = direct ? "process_frame_upscaled_direct" : "process_frame_upscaled";
+        r.ns_per_frame = timeStage(iterations, [&]() { upscaled.process(frame, output); });
+        r.bytes_per_frame = pixels * px_u8 * (1 + 2.25);
+        results.push_back(r);
+    }
+
+    // Motion estimated at half resolution, composited onto the full frame
+    MotionMagConfig half_config = config;
+    half_config.motion_scale = 0.5;
+    EulerianMotionMag half;
+    if (levels > 1 && half.init(half_config, size))
+    {
+        half.process(frame, output);
+
+        r.stage = "process_frame_motion_half";
+        r.ns_per_frame = timeStage(iterations, [&]() { half.process(frame, output); });
+        r.bytes_per_frame = pixels * px_u8 * 2;
+        results.push_back(r);
+    }
+
+    // Pyramid, temporal filter and reconstruction on the luma channel only
+    MotionMagConfig luma_config = config;
+    luma_config.luma_only = true;
+    EulerianMotionMag luma;
+    if (luma.init(luma_config, size))
+    {
+        luma.process(frame, output);
+
+        r.stage = "process_frame_luma";
+        r.ns_per_frame = timeStage(iterations, [&]() { luma.process(frame, output); });
+        r.bytes_per_frame = pixels * px_u8 * 2;
+        results.push_back(r);
+    }
+
+    for (size_t i = 0; i < results.size(); ++i)
+        report.add(res, levels, iterations, results[i]);
+}
+
+// Fused Lab kernels against convertTo + cvtColor, on a random frame and on a
+// perturbed Lab image (as after amplification, partly out of gamut)
+void checkColorKernels(const Resolution& res, std::ostream& out)
+{
+    const cv::Size size(res.width, res.height);
+    cv::Mat frame(size, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(256));
+
+    cv::Mat frame_float, lab_ref, lab_fused;
+    frame.convertTo(frame_float, CV_32FC3, 1.0 / 255.0f);
+    cv::cvtColor(frame_float, lab_ref, CV_BGR2Lab);
+    convertBGR8ToLab(frame, lab_fused);
+
+    cv::Mat noise(size, CV_32FC3);
+    cv::randu(noise, cv::Scalar::all(-20), cv::Scalar::all(20));
+    cv::Mat lab_amplified = lab_ref + noise;
+
+    cv::Mat bgr_float, bgr_ref, bgr_fused;
+    cv::cvtColor(lab_amplified, bgr_float, CV_Lab2BGR);
+    bgr_float.convertTo(bgr_ref, CV_8UC3, 255.0, 1.0 / 255.0);
+    convertLabToBGR8(lab_amplified, bgr_fused);
+
+    cv::Mat diff;
+    cv::absdiff(bgr_ref, bgr_fused, diff);
+    out << "color check " << res.name << ": Lab max abs deviation " << cv::norm(lab_ref, lab_fused, cv::NORM_INF)
+        << ", BGR max abs deviation " << cv::norm(diff, cv::NORM_INF) << " (" << cv::countNonZero(diff.reshape(1))
+        << " of " << diff.total() * 3 << " values differ)" << std::endl;
+}
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    std::string format;
+    std::string output_filename;
+    std::string resolutions;
+    int min_levels;
+    int max_levels;
+    int iterations;
+    bool fast_pyramid;
+    bool fused_kernel;
+    bool check_color;
+
+    po::options_description desc("Eulerian-Motion-Magnification benchmarks");
+    desc.add_options()
+        ("help,h", "produce help message")
+        ("format", po::value<std::string>(&format)->default_value( "json" ), "json (one object per line) or csv")  // NOLINT [whitespace/parens]
+        ("output", po::value<std::string>(&output_filename)->default_value( "" ), "output file (default stdout)")  // NOLINT [whitespace/parens]
+        ("resolutions", po::value<std::string>(&resolutions)->default_value( "480p,720p,1080p,4k" ))  // NOLINT [whitespace/parens]
+        ("min_levels", po::value<int>(&min_levels)->default_value( 3 ))  // NOLINT [whitespace/parens]
+        ("max_levels", po::value<int>(&max_levels)->default_value( 8 ))  // NOLINT [whitespace/parens]
+        ("iterations", po::value<int>(&iterations)->default_value( 10 ))  // NOLINT [whitespace/parens]
+        ("fast_pyramid", po::value<bool>(&fast_pyramid)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("fused_kernel", po::value<bool>(&fused_kernel)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("check_color", po::value<bool>(&check_color)->default_value( false ), "compare the fused color kernels with cvtColor (stderr)")  // NOLINT [whitespace/parens]
+    ;  // NOLINT [whitespace/semicolon]
+    po::variables_map vm;
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+    po::notify(vm);
+
+    if (vm.count("help"))
+    {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    std::ofstream file;
+    if (!output_filename.empty())
+    {
+        file.open(output_filename.c_str());
+        if (!file.is_open())
+        {
+            std::cerr << "Error: Unable to open output file: " << output_filename << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = output_filename.empty() ? std::cout : file;
+
+    Report report(out, format == "csv");
+    const std::string selected = "," + resolutions + ",";
+    for (size_t r = 0; r < sizeof(kResolutions) / sizeof(kResolutions[0]); ++r)
+    {
+        if (selected.find("," + std::string(kResolutions[r].name) + ",") == std::string::npos)
+            continue;
+
+        if (check_color)
+            checkColorKernels(kResolutions[r], std::cerr);
+        for (int levels = min_levels; levels <= max_levels; ++levels)
+            benchmarkConfig(kResolutions[r], levels, iterations, fast_pyramid, fused_kernel, report);
+    }
+
+    return 0;
+}
@@ -0,0 +1,125 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef BATCH_SCHEDULER_H_
+#define BATCH_SCHEDULER_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>  // NOLINT [build/c++11]
+#include <streambuf>
+#include <string>
+#include <thread>  // NOLINT [build/c++11]
+#include <vector>
+
+// One clip of a batch. run(num_threads) processes the whole clip and returns
+// the number of frames processed, or -1 on failure. num_threads is the job's
+// share of the cores for its intra-frame (OpenMP) threads; the scheduler raises
+// it while the job runs when other workers go idle, so read it every frame.
+struct BatchJob
+{
+    std::string name;
+    double cost;  // relative amount of work, larger jobs are started first
+    std::function<int(const std::atomic<int>& num_threads)> run;
+};
+
+struct BatchJobResult
+{
+    std::string name;
+    bool ok;
+    int frames;
+    double seconds;
+    int threads;      // share when the job started
+    int threads_end;  // and when it finished
+    int worker;
+};
+
+// Line-serializing stream buffer for concurrent jobs: every thread collects its
+// own line and writes it out whole, prefixed with the name of the job the
+// thread runs (setThreadPrefix()). Threads without a prefix, e.g. those a job
+// starts itself, write their lines unprefixed.
+class BatchLogBuffer : public std::streambuf
+{
+ public:
+    explicit BatchLogBuffer(std::streambuf* target);
+    virtual ~BatchLogBuffer();
+
+    static void setThreadPrefix(const std::string& prefix);
+
+ protected:
+    virtual int overflow(int c);
+    virtual std::streamsize xsputn(const char* s, std::streamsize n);
+
+ private:
+    std::streambuf* target_;
+    std::map<std::thread::id, std::string> lines_;  // unfinished line per thread
+    std::mutex lock_;
+};
+
+// Runs a batch of jobs on num_workers threads that share num_threads cores.
+//
+// Jobs are sorted by cost and dealt round-robin onto per-worker deques. A worker
+// takes from the front of its own deque and, once that is empty, steals from the
+// back of the fullest other deque, so long clips start early and short ones fill
+// the gaps. The cores are split evenly between the busy workers, and split again
+// whenever a worker runs out of jobs, so the tail of the batch (fewer clips than
+// workers) uses the idle cores inside the frame instead.
+//
+// OpenCV's own thread pool is process wide, not per job: setRebalanceCallback()
+// is called with the new per-job share after every split, so that the caller can
+// set cv::setNumThreads() to it. Every running job then gets the same count.
+class BatchScheduler
+{
+ public:
+    BatchScheduler(int num_workers, int num_threads);
+
+    void add(const BatchJob& job);
+    void setRebalanceCallback(const std::function<void(int num_threads)>& callback) { rebalance_ = callback; }
+
+    // Blocks until every job has finished. std::cout and std::cerr go through a
+    // BatchLogBuffer meanwhile, each line prefixed with the job name.
+    void run();
+
+    const std::vector<BatchJobResult>& getResults() const { return results_; }
+    double getWallMilliSec() const { return wall_ms_; }
+
+    // Per-job throughput and the batch totals
+    void printReport(std::ostream& out) const;
+
+ private:
+    bool takeJob(int worker, size_t& job);
+    void finishWorker(int worker);
+    void rebalance();
+    void workerLoop(int worker);
+
+ private:
+    int num_workers_;
+    int num_threads_;
+    std::vector<BatchJob> jobs_;
+    std::vector<BatchJobResult> results_;
+    std::function<void(int)> rebalance_;
+
+    // Jobs are whole clips, so one lock around the deques is never contended
+    std::vector<std::deque<size_t> > queues_;
+    std::mutex queue_lock_;
+    std::vector<bool> busy_;
+    std::unique_ptr<std::atomic<int>[]> worker_threads_;  // current share per worker
+
+    double wall_ms_;
+};
+
+#endif  // BATCH_SCHEDULER_H_
@@ -17,118 +17,244 @@
 #include <math.h>
 #include <omp.h>
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <vector>
 
 #include <opencv2/core/core.hpp>
-#include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "color_kernels.h"
+#include "laplacian_pyramid.h"
+#include "motion_kernels.h"
+#include "stage_profiler.h"
+#include "temporal_filter.h"
 #include "timer.h"
 
-class EulerianMotionMag
+// Processing parameters of EulerianMotionMag, fixed by init()
+struct MotionMagConfig
 {
- public:
-    EulerianMotionMag();
-    ~EulerianMotionMag();
+    MotionMagConfig();
 
-    bool init();
-    void run();
+    // Processing size (0 = the frame size) and output size (0 = the processing size)
+    int input_width;
+    int input_height;
+    int output_width;
+    int output_height;
 
- private:
-    int getCodecNumber(std::string file_name);
-    cv::Mat LaplacianPyr(cv::Mat img);
-    bool buildLaplacianPyramid(const cv::Mat& img, const int levels, std::vector<cv::Mat>& pyramid);
-    void reconImgFromLaplacianPyramid(const std::vector<cv::Mat>& pyramid, const int levels, cv::Mat& dst);
-    void temporalIIRFilter(const cv::Mat& src, cv::Mat& dst, int level);
-    void amplify(const cv::Mat& src, cv::Mat& dst, int level);
-    void attenuate(cv::Mat& src, cv::Mat& dst);
+    // Gains and spatial bands
+    double alpha;
+    double lambda_c;
+    double chrom_attenuation;
+    double exaggeration_factor;
+    int levels;
+
+    // "iir" (lowpass difference, cutoff_freq_*) or "sdft" (sliding DFT ideal bandpass, freq_band_*
+    // in Hz at input_fps)
+    std::string temporal_filter;
+    double cutoff_freq_low;
+    double cutoff_freq_high;
+    int sdft_window;
+    double freq_band_low;
+    double freq_band_high;
+    double input_fps;
+
+    // Kernels: fused temporal kernel, separable pyramid engine and single pass Lab
+    // conversions instead of convertTo + cvtColor (yiq always uses them)
+    bool fused_kernel;
+    bool fast_pyramid;
+    bool fused_color;
+
+    // "float" or "int16": Laplacian levels, filtered bands and IIR lowpass states in
+    // 16-bit fixed point (Q8.7, see laplacian_pyramid.h and motion_kernels.h), half
+    // the bytes of each amplified level; implies fused_kernel and fast_pyramid
+    std::string precision;
+
+    // Working color space: "lab" or "yiq" (see color_kernels.h)
+    std::string color_space;
+
+    // Decompose, filter and reconstruct the L (Y) channel only. The chroma of the
+    // source frame passes through unchanged, as with chrom_attenuation = 0, and the
+    // pyramid, temporal filter and reconstruction do a third of the work.
+    bool luma_only;
+
+    // Composite the source frame and the motion image (upsampled on the fly from
+    // pyramid level 1) straight at the output size, instead of at the processing
+    // size followed by a resize. Without a source frame (processBands() on a
+    // replayed pyramid) the regular path is used.
+    bool direct_output;
+
+    // Estimate the motion on a 1/2, 1/4, ... copy of the input frame (and one pyramid
+    // level less per halving) and composite it onto the full resolution frame. Level 0
+    // is never amplified at full resolution, so the motion loses no detail.
+    double motion_scale;
+
+    // OpenMP threads used inside a frame, 0 keeps the OpenMP default. A shared count
+    // (owned by the batch scheduler) is read at every frame and overrides num_threads.
+    int num_threads;
+    const std::atomic<int>* shared_num_threads;
 
+    // Every band is filtered at unit gain and without chroma attenuation, for
+    // reading the bandpassed signal from getFilteredPyramid() (analysis)
+    bool unit_gain;
+
+    // Frame size the per-level gains are derived from (default: the processing size
+    // before motion_scale), so that a crop gets the gains of the full frame
+    cv::Size gain_size;
+};
+
+// Frame in, frame out: EulerianMotionMag, or several of them on crops (RoiProcessor)
+class FrameProcessor
+{
  public:
-    const std::string& getInputFileName() const { return input_file_name_; }
-    void setInputFileName(const std::string& inputFileName) { input_file_name_ = inputFileName; }
+    virtual ~FrameProcessor() {}
 
-    int getInputImgWidth() const { return input_img_width_; }
-    void setInputImgWidth(int width) { input_img_width_ = width; }
+    // input is any CV_8UC3 BGR frame of the size given to init, output is a caller
+    // owned buffer that gets (re)allocated only if it does not already have the
+    // output size and type
+    virtual void process(const cv::Mat& input, cv::Mat& output) = 0;
 
-    int getInputImgHeight() const { return input_img_height_; }
-    void setInputImgHeight(int height) { input_img_height_ = height; }
+    // Advances the temporal filter by input without producing an output frame
+    // (no reconstruction or color conversion back), for frames that are dropped
+    virtual void skip(const cv::Mat& input) = 0;
 
-    const std::string& getOutputFileName() const { return output_file_name_; }
-    void setOutputFileName(const std::string& outputFileName) { output_file_name_ = outputFileName; }
+    // The next frame re-initializes the temporal filter state
+    virtual void reset() = 0;
 
-    int getOutputImgWidth() const { return output_img_width_; }
-    void setOutputImgWidth(int width) { output_img_width_ = width; }
+    // Motion image of the last frame (empty if there is no full frame one)
+    virtual const cv::Mat& getMotionImage() const = 0;
 
-    int getOutputImgHeight() const { return output_img_height_; }
-    void setOutputImgHeight(int height) { output_img_height_ = height; }
+    // Size of the frames process() writes
+    virtual cv::Size getOutputSize() const = 0;
+};
 
-    double getAlpha() const { return alpha_; }
-    void setAlpha(double alpha) { alpha_ = alpha; }
+// The magnification itself: init() once with the size of the frames that will be
+// passed in, then process() one frame at a time. Reading and writing video, the
+// display and the run modes are built on top of it (see run_modes.h).
+class EulerianMotionMag : public FrameProcessor
+{
+ public:
+    EulerianMotionMag();
 
-    double getChromAttenuation() const { return chrom_attenuation_; }
-    void setChromAttenuation(double chromAttenuation) { chrom_attenuation_ = chromAttenuation; }
+    // Validates config, sizes the workspace and resets the filter state.
+    // getConfig() returns it as resolved for frame_size (sizes, and levels and
+    // kernels adjusted for motion_scale, precision and the temporal filter).
+    bool init(const MotionMagConfig& config, const cv::Size& frame_size);
+    const MotionMagConfig& getConfig() const { return config_; }
 
-    double getCutoffFreqHigh() const { return cutoff_freq_high_; }
-    void setCutoffFreqHigh(double cutoffFreqHigh) { cutoff_freq_high_ = cutoffFreqHigh; }
+    void process(const cv::Mat& input, cv::Mat& output);
+    void skip(const cv::Mat& input);
+    void reset();
 
-    double getCutoffFreqLow() const { return cutoff_freq_low_; }
-    void setCutoffFreqLow(double cutoffFreqLow) { cutoff_freq_low_ = cutoffFreqLow; }
+    // process() in parts, for pyramids that are shared or replayed: decompose()
+    // converts and decomposes input into getInputImage() / getLaplacianPyramid()
+    // (the bands set in bands, NULL for the amplified ones). processBands() filters,
+    // amplifies and reconstructs a decomposed frame; source is the frame that was
+    // decomposed (for direct output), or NULL. filterBands() only advances the filter.
+    void decompose(const cv::Mat& input, const std::vector<bool>* bands = NULL);
+    void processBands(const cv::Mat& image, const std::vector<cv::Mat>& pyramid, const cv::Mat* source,
+                      cv::Mat& output);
+    void filterBands(const std::vector<cv::Mat>& pyramid);
 
-    double getDelta() const { return delta_; }
-    void setDelta(double delta) { delta_ = delta; }
+    // Applies num_threads / shared_num_threads to the calling thread. process() and
+    // skip() do it themselves, callers of the split-up stages once per frame.
+    void setFrameThreads() const;
 
-    double getExaggerationFactor() const { return exaggeration_factor_; }
-    void setExaggerationFactor(double exaggerationFactor) { exaggeration_factor_ = exaggerationFactor; }
+    // Bands with a non-zero gain, the ones the filter keeps state for
+    const std::vector<bool>& getActiveBands() const { return band_active_; }
 
-    double getLambda() const { return lambda_; }
-    void setLambda(double lambda) { lambda_ = lambda; }
+    // Filter state (valid after process()). With int16 precision the pyramid, the
+    // lowpass states and the filtered bands are CV_16SC3 fixed-point
+    // (PYR_FIXED_POINT_SHIFT, the same as IIR_FIXED_POINT_SHIFT). Bands with zero
+    // gain are not computed by process() and hold no state. With direct output
+    // the motion image is at pyramid level 1 size. In luma only mode the pyramid,
+    // state and motion image have one channel.
+    int getFrameNum() const { return frame_num_; }
+    const cv::Mat& getInputImage() const { return img_input_lab_; }
+    const std::vector<cv::Mat>& getLaplacianPyramid() const { return img_vec_lap_pyramid_; }
+    const std::vector<cv::Mat>& getLowpassState1() const { return img_vec_lowpass_1_; }
+    const std::vector<cv::Mat>& getLowpassState2() const { return img_vec_lowpass_2_; }
+    const std::vector<cv::Mat>& getFilteredPyramid() const { return img_vec_filtered_; }
+    const cv::Mat& getMotionImage() const { return img_motion_; }
+    cv::Size getOutputSize() const { return cv::Size(config_.output_width, config_.output_height); }
 
-    double getLambdaC() const { return lambda_c_; }
-    void setLambdaC(double lambdaC) { lambda_c_ = lambdaC; }
+#ifdef EMM_ENABLE_PROFILER
+    StageProfiler& getProfiler() { return profiler_; }
+    const StageProfiler& getProfiler() const { return profiler_; }
+#endif
 
-    int getLapPyramidLevels() const { return lap_pyramid_levels_; }
-    void setLapPyramidLevels(int lapPyramidLevels) { lap_pyramid_levels_ = lapPyramidLevels; }
+    // Individual pipeline stages, in the order process() runs them. Exposed so that
+    // they can be driven and timed separately (see bench/). The temporal stages
+    // operate on the filter state, so process() must have run at least once;
+    // temporalIIRFilter() runs the level's TemporalFilter (the sdft one if selected).
+    void convertInputColor(const cv::Mat& src, cv::Mat& dst);
+    bool buildLaplacianPyramid(const cv::Mat& img, const int levels, std::vector<cv::Mat>& pyramid);
+    void temporalIIRFilter(const cv::Mat& src, cv::Mat& dst, int level);
+    void amplify(const cv::Mat& src, cv::Mat& dst, int level);
+    void reconImgFromLaplacianPyramid(const std::vector<cv::Mat>& pyramid, const int levels, cv::Mat& dst);
+    void attenuate(cv::Mat& src, cv::Mat& dst);
+    void convertOutputColor(const cv::Mat& src, cv::Mat& dst);
 
  private:
-    std::string input_file_name_;
-    std::string output_file_name_;
-
-    int input_img_width_;
-    int input_img_height_;
-    cv::VideoCapture* input_cap_;
+    void filterLevels(const std::vector<cv::Mat>& pyramid);
+    void compositeOutput(const cv::Mat& source, int motion_level, cv::Mat& output);
+    void initBandState(const std::vector<cv::Mat>& pyramid);
+    bool initMotionScale();
+    void reportSlidingDFTMemory() const;
+    void allocateWorkspace();
+    cv::Mat LaplacianPyr(cv::Mat img);
+    double getLevelAlpha(int level) const;
+    double computeLevelAlpha(int level) const;
+    void resetLevelParams();
+    void buildBandPlan();
+    bool buildPyramidBands(const cv::Mat& img, const int levels, const std::vector<bool>* bands,
+                           std::vector<cv::Mat>& pyramid);
+    void reconBands(const std::vector<cv::Mat>& pyramid, const int top, const int bottom,
+                    const std::vector<bool>* bands, cv::Mat& dst);
+    int getBandChannels() const;
+    int getStateType() const;
+    int getLevelType() const;  // of the pyramid and the filtered bands
 
-    int output_img_width_;
-    int output_img_height_;
-    cv::VideoWriter* output_cap_;
-    bool write_output_file_;
+    MotionMagConfig config_;
 
+    // Frame workspace, allocated once in init()
     cv::Mat img_input_;
+    cv::Mat img_input_float_;
     cv::Mat img_input_lab_;
+    cv::Mat img_input_luma_;  // first channel of img_input_lab_, luma only mode
     cv::Mat img_spatial_filter_;
     cv::Mat img_motion_;
+    cv::Mat img_output_float_;
     cv::Mat img_motion_mag_;
+    cv::Mat img_output_source_;  // source frame at output size, direct output only
+    cv::Mat img_output_bgr_float_;  // direct output through cvtColor (fused_color off)
+    cv::Mat img_output_lab_;
+    std::vector<cv::Mat> img_vec_pyr_down_;
+    std::vector<cv::Mat> img_vec_pyr_up_;
+    std::vector<cv::Size> level_sizes_;  // scratch of reconBands()
     std::vector<cv::Mat> img_vec_lap_pyramid_;
     std::vector<cv::Mat> img_vec_lowpass_1_;
     std::vector<cv::Mat> img_vec_lowpass_2_;
     std::vector<cv::Mat> img_vec_filtered_;
 
-    int lap_pyramid_levels_;
-    double cutoff_freq_low_;
-    double cutoff_freq_high_;
-    double lambda_c_;
-    double alpha_;
-    double chrom_attenuation_;
-    double exaggeration_factor_;
     double delta_;
     double lambda_;
+    LaplacianPyramidEngine pyramid_engine_;
+#ifdef EMM_ENABLE_PROFILER
+    StageProfiler profiler_;
+#endif
+    MotionCompositor compositor_;
+    int motion_level_offset_;  // full resolution pyramid level of level 0, from motion_scale
+
+    // Band plan: per-level gains and the levels where they are non-zero
+    std::vector<double> level_alpha_;
+    std::vector<bool> band_active_;
+    int band_coarsest_;
 
-    Timer timer_;
-    double loop_time_ms_;
+    std::vector<cv::Ptr<TemporalFilter> > temporal_filters_;  // per level, NULL for bands without gain
     int frame_num_;
-    int frame_count_;
-    double input_fps_;
 };
 
 #endif  // EULERIAN_MOTION_MAG_H_
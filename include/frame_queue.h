@@ -0,0 +1,148 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef FRAME_QUEUE_H_
+#define FRAME_QUEUE_H_
+
+#include <atomic>
+#include <thread>  // NOLINT [build/c++11]
+#include <vector>
+
+#include "timer.h"
+
+// Bounded lock-free single-producer / single-consumer queue.
+// Used to connect the stages of the pipelined run loop. Blocking push/pop
+// spin (with yield) and account the time spent waiting as stall time.
+template <typename T>
+class FrameQueue
+{
+ public:
+    explicit FrameQueue(size_t capacity)
+        : buffer_(capacity + 1)
+        , head_(0)
+        , tail_(0)
+        , push_stall_ns_(0)
+        , depth_sum_(0)
+        , depth_samples_(0)
+        , depth_max_(0)
+        , pop_stall_ns_(0)
+    {
+    }
+
+    // Producer side
+    inline bool tryPush(const T& item)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        const size_t next = increment(tail);
+        if (next == head_.load(std::memory_order_acquire))
+            return false;  // full
+
+        buffer_[tail] = item;
+        tail_.store(next, std::memory_order_release);
+        sampleDepth();
+        return true;
+    }
+
+    // Consumer side
+    inline bool tryPop(T& item)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == tail_.load(std::memory_order_acquire))
+            return false;  // empty
+
+        item = buffer_[head];
+        head_.store(increment(head), std::memory_order_release);
+        return true;
+    }
+
+    // Blocking push. Gives up and returns false once abort is set.
+    bool push(const T& item, const std::atomic<bool>& abort)
+    {
+        if (tryPush(item))
+            return true;
+
+        Timer stall;
+        while (!tryPush(item))
+        {
+            if (abort.load(std::memory_order_relaxed))
+                return false;
+            std::this_thread::yield();
+        }
+        push_stall_ns_ += stall.getTimeNanoSec();
+        return true;
+    }
+
+    // Blocking pop. Gives up and returns false once abort is set.
+    bool pop(T& item, const std::atomic<bool>& abort)
+    {
+        if (tryPop(item))
+            return true;
+
+        Timer stall;
+        while (!tryPop(item))
+        {
+            if (abort.load(std::memory_order_relaxed))
+                return false;
+            std::this_thread::yield();
+        }
+        pop_stall_ns_ += stall.getTimeNanoSec();
+        return true;
+    }
+
+    size_t size() const
+    {
+        const size_t head = head_.load(std::memory_order_acquire);
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        return (tail + buffer_.size() - head) % buffer_.size();
+    }
+
+    size_t capacity() const { return buffer_.size() - 1; }
+
+    // Stats (read after both sides have finished)
+    double getPushStallMilliSec() const { return push_stall_ns_ / 1e6; }
+    double getPopStallMilliSec() const { return pop_stall_ns_ / 1e6; }
+    double getAverageDepth() const { return depth_samples_ ? static_cast<double>(depth_sum_) / depth_samples_ : 0; }
+    size_t getMaxDepth() const { return depth_max_; }
+
+ private:
+    inline size_t increment(size_t idx) const
+    {
+        return (idx + 1) % buffer_.size();
+    }
+
+    // Called by the producer only
+    inline void sampleDepth()
+    {
+        size_t depth = size();
+        depth_sum_ += depth;
+        depth_samples_++;
+        if (depth > depth_max_)
+            depth_max_ = depth;
+    }
+
+ private:
+    std::vector<T> buffer_;
+    std::atomic<size_t> head_;
+    std::atomic<size_t> tail_;
+
+    // Producer owned
+    double push_stall_ns_;
+    size_t depth_sum_;
+    size_t depth_samples_;
+    size_t depth_max_;
+
+    // Consumer owned
+    double pop_stall_ns_;
+};
+
+#endif  // FRAME_QUEUE_H_
@@ -0,0 +1,129 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef FRAME_STREAM_H_
+#define FRAME_STREAM_H_
+
+#include <stdio.h>
+#include <sys/types.h>
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Uncompressed frame streams, so that the tool can sit between other processes
+// (ffmpeg, gstreamer) without a decode / encode hop of its own.
+//   STREAM_Y4M : YUV4MPEG2, 4:2:0 8-bit. Size and frame rate are in the header.
+//   STREAM_BGR : bare BGR24 frames, size and frame rate have to be given.
+//   STREAM_SYNTHETIC : generated test clip (input only), see FrameStreamReader::open().
+// The path "-" is stdin / stdout, anything else is a file or a named pipe.
+enum FrameStreamFormat
+{
+    STREAM_Y4M,
+    STREAM_BGR,
+    STREAM_SYNTHETIC
+};
+
+// format is "y4m", "bgr", "synthetic", "video" (cv::VideoCapture / cv::VideoWriter)
+// or empty for auto: "-" and *.y4m are Y4M streams, *.bgr raw BGR, "synthetic:..."
+// a synthetic clip, everything else is a video file.
+// Returns false for an unknown format, is_stream tells whether path is a stream.
+bool getFrameStreamFormat(const std::string& path, const std::string& format, bool& is_stream,
+                          FrameStreamFormat& stream_format);
+
+class FrameStreamReader
+{
+ public:
+    FrameStreamReader();
+    ~FrameStreamReader();
+
+    // Y4M reads size and frame rate from the stream header, raw BGR uses size and fps.
+    // A synthetic clip is "synthetic[:<freq Hz>[:<amplitude px>[:<frames>]]]" (default
+    // 1 Hz, 1 px, 300 frames) at size (640x480 if empty) and fps: a textured
+    // background with a disc whose radius oscillates sinusoidally. The frames only
+    // depend on these parameters, so the clip can serve as a reference input.
+    bool open(const std::string& path, FrameStreamFormat format, const cv::Size& size, double fps);
+    void close();
+
+    // Reads the next frame as CV_8UC3 BGR. Raw BGR is read straight into frame,
+    // which is only reallocated if it does not have the stream size already.
+    // Returns false (and leaves frame empty) at the end of the stream.
+    bool read(cv::Mat& frame);
+
+    // Positions the stream so that the next read() returns frame (0 based).
+    // Synthetic clips go by frame index, raw BGR files by byte offset and Y4M
+    // files skip over the frame payloads. stdin and named pipes can not seek.
+    bool seek(int frame);
+
+    const cv::Size& getSize() const { return size_; }
+    double getFps() const { return fps_; }
+    int getFrameCount() const { return frame_count_; }  // 0 if unknown (stdin, pipes)
+
+ private:
+    bool readHeader();
+    bool skipFrame(off_t end);
+    int countFrames();
+    bool readBytes(cv::Mat& mat);
+    bool openSynthetic(const std::string& path);
+    void renderSynthetic(cv::Mat& frame) const;
+
+ private:
+    FILE* file_;
+    bool owns_file_;
+    bool seekable_;  // regular file, frames can be counted and seeked
+    FrameStreamFormat format_;
+    cv::Size size_;
+    double fps_;
+    cv::Mat planar_;  // one I420 frame
+    std::vector<char> buffer_;
+    int frame_count_;
+    int frame_index_;
+    off_t data_offset_;  // first frame of a file
+
+    // synthetic clip
+    double synthetic_freq_;
+    double synthetic_amplitude_;
+};
+
+class FrameStreamWriter
+{
+ public:
+    FrameStreamWriter();
+    ~FrameStreamWriter();
+
+    // Writing to stdout ("-") moves the process' own stdout to stderr, see reserveStdout()
+    bool open(const std::string& path, FrameStreamFormat format, const cv::Size& size, double fps);
+    void close();
+
+    // frame is CV_8UC3 BGR of the stream size
+    bool write(const cv::Mat& frame);
+
+    // Takes stdout over for the frame stream: returns a private descriptor of it
+    // and points stdout at stderr, so that log output can not end up between the
+    // frames. Call it before printing anything when the stream goes to stdout.
+    // Only the first call redirects, later calls return the same descriptor.
+    static int reserveStdout();
+
+ private:
+    bool writeBytes(const cv::Mat& mat);
+
+ private:
+    FILE* file_;
+    FrameStreamFormat format_;
+    cv::Size size_;
+    cv::Mat planar_;
+    std::vector<char> buffer_;
+};
+
+#endif  // FRAME_STREAM_H_
@@ -0,0 +1,108 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef LAPLACIAN_PYRAMID_H_
+#define LAPLACIAN_PYRAMID_H_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Fixed-point format of CV_16S pyramid levels (Q8.7, the format of the reduced
+// precision IIR state and of the pyramid cache): value = stored / 2^shift.
+#define PYR_FIXED_POINT_SHIFT 7
+#define PYR_FIXED_POINT_SCALE (1 << PYR_FIXED_POINT_SHIFT)
+
+// Separable 5-tap (1 4 6 4 1) Laplacian pyramid engine for CV_32F images.
+// Borders follow cv::pyrDown / cv::pyrUp (BORDER_REFLECT_101; pyrUp reflects at
+// twice the coarse size and crops odd sizes like OpenCV does), so results match
+// OpenCV up to float rounding: a few 1e-6 relative, see test/test_laplacian_pyramid.cpp.
+//
+// buildLevel() produces the downsampled image and the Laplacian residual in one
+// streaming pass: the image is processed in horizontal strips, each strip first
+// computes its rows of the downsampled image (plus one recomputed halo row on
+// either side) and then the residual rows, while the source strip is still in
+// cache. The upsampled image is never stored. Strips run in parallel with OpenMP.
+// The row kernels are compiled for 3 and 1 channel images, so that their per-channel
+// loops are unrolled; other channel counts use a generic instantiation.
+//
+// buildPyramid() / collapsePyramid() walk all levels inside one OpenMP parallel
+// region (one fork per frame instead of one per level, the levels are separated by
+// the worksharing barriers), with the same channel specializations. Their levels
+// may also be CV_16S fixed-point (PYR_FIXED_POINT_SHIFT): the residuals are
+// rounded as they are written and read back in float, the filtering itself and
+// the downsampled and upsampled images stay float.
+class LaplacianPyramidEngine
+{
+ public:
+    LaplacianPyramidEngine();
+
+    // Size the per-thread row scratch for images up to max_width pixels
+    void init(int max_width, int channels);
+
+    // pyramid[0..levels-1] = residuals, pyramid[levels] = lowpass, down[l] = pyrDown
+    // of level l. bands (levels + 1 entries, may be NULL) selects the outputs: the
+    // other residuals are only downsampled, nothing below the coarsest one is computed.
+    // depth is the one of the pyramid levels, CV_32F or CV_16S; down stays CV_32F.
+    void buildPyramid(const cv::Mat& src, int levels, const std::vector<bool>* bands,
+                      std::vector<cv::Mat>& down, std::vector<cv::Mat>& pyramid, int depth = CV_32F);
+
+    // dst = pyramid[top] collapsed down to level bottom. Levels outside bands (may be
+    // NULL) are only upsampled; sizes[l] is the size of level l, as those levels may be
+    // empty. up[l] receives the intermediate levels above bottom. The levels are
+    // CV_32F or CV_16S (all of the same type), up and dst are CV_32F.
+    void collapsePyramid(const std::vector<cv::Mat>& pyramid, const std::vector<cv::Size>& sizes, int top,
+                         int bottom, const std::vector<bool>* bands, std::vector<cv::Mat>& up, cv::Mat& dst);
+
+    // down = pyrDown(src), lap = src - pyrUp(down, src.size())
+    void buildLevel(const cv::Mat& src, cv::Mat& down, cv::Mat& lap);
+
+    // dst = pyrUp(src, lap.size()) + lap
+    void collapseLevel(const cv::Mat& src, const cv::Mat& lap, cv::Mat& dst);
+
+    // Single halves of the above, for bands that carry no signal:
+    // down = pyrDown(src) (same values as buildLevel) and dst = pyrUp(src, size)
+    void downLevel(const cv::Mat& src, cv::Mat& down);
+    void upLevel(const cv::Mat& src, const cv::Size& size, cv::Mat& dst);
+
+ private:
+    float* getScratch(int thread_num);
+
+    // Kernels for a channel count fixed at compile time (0: any, from the image)
+    template <int CN>
+    void buildLevelRows(const cv::Mat& src, cv::Mat& down, cv::Mat& lap);
+    template <int CN>
+    void collapseLevelRows(const cv::Mat& src, const cv::Mat& lap, cv::Mat& dst);
+    template <int CN>
+    void downLevelRows(const cv::Mat& src, cv::Mat& down);
+    template <int CN>
+    void upLevelRows(const cv::Mat& src, cv::Mat& dst);
+
+    // Whole pyramid, called with the outputs allocated: runs the row kernels above
+    // inside a single parallel region
+    template <int CN>
+    void buildPyramidImpl(const cv::Mat& src, int levels, int top, const std::vector<bool>* bands,
+                          std::vector<cv::Mat>& down, std::vector<cv::Mat>& pyramid);
+    template <int CN>
+    void collapsePyramidImpl(const cv::Mat& coarse, const std::vector<cv::Mat>& pyramid, int top, int bottom,
+                             const std::vector<bool>* bands, std::vector<cv::Mat>& up, cv::Mat& dst);
+
+ private:
+    std::vector<float> scratch_;
+    cv::Mat coarse_;  // float copy of a CV_16S top level for collapsePyramid()
+    size_t scratch_stride_;
+    int max_width_;
+    int channels_;
+};
+
+#endif  // LAPLACIAN_PYRAMID_H_
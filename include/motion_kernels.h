@@ -0,0 +1,49 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef MOTION_KERNELS_H_
+#define MOTION_KERNELS_H_
+
+#include <stdint.h>
+
+#include <opencv2/core/core.hpp>
+
+// Fixed-point format of the reduced precision IIR state (CV_16S, Q8.7):
+// value = stored / 2^IIR_FIXED_POINT_SHIFT, range +-256 with a step of 1/128.
+// Laplacian bands of a Lab frame stay well inside that range.
+#define IIR_FIXED_POINT_SHIFT 7
+#define IIR_FIXED_POINT_SCALE (1 << IIR_FIXED_POINT_SHIFT)
+
+// Fused per-level temporal kernel.
+// In a single sweep over one pyramid level it:
+//   1. updates both IIR lowpass states in place,
+//   2. computes the bandpass (lowpass_1 - lowpass_2),
+//   3. scales it by the level gain and the per-channel scale (chroma attenuation).
+// src, lowpass_1 and lowpass_2 must be CV_32F with the same size and channel count.
+// channel_scale must hold one value per channel. Rows are split over the OpenMP threads.
+void fusedTemporalAmplify(const cv::Mat& src, cv::Mat& lowpass_1, cv::Mat& lowpass_2, cv::Mat& dst,
+                          float cutoff_high, float cutoff_low, float gain, const float* channel_scale);
+
+// Same as fusedTemporalAmplify() with both lowpass states stored as CV_16S fixed-point
+// (IIR_FIXED_POINT_SHIFT). Arithmetic is done in float; the states are written back
+// rounded against a deterministic ordered dither that depends on the element and on
+// frame only, not on the thread count. Plain round-to-nearest would drop the
+// per-frame updates of a slow lowpass below half a step (0.5 / 128 / cutoff_low,
+// 0.39 Lab units at 0.01) and leave a bias that the gain amplifies; the dither
+// keeps the mean update instead. src (and dst, of the same type) may be CV_32F or
+// a CV_16S band in the same fixed-point format, rounded to nearest.
+void fusedTemporalAmplifyFixed(const cv::Mat& src, cv::Mat& lowpass_1, cv::Mat& lowpass_2, cv::Mat& dst,
+                               float cutoff_high, float cutoff_low, float gain, const float* channel_scale,
+                               int frame);
+
+#endif  // MOTION_KERNELS_H_
@@ -0,0 +1,26 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef PARAM_FILE_H_
+#define PARAM_FILE_H_
+
+#include <string>
+
+#include "eulerian_motion_mag.h"
+#include "run_modes.h"
+
+// Reads a param file (key = value lines, see README) into the processing config
+// and the run options. Unset keys keep their defaults.
+bool loadParamFile(const std::string& file_name, MotionMagConfig& config, RunOptions& options);
+
+#endif  // PARAM_FILE_H_
@@ -0,0 +1,119 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef PYRAMID_CACHE_H_
+#define PYRAMID_CACHE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#define PYRAMID_CACHE_VERSION 3
+
+// Levels are stored as CV_16SC3 fixed-point Q8.7: value = stored / 2^shift,
+// range +-256 with a step of 1/128 (Lab and YIQ levels stay within +-128). This
+// is the format of the int16 precision pyramid (PYR_FIXED_POINT_SHIFT).
+#define PYRAMID_CACHE_FIXED_POINT_SHIFT 7
+#define PYRAMID_CACHE_FIXED_POINT_SCALE (1 << PYRAMID_CACHE_FIXED_POINT_SHIFT)
+
+// What a cached pyramid depends on. The source file is identified by its path,
+// size and modification time, so editing or replacing the clip invalidates the cache.
+struct PyramidCacheKey
+{
+    std::string source;
+    int64_t source_bytes;
+    int64_t source_mtime;
+    cv::Size size;  // processing size
+    int levels;
+    std::string color_space;   // working color space of the cached frames
+    std::string pyramid_impl;  // "fast" or "opencv"
+    bool fused_color;
+    std::string lab_impl;      // Lab conversion: "fused" or cvtColor of this OpenCV version
+};
+
+// Per-frame Laplacian pyramid (levels + 1 entries, finest first) of a clip in
+// the working color space (Lab / YIQ), in one file of fixed size records:
+//   header | source path | padding to 64 bytes | frame 0 | frame 1 | ...
+// The color image itself is not stored, collapsing the pyramid gives it back
+// (reconImgFromLaplacianPyramid()). Quantizing the levels to 16 bits changes it
+// by at most 0.03 Lab units and the magnified output by at most 1 8-bit level
+// (over 60 dB PSNR against the float pyramid on baby.mp4); a frame takes 6 bytes
+// per pyramid pixel instead of 12 per pyramid and color image pixel, about a
+// third of the float record.
+//
+// The cache is written sequentially on the first run and committed (renamed from
+// <path>.tmp) only once the whole clip went through, so an interrupted run never
+// leaves a partial cache behind. Later runs map the file read-only.
+class PyramidCache
+{
+ public:
+    PyramidCache();
+    ~PyramidCache();
+
+    // Key of source_file at the given processing size and implementation,
+    // false if the file can not be stat'ed
+    static bool getKey(const std::string& source_file, const cv::Size& size, int levels,
+                       const std::string& color_space, bool fast_pyramid, bool fused_color, PyramidCacheKey& key);
+
+    // Maps path if it holds a complete cache for key. Otherwise returns false and
+    // the reason (missing, other version, stale, truncated).
+    bool openRead(const std::string& path, const PyramidCacheKey& key, std::string& reason);
+
+    // Starts recording into <path>.tmp
+    bool openWrite(const std::string& path, const PyramidCacheKey& key);
+
+    // Commits a recording to path
+    bool finish();
+
+    // Unmaps, or discards an unfinished recording
+    void close();
+
+    bool isReading() const { return mapping_ != NULL; }
+    bool isWriting() const { return file_ != NULL; }
+    int getFrameCount() const { return frame_count_; }
+
+    // Read mode: dequantizes the levels into pyramid (CV_32FC3), or copies them as
+    // stored for depth CV_16S. Entries are only reallocated if they do not have the
+    // level sizes and type already.
+    void getFrame(int frame, std::vector<cv::Mat>& pyramid, int depth = CV_32F) const;
+
+    // Write mode: pyramid must have every level, CV_32FC3 or CV_16SC3 (stored as
+    // is). Float values beyond the fixed-point range saturate.
+    bool append(const std::vector<cv::Mat>& pyramid);
+
+ private:
+    void setLayout(const PyramidCacheKey& key);
+    bool writeHeader();
+
+ private:
+    PyramidCacheKey key_;
+    std::vector<cv::Size> level_sizes_;
+    uint64_t frame_bytes_;
+    uint64_t data_offset_;
+    int frame_count_;
+
+    // read mode
+    char* mapping_;
+    size_t mapping_bytes_;
+
+    // write mode
+    FILE* file_;
+    std::string path_;
+    cv::Mat quantized_;  // one level, CV_16SC3
+};
+
+#endif  // PYRAMID_CACHE_H_
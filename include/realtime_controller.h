@@ -0,0 +1,69 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef REALTIME_CONTROLLER_H_
+#define REALTIME_CONTROLLER_H_
+
+#include <string>
+#include <vector>
+
+// Picks a quality step per frame so that the processing cost stays within the
+// frame period of the source. Step 0 is full quality, every further step is
+// cheaper (see RealtimeRunner).
+//
+// The cost is smoothed with an exponential moving average. The controller steps
+// down as soon as the average exceeds REALTIME_HIGH_LOAD of the budget for a few
+// frames, and steps up after the average stayed below REALTIME_LOW_LOAD for a
+// while. It does not step up to a step that was too slow within the last
+// REALTIME_RETRY_SEC seconds, so a constant load settles instead of oscillating.
+#define REALTIME_HIGH_LOAD 0.9
+#define REALTIME_LOW_LOAD 0.5
+#define REALTIME_DOWN_FRAMES 5
+#define REALTIME_UP_SEC 2.0
+#define REALTIME_RETRY_SEC 30.0
+
+class RealtimeController
+{
+ public:
+    RealtimeController();
+
+    // fps of the source, num_steps quality steps (>= 1)
+    void init(double fps, int num_steps);
+
+    // Cost in ms of the frame just processed. Returns true if the step changed,
+    // getReason() then tells why.
+    bool update(int frame, double cost_ms);
+
+    int getStep() const { return step_; }
+    int getNumSteps() const { return num_steps_; }
+    double getBudgetMilliSec() const { return budget_ms_; }
+    double getAverageCost() const { return average_ms_; }
+    const std::string& getReason() const { return reason_; }
+
+ private:
+    void setStep(int step, const std::string& reason);
+
+ private:
+    double budget_ms_;
+    int num_steps_;
+    int up_frames_;
+    int retry_frames_;
+
+    int step_;
+    int step_frames_;     // frames processed since the last change
+    double average_ms_;
+    std::vector<int> too_slow_frame_;  // per step: when it was last left for being too slow, -1 never
+    std::string reason_;
+};
+
+#endif  // REALTIME_CONTROLLER_H_
@@ -0,0 +1,64 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef REFERENCE_CHECK_H_
+#define REFERENCE_CHECK_H_
+
+#include <string>
+
+#include <opencv2/core/core.hpp>
+
+#include "eulerian_motion_mag.h"
+#include "timer.h"
+#include "video_io.h"
+
+// Compares every output frame with the frame at the same position in a stored
+// reference output (lossless: raw .bgr or .y4m, or a lossless video codec). A
+// frame fails below the PSNR or above the max abs error (8-bit levels).
+class ReferenceCheck
+{
+ public:
+    ReferenceCheck();
+
+    // A raw BGR reference has the output size and fps
+    bool open(const std::string& file_name, const cv::Size& output_size, double fps, double min_psnr,
+              double max_error);
+    bool isOpen() const { return open_; }
+
+    // Starts the clock of the fps in the summary
+    void start() { timer_.start(); }
+    void compare(const cv::Mat& frame);
+
+    // Reports a summary with the frame rate, and appends it to report_file (CSV)
+    // if one is set, next to the input and the kernels of config
+    void finish(const std::string& report_file, const std::string& input_file, const MotionMagConfig& config);
+
+    // False if a frame failed (or none was compared), true if not open
+    bool isPassed() const;
+
+ private:
+    VideoInput reference_;
+    bool open_;
+    std::string file_name_;
+    double min_psnr_;
+    double max_error_;
+    cv::Mat img_reference_;
+    int frames_;
+    int failures_;
+    double mse_sum_;
+    double worst_psnr_;
+    double worst_error_;
+    Timer timer_;
+};
+
+#endif  // REFERENCE_CHECK_H_
@@ -0,0 +1,55 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef ROI_PROCESSOR_H_
+#define ROI_PROCESSOR_H_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "eulerian_motion_mag.h"
+
+// Regions of interest: one EulerianMotionMag per ROI on a padded crop around it,
+// blended back onto the original frame. Only the crops are processed, at the
+// source resolution; the composited frame is resized to the output size.
+class RoiProcessor : public FrameProcessor
+{
+ public:
+    RoiProcessor();
+
+    // rois in source frame pixels, padding is the context around each one
+    // (-1 = 2^levels pixels). The per-level gains are the ones of the full frame.
+    bool init(const MotionMagConfig& config, const std::vector<cv::Rect>& rois, int padding,
+              const cv::Size& frame_size);
+
+    void process(const cv::Mat& input, cv::Mat& output);
+    void skip(const cv::Mat& input);
+    void reset();
+
+    // There is no motion image of the whole frame
+    const cv::Mat& getMotionImage() const { return img_motion_; }
+    cv::Size getOutputSize() const { return output_size_; }
+
+ private:
+    cv::Size output_size_;
+    std::vector<cv::Ptr<EulerianMotionMag> > children_;
+    std::vector<cv::Rect> padded_;
+    std::vector<cv::Mat> weights_;
+    std::vector<cv::Mat> inv_weights_;
+    std::vector<cv::Mat> outputs_;
+    cv::Mat img_composite_;
+    cv::Mat img_motion_;
+};
+
+#endif  // ROI_PROCESSOR_H_
@@ -0,0 +1,338 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef RUN_MODES_H_
+#define RUN_MODES_H_
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+#include "eulerian_motion_mag.h"
+#include "pyramid_cache.h"
+#include "realtime_controller.h"
+#include "reference_check.h"
+#include "stage_profiler.h"
+#include "timer.h"
+#include "video_io.h"
+
+// One parameter set of a sweep, see RunOptions::sweep_configs
+struct SweepConfig
+{
+    double alpha;
+    double lambda_c;
+    double cutoff_freq_low;
+    double cutoff_freq_high;
+    double chrom_attenuation;
+};
+
+// What a run reads and writes, and how it drives the processing
+struct RunOptions
+{
+    RunOptions();
+
+    // Input and output files or streams. Formats are "video", "y4m", "bgr" or
+    // empty for auto (see frame_stream.h); raw BGR input needs its frame size (the
+    // frame rate is the input_fps of the config). max_frames > 0 stops early.
+    std::string input_file;
+    std::string output_file;
+    std::string input_format;
+    std::string output_format;
+    int raw_width;
+    int raw_height;
+    int max_frames;
+
+    // No display window, and throttled progress lines instead of one per frame
+    bool headless;
+    double progress_interval;
+
+    // Stage latency profile (EMM_ENABLE_PROFILER builds): written to profile_output
+    // (or printed) at the end, and every profile_interval frames if set
+    std::string profile_output;
+    int profile_interval;
+
+    // Decode, processing and output on their own threads (PipelinedRunner)
+    bool pipelined;
+    int pipeline_queue_depth;
+
+    // Regions of interest in source frame pixels, processed on padded crops
+    // (RoiProcessor). padding -1 = 2^levels pixels.
+    std::vector<cv::Rect> rois;
+    int roi_padding;
+
+    // Cache file of the per-frame Lab pyramids (empty = off). The first run records
+    // it, later runs with the same input, size and levels skip decode and pyramid.
+    std::string pyramid_cache_file;
+
+    // Time segments processed in parallel (SegmentRunner, 1 = off), the frames each
+    // one is pre-rolled over (-1 = derived from the filter), and a serial pass to
+    // compare the first frame of every segment with
+    int segments;
+    int segment_warmup;
+    bool segment_check;
+
+    // Every configuration in one pass over the input (SweepRunner)
+    std::vector<SweepConfig> sweep_configs;
+
+    // Paced to the input fps, dropping quality and frames to hold it (RealtimeRunner)
+    bool realtime;
+    std::string realtime_log_file;
+
+    // Comparison of every output frame with a stored output (ReferenceCheck), and
+    // the CSV file its summary is appended to
+    std::string reference_file;
+    double reference_min_psnr;
+    double reference_max_error;
+    std::string reference_report_file;
+
+    // Bandpassed signal per region instead of a video (AnalysisRunner): "csv" or
+    // "binary", the regions are the ROIs or a grid of cells over the frame
+    std::string analysis_file;
+    std::string analysis_format;
+    int analysis_grid_cols;
+    int analysis_grid_rows;
+};
+
+// One way of running a clip through EulerianMotionMag: init() opens the input,
+// sets up the processing and opens the output, run() goes through the whole clip.
+// The processing itself stays in the frame processors, a runner only moves frames.
+class Runner
+{
+ public:
+    Runner(const MotionMagConfig& config, const RunOptions& options);
+    virtual ~Runner();
+
+    bool init();
+    void run();
+
+    // False if a reference comparison ran and a frame failed (or none was compared)
+    bool isPassed() const { return reference_.isPassed(); }
+    int getFrameNum() const { return frame_num_; }
+
+ protected:
+    // Processing setup for the frame size of the input, and the run loop
+    virtual bool initMode(const cv::Size& source_size) = 0;
+    virtual void runMode() = 0;
+
+    // Whether the mode writes its frames through outputFrame() and shows them
+    virtual bool usesOutput() const { return true; }
+    virtual bool usesDisplay() const { return usesOutput(); }
+
+    // EulerianMotionMag, or a RoiProcessor with ROIs set. The caller owns it, NULL on failure.
+    FrameProcessor* newProcessor(const MotionMagConfig& config, const cv::Size& size) const;
+
+    // Takes processor as processor_ (and core_ if it is an EulerianMotionMag) and
+    // the processing and output sizes from it, false if it is NULL
+    bool setProcessor(FrameProcessor* processor);
+
+    // Opens the pyramid cache for the processing of core_, or tells that the mode
+    // (supported = false) or the options do not use it
+    bool openPyramidCache(bool supported);
+    bool isCacheReplay() const { return cache_ != NULL && cache_->isReading(); }
+    bool isCacheRecording() const { return cache_ != NULL && cache_->isWriting(); }
+    void readCachedFrame(int frame, bool with_image);
+    void finishPyramidCache();
+
+    // Frames go through this one: processor_, or the cache recorder around it
+    FrameProcessor* getFrameProcessor() const { return (recorder_ != NULL) ? recorder_ : processor_; }
+
+    bool readFrame(cv::Mat& frame);
+    bool writeFrame(const cv::Mat& frame);
+
+    // Reference check, output file, profile interval and display of one output
+    // frame, false once the run should stop (ESC or a write error)
+    bool outputFrame(const cv::Mat& frame);
+
+    void reportProgress(int frames_done);
+    void reportProfile();
+
+    // Per-frame console line, throttled progress when headless
+    void beginFrameLog(const char* action, int frame);
+    void endFrameLog(int frames_done);
+
+#ifdef EMM_ENABLE_PROFILER
+    StageProfiler* getProfiler() { return (core_ != NULL) ? &core_->getProfiler() : &profiler_; }
+#endif
+
+ protected:
+    MotionMagConfig config_;  // input_fps as read from the input
+    RunOptions options_;
+
+    VideoInput input_;
+    VideoOutput output_;
+    ReferenceCheck reference_;
+    cv::Size processing_size_;
+    cv::Size output_size_;
+
+    FrameProcessor* processor_;
+    EulerianMotionMag* core_;  // processor_ if it is one, NULL with ROIs
+    FrameProcessor* recorder_;  // around processor_ while recording a pyramid cache
+
+    PyramidCache* cache_;
+    std::vector<cv::Mat> cached_pyramid_;
+    cv::Mat cached_image_;  // replayed frame: collapse of the dequantized pyramid
+
+#ifdef EMM_ENABLE_PROFILER
+    StageProfiler profiler_;  // read / write stages when there is no core_
+#endif
+    int profile_frames_;
+    Timer progress_timer_;
+    int progress_last_frame_;
+    Timer timer_;
+    double loop_time_ms_;
+    int frame_num_;
+    int frame_count_;
+
+    cv::Mat img_frame_;
+    cv::Mat img_output_;
+};
+
+// Records the pyramid of every frame on its way through core into cache, with
+// every band, so that other gains can be replayed from it
+class PyramidCacheRecorder : public FrameProcessor
+{
+ public:
+    PyramidCacheRecorder(EulerianMotionMag* core, PyramidCache* cache);
+
+    void process(const cv::Mat& input, cv::Mat& output);
+    void skip(const cv::Mat& input);
+    void reset() { core_->reset(); }
+    const cv::Mat& getMotionImage() const { return core_->getMotionImage(); }
+    cv::Size getOutputSize() const { return core_->getOutputSize(); }
+
+ private:
+    EulerianMotionMag* core_;
+    PyramidCache* cache_;
+    std::vector<bool> all_bands_;
+};
+
+// One frame after the other on the calling thread, or the replay of a pyramid cache
+class SerialRunner : public Runner
+{
+ public:
+    SerialRunner(const MotionMagConfig& config, const RunOptions& options) : Runner(config, options) {}
+
+ protected:
+    bool initMode(const cv::Size& source_size);
+    void runMode();
+
+ private:
+    void runCached();
+};
+
+// Decode and processing on their own threads, the calling thread is the sink
+// (HighGUI has to stay on the main thread)
+class PipelinedRunner : public SerialRunner
+{
+ public:
+    PipelinedRunner(const MotionMagConfig& config, const RunOptions& options) : SerialRunner(config, options) {}
+
+ protected:
+    void runMode();
+};
+
+// The clip split into time segments processed in parallel, each pre-rolled over
+// the frames before it and written to a temp file; the files are concatenated.
+class SegmentRunner : public Runner
+{
+ public:
+    SegmentRunner(const MotionMagConfig& config, const RunOptions& options) : Runner(config, options) {}
+
+ protected:
+    bool initMode(const cv::Size& source_size);
+    void runMode();
+    bool usesDisplay() const { return false; }
+
+ private:
+    struct Job;
+    bool openInput(int first_frame, VideoInput& input) const;
+    void processSegment(Job& job, int num_threads, std::atomic<int>& frames_done) const;
+    void processSerialCheck(std::vector<Job>& jobs, int num_threads) const;
+    int getWarmupFrames() const;
+
+    cv::Size source_size_;
+};
+
+// Every sweep configuration in one pass: the pyramid is built once per frame for
+// the union of the bands any configuration amplifies, then each one is filtered,
+// amplified and reconstructed by its own core and written to its own file
+// (output_file with the parameters appended to the name).
+class SweepRunner : public Runner
+{
+ public:
+    SweepRunner(const MotionMagConfig& config, const RunOptions& options) : Runner(config, options) {}
+
+ protected:
+    bool initMode(const cv::Size& source_size);
+    void runMode();
+    bool usesOutput() const { return false; }
+
+ private:
+    std::string getFileName(const SweepConfig& sweep) const;
+
+    std::vector<cv::Ptr<EulerianMotionMag> > children_;
+    std::vector<cv::Ptr<VideoOutput> > outputs_;
+    std::vector<cv::Mat> images_;
+    std::vector<bool> bands_;
+};
+
+// Paced to the input fps, as a live source would deliver the frames. Cheaper
+// quality steps estimate the motion at 1/2, 1/4, 1/8 of the size; the
+// RealtimeController picks one per frame, and frames are skipped while behind.
+class RealtimeRunner : public Runner
+{
+ public:
+    RealtimeRunner(const MotionMagConfig& config, const RunOptions& options) : Runner(config, options) {}
+
+ protected:
+    bool initMode(const cv::Size& source_size);
+    void runMode();
+
+ private:
+    RealtimeController controller_;
+    std::vector<cv::Ptr<FrameProcessor> > steps_;  // empty for step 0, which is processor_
+    std::vector<double> step_scales_;  // motion_scale of each step
+};
+
+// Stops after the temporal filter: every level is filtered at unit gain and its
+// mean over each region is recorded per channel, one record per frame. Binary:
+// "EMMSIG1" magic (8 bytes), int32 regions, levels + 1, channels, float64 fps,
+// then per frame int32 frame and float32 means[region][level][channel], native
+// byte order. CSV: the same record per line, after a header naming every column.
+class AnalysisRunner : public Runner
+{
+ public:
+    AnalysisRunner(const MotionMagConfig& config, const RunOptions& options) : Runner(config, options) {}
+
+ protected:
+    bool initMode(const cv::Size& source_size);
+    void runMode();
+    bool usesOutput() const { return false; }
+
+ private:
+    void analyzeBands(bool first_frame);
+    bool writeRecord(int frame);
+
+    std::ofstream out_;
+    std::vector<cv::Rect> regions_;  // at the processing size
+    std::vector<float> record_;
+    int channels_;
+};
+
+// The runner for the options, NULL (and the reason on stderr) if they do not go together
+Runner* createRunner(const MotionMagConfig& config, const RunOptions& options);
+
+#endif  // RUN_MODES_H_
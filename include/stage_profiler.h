@@ -0,0 +1,121 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef STAGE_PROFILER_H_
+#define STAGE_PROFILER_H_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <iostream>
+#include <string>
+
+#include "timer.h"
+
+// Stages of the run loop that are instrumented
+enum ProfileStage
+{
+    STAGE_READ = 0,
+    STAGE_RESIZE,
+    STAGE_COLOR_IN,
+    STAGE_PYRAMID,
+    STAGE_TEMPORAL,
+    STAGE_AMPLIFY,
+    STAGE_RECONSTRUCT,
+    STAGE_ATTENUATE,
+    STAGE_COLOR_OUT,
+    STAGE_WRITE,
+    NUM_PROFILE_STAGES
+};
+
+// The profiler itself only exists with EMM_ENABLE_PROFILER (cmake -DENABLE_PROFILER=ON),
+// otherwise neither the class nor stage_profiler.cpp is built
+#ifdef EMM_ENABLE_PROFILER
+
+// Per-stage latency histograms.
+// Buckets are log-linear (16 linear sub-buckets per power of two, ~6% resolution),
+// so recording is a couple of integer ops and one relaxed atomic increment, and
+// stages may be recorded from different threads (pipelined mode).
+class StageProfiler
+{
+ public:
+    StageProfiler();
+
+    void record(int stage, uint64_t ns);
+    void reset();
+
+    uint64_t getCount(int stage) const { return stats_[stage].count.load(std::memory_order_relaxed); }
+    double getMeanMilliSec(int stage) const;
+    double getMaxMilliSec(int stage) const;
+    double getPercentileMilliSec(int stage, double percentile) const;
+
+    static const char* getStageName(int stage);
+
+    // Reports: human readable table, JSON or CSV
+    void print(std::ostream& out) const;
+    void writeJson(std::ostream& out) const;
+    void writeCsv(std::ostream& out) const;
+
+    // Writes JSON or CSV depending on the file extension
+    bool save(const std::string& file_name) const;
+
+ private:
+    static const int kSubBuckets = 16;
+    static const int kNumBuckets = 61 * kSubBuckets;
+
+    static int getBucket(uint64_t ns);
+    static double getBucketValue(int bucket);
+
+    struct Stats
+    {
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> total_ns;
+        std::atomic<uint64_t> max_ns;
+        std::atomic<uint32_t> buckets[kNumBuckets];
+    };
+
+    Stats stats_[NUM_PROFILE_STAGES];
+};
+
+// Records the lifetime of the scope into one stage of the profiler
+class ScopedStageTimer
+{
+ public:
+    ScopedStageTimer(StageProfiler* profiler, int stage)
+        : profiler_(profiler)
+        , stage_(stage)
+        , t_start_(Timer::Clock::now())
+    {
+    }
+
+    ~ScopedStageTimer()
+    {
+        profiler_->record(stage_, std::chrono::duration_cast<std::chrono::nanoseconds>(Timer::Clock::now() - t_start_).count());
+    }
+
+ private:
+    StageProfiler* profiler_;
+    int stage_;
+    Timer::Time t_start_;
+};
+
+// Instrumentation macro: times the enclosing scope (expands to nothing without the profiler)
+#define EMM_PROFILE_CONCAT_(a, b) a##b
+#define EMM_PROFILE_CONCAT(a, b) EMM_PROFILE_CONCAT_(a, b)
+#define EMM_PROFILE_SCOPE(profiler, stage) \
+    ScopedStageTimer EMM_PROFILE_CONCAT(emm_profile_scope_, __LINE__)((profiler), (stage))
+#else
+#define EMM_PROFILE_SCOPE(profiler, stage)
+#endif  // EMM_ENABLE_PROFILER
+
+#endif  // STAGE_PROFILER_H_
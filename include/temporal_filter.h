@@ -0,0 +1,116 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef TEMPORAL_FILTER_H_
+#define TEMPORAL_FILTER_H_
+
+#include <vector>
+
+#include <opencv2/core/core.hpp>
+
+// Temporal bandpass of one pyramid level, one instance per level.
+// init() seeds the state with the first frame (the output is zero until the
+// signal changes), apply() consumes the next frame and writes the bandpassed
+// value for it. applyScaled() also multiplies the result by gain and by
+// channel_scale per channel (one value per channel of src).
+class TemporalFilter
+{
+ public:
+    virtual ~TemporalFilter() {}
+
+    virtual void init(const cv::Mat& src) = 0;
+    virtual void apply(const cv::Mat& src, cv::Mat& dst) = 0;
+
+    // The default applies and scales in a second pass over dst
+    virtual void applyScaled(const cv::Mat& src, cv::Mat& dst, double gain, const float* channel_scale);
+};
+
+// Difference of two first order lowpass filters (temporal_filter = iir):
+//   lowpass_1 += cutoff_high * (x - lowpass_1)
+//   lowpass_2 += cutoff_low * (x - lowpass_2)
+//   bandpass = lowpass_1 - lowpass_2
+// The states are allocated by the constructor, CV_32F or CV_16S fixed-point
+// (IIR_FIXED_POINT_SHIFT, see motion_kernels.h) with the channel count of the
+// level. The fixed-point states always go through the fused kernel, which also
+// takes levels in the same fixed-point format (int16 precision);
+// applyScaled() uses the fused kernels for both.
+class IIRBandpassFilter : public TemporalFilter
+{
+ public:
+    IIRBandpassFilter(double cutoff_low, double cutoff_high, const cv::Size& size, int state_type);
+
+    // The state Mats themselves (not copies), for inspection
+    const cv::Mat& getLowpass1() const { return lowpass_1_; }
+    const cv::Mat& getLowpass2() const { return lowpass_2_; }
+
+    virtual void init(const cv::Mat& src);
+    virtual void apply(const cv::Mat& src, cv::Mat& dst);
+    virtual void applyScaled(const cv::Mat& src, cv::Mat& dst, double gain, const float* channel_scale);
+
+ private:
+    double cutoff_low_;
+    double cutoff_high_;
+    cv::Mat lowpass_1_;
+    cv::Mat lowpass_2_;
+    int frame_;  // frames since init(), phase of the fixed-point dither
+};
+
+// Ideal bandpass over a sliding window of the last `window` frames.
+// Each pixel keeps the window samples and the DFT bins inside the band, and
+// the bins are updated recursively (S_k = (S_k - x_old + x_new) * e^(j2pi k/N)),
+// so a frame costs O(bins) per pixel and memory is bounded by the window.
+// The output is the band-limited inverse DFT evaluated at the newest sample.
+//
+// The recursion accumulates float rounding, so every frame 1/window of the
+// rows get their bins recomputed exactly from the samples; every row is
+// refreshed once per window.
+//
+// Memory is window + 2 * bins float planes of the level, allocated by init().
+// That adds up: level 1 of a 1080p frame is 960x540x3 floats (6.2 MB), so a
+// 64 frame window holds about 400 MB for that level alone (see getStateBytes()).
+class SlidingDFTFilter : public TemporalFilter
+{
+ public:
+    // Bins are DFT indices of a window long transform, 0 <= bin_low <= bin_high <= window / 2
+    SlidingDFTFilter(int window, int bin_low, int bin_high);
+
+    // Bin range that covers [freq_low, freq_high] Hz at the given frame rate.
+    // Returns false if no bin falls inside the band.
+    static bool getBandBins(int window, double fps, double freq_low, double freq_high, int& bin_low, int& bin_high);
+
+    // Bytes init() allocates for a level of the given size and type
+    static size_t getStateBytes(const cv::Size& size, int type, int window, int bin_low, int bin_high);
+
+    virtual void init(const cv::Mat& src);
+    virtual void apply(const cv::Mat& src, cv::Mat& dst);
+
+ private:
+    void refreshRows(int row_begin, int row_end);
+
+ private:
+    int window_;
+    std::vector<int> bins_;
+    std::vector<float> rotate_cos_;
+    std::vector<float> rotate_sin_;
+    std::vector<float> weight_;   // 1/N for DC and Nyquist, 2/N otherwise
+    std::vector<float> twiddle_cos_;
+    std::vector<float> twiddle_sin_;
+
+    std::vector<cv::Mat> samples_;  // ring of the last window frames
+    std::vector<cv::Mat> bin_re_;
+    std::vector<cv::Mat> bin_im_;
+    int oldest_;
+    int refresh_slot_;
+};
+
+#endif  // TEMPORAL_FILTER_H_
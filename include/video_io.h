@@ -0,0 +1,89 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#ifndef VIDEO_IO_H_
+#define VIDEO_IO_H_
+
+#include <string>
+
+#include <opencv2/core/core.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "frame_stream.h"
+
+// Frames of a video file (cv::VideoCapture) or of a Y4M, raw BGR or synthetic
+// stream (FrameStreamReader), see getFrameStreamFormat() for the choice
+class VideoInput
+{
+ public:
+    VideoInput();
+    ~VideoInput();
+
+    // raw_size and fps are only used by raw BGR and synthetic streams, the others
+    // bring their own
+    bool open(const std::string& file_name, const std::string& format, const cv::Size& raw_size, double fps);
+
+    // Positions the input so that the next read() returns frame. Video files seek
+    // by frame number, which is only frame accurate for intra-only codecs.
+    bool seek(int frame);
+
+    // Reads the next CV_8UC3 BGR frame, false (and frame empty) at the end of the
+    // input or after max_frames
+    bool read(cv::Mat& frame);
+
+    // Stop after this many frames (0 = the whole input). Such a run does not reach
+    // the end, see isComplete().
+    void setMaxFrames(int frames) { max_frames_ = frames; }
+
+    bool isStream() const { return stream_ != NULL; }
+    const cv::Size& getSize() const { return size_; }
+    double getFps() const { return fps_; }
+    int getFrameCount() const { return frame_count_; }  // 0 if unknown
+    int getFramesRead() const { return frames_read_; }
+    // read() ran into the end of the input, so every frame went through
+    bool isComplete() const { return ended_; }
+
+ private:
+    cv::VideoCapture* capture_;
+    FrameStreamReader* stream_;
+    cv::Size size_;
+    double fps_;
+    int frame_count_;
+    int max_frames_;
+    int frames_read_;
+    bool ended_;
+};
+
+// Encoded video file (cv::VideoWriter, codec from the extension) or a Y4M / raw
+// BGR stream (FrameStreamWriter)
+class VideoOutput
+{
+ public:
+    VideoOutput();
+    ~VideoOutput();
+
+    // Frames to stdout ("-") need FrameStreamWriter::reserveStdout() before
+    // anything is printed
+    bool open(const std::string& file_name, const std::string& format, const cv::Size& size, double fps);
+    bool isOpened() const { return writer_ != NULL || stream_ != NULL; }
+    bool write(const cv::Mat& frame);
+
+    // FOURCC for the extension of file_name: MJPG for .avi, DIVX for .mp4, -1 otherwise
+    static int getCodecNumber(const std::string& file_name);
+
+ private:
+    cv::VideoWriter* writer_;
+    FrameStreamWriter* stream_;
+};
+
+#endif  // VIDEO_IO_H_
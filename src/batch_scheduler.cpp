@@ -0,0 +1,229 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "batch_scheduler.h"
+
+#include <algorithm>
+
+#include "timer.h"
+
+namespace
+{
+
+thread_local std::string thread_prefix;
+
+}  // namespace
+
+BatchLogBuffer::BatchLogBuffer(std::streambuf* target)
+        : target_(target)
+        , lines_()
+{
+}
+
+BatchLogBuffer::~BatchLogBuffer()
+{
+    // Whatever is left without a newline
+    for (std::map<std::thread::id, std::string>::iterator it = lines_.begin(); it != lines_.end(); ++it)
+        target_->sputn(it->second.data(), it->second.size());
+    target_->pubsync();
+}
+
+void BatchLogBuffer::setThreadPrefix(const std::string& prefix)
+{
+    thread_prefix = prefix;
+}
+
+int BatchLogBuffer::overflow(int c)
+{
+    if (c == traits_type::eof())
+        return traits_type::not_eof(c);
+
+    const char ch = traits_type::to_char_type(c);
+    return (xsputn(&ch, 1) == 1) ? c : traits_type::eof();
+}
+
+std::streamsize BatchLogBuffer::xsputn(const char* s, std::streamsize n)
+{
+    std::lock_guard<std::mutex> lock(lock_);
+    const std::thread::id thread = std::this_thread::get_id();
+    std::string& line = lines_[thread];
+    for (std::streamsize i = 0; i < n; ++i)
+    {
+        if (line.empty())
+            line = thread_prefix;
+        line.push_back(s[i]);
+        if (s[i] == '\n')
+        {
+            target_->sputn(line.data(), line.size());
+            line.clear();
+        }
+    }
+    if (line.empty())
+        lines_.erase(thread);
+    target_->pubsync();
+    return n;
+}
+
+BatchScheduler::BatchScheduler(int num_workers, int num_threads)
+        : num_workers_(std::max(num_workers, 1))
+        , num_threads_(std::max(num_threads, 1))
+        , jobs_()
+        , results_()
+        , rebalance_()
+        , queues_()
+        , busy_()
+        , worker_threads_()
+        , wall_ms_(0)
+{
+}
+
+void BatchScheduler::add(const BatchJob& job)
+{
+    jobs_.push_back(job);
+}
+
+void BatchScheduler::run()
+{
+    Timer wall_timer;
+
+    // Largest first, dealt round-robin so every worker starts with a long clip
+    std::vector<size_t> order(jobs_.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [this](size_t a, size_t b) { return jobs_[a].cost > jobs_[b].cost; });
+
+    const int workers = std::max(1, std::min(num_workers_, static_cast<int>(jobs_.size())));
+    queues_.assign(workers, std::deque<size_t>());
+    for (size_t i = 0; i < order.size(); ++i)
+        queues_[i % workers].push_back(order[i]);
+
+    results_.assign(jobs_.size(), BatchJobResult());
+
+    // Every worker starts with a job
+    busy_.assign(workers, true);
+    worker_threads_.reset(new std::atomic<int>[workers]);
+    rebalance();
+
+    // Whole lines per job on the console
+    BatchLogBuffer out_buffer(std::cout.rdbuf());
+    BatchLogBuffer err_buffer(std::cerr.rdbuf());
+    std::streambuf* out_target = std::cout.rdbuf(&out_buffer);
+    std::streambuf* err_target = std::cerr.rdbuf(&err_buffer);
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < workers; ++w)
+        threads.push_back(std::thread(&BatchScheduler::workerLoop, this, w));
+    for (size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    std::cout.rdbuf(out_target);
+    std::cerr.rdbuf(err_target);
+    wall_ms_ = wall_timer.getTimeMilliSec();
+}
+
+bool BatchScheduler::takeJob(int worker, size_t& job)
+{
+    std::lock_guard<std::mutex> lock(queue_lock_);
+
+    std::deque<size_t>* queue = &queues_[worker];
+    if (queue->empty())
+    {
+        // Steal from the fullest victim, from the back (its smallest job)
+        for (size_t v = 0; v < queues_.size(); ++v)
+            if (queues_[v].size() > queue->size())
+                queue = &queues_[v];
+        if (queue->empty())
+            return false;
+
+        job = queue->back();
+        queue->pop_back();
+        return true;
+    }
+
+    job = queue->front();
+    queue->pop_front();
+    return true;
+}
+
+void BatchScheduler::finishWorker(int worker)
+{
+    // No job left for this worker, its cores go to the jobs still running
+    std::lock_guard<std::mutex> lock(queue_lock_);
+    busy_[worker] = false;
+    rebalance();
+}
+
+void BatchScheduler::rebalance()
+{
+    // Called with queue_lock_ held (or before the workers start)
+    const int busy = static_cast<int>(std::count(busy_.begin(), busy_.end(), true));
+    if (busy == 0)
+        return;
+
+    const int share = std::max(1, num_threads_ / busy);
+    for (size_t w = 0; w < busy_.size(); ++w)
+        worker_threads_[w] = busy_[w] ? share : 0;
+    if (rebalance_)
+        rebalance_(share);
+}
+
+void BatchScheduler::workerLoop(int worker)
+{
+    size_t job;
+    while (takeJob(worker, job))
+    {
+        BatchJobResult& result = results_[job];
+        result.name = jobs_[job].name;
+        result.worker = worker;
+        result.threads = worker_threads_[worker];
+
+        BatchLogBuffer::setThreadPrefix("[" + result.name + "] ");
+        Timer job_timer;
+        result.frames = jobs_[job].run(worker_threads_[worker]);
+        result.seconds = job_timer.getTimeMilliSec() / 1000.0;
+        result.ok = (result.frames >= 0);
+        result.threads_end = worker_threads_[worker];
+        BatchLogBuffer::setThreadPrefix("");
+    }
+    finishWorker(worker);
+}
+
+void BatchScheduler::printReport(std::ostream& out) const
+{
+    int total_frames = 0;
+    int failed = 0;
+
+    out << "\nBatch report:" << std::endl;
+    for (size_t i = 0; i < results_.size(); ++i)
+    {
+        const BatchJobResult& r = results_[i];
+        if (!r.ok)
+        {
+            out << "  " << r.name << " : FAILED" << std::endl;
+            failed++;
+            continue;
+        }
+
+        total_frames += r.frames;
+        out << "  " << r.name << " : " << r.frames << " frames in " << r.seconds << " s ("
+            << (r.seconds > 0 ? r.frames / r.seconds : 0) << " fps, " << r.threads;
+        if (r.threads_end != r.threads)
+            out << " -> " << r.threads_end;
+        out << " threads, worker " << r.worker << ")" << std::endl;
+    }
+
+    const double wall_sec = wall_ms_ / 1000.0;
+    out << "  total : " << results_.size() - failed << " / " << results_.size() << " jobs, " << total_frames
+        << " frames in " << wall_sec << " s wall (" << (wall_sec > 0 ? total_frames / wall_sec : 0) << " fps)"
+        << std::endl;
+}
@@ -0,0 +1,545 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "color_kernels.h"
+
+#include <math.h>
+#include <omp.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Lab constants as used by OpenCV's cvtColor
+#define LAB_THRESHOLD 0.008856f         // (6/29)^3
+#define LAB_SLOPE 7.787f                // (29/6)^2 / 3
+#define LAB_OFFSET (16.0f / 116.0f)
+#define LAB_L_SLOPE 903.3f              // L of the linear segment
+#define LAB_L_THRESHOLD (LAB_THRESHOLD * LAB_L_SLOPE)
+#define LAB_F_THRESHOLD (LAB_SLOPE * LAB_THRESHOLD + LAB_OFFSET)
+
+#define SRGB_ENCODE_LUT_SIZE 4096
+
+namespace
+{
+
+// sRGB -> XYZ (D65) with the rows divided by the white point, and its inverse
+// with the columns multiplied by it, rows in R, G, B / X, Y, Z order
+const float kRGB2XYZ[9] =
+{
+    0.412453f / 0.950456f, 0.357580f / 0.950456f, 0.180423f / 0.950456f,
+    0.212671f,             0.715160f,             0.072169f,
+    0.019334f / 1.088754f, 0.119193f / 1.088754f, 0.950227f / 1.088754f,
+};
+
+const float kXYZ2RGB[9] =
+{
+    3.240479f * 0.950456f,  -1.53715f,  -0.498535f * 1.088754f,
+    -0.969256f * 0.950456f, 1.875991f,  0.041556f * 1.088754f,
+    0.055648f * 0.950456f,  -0.204043f, 1.057311f * 1.088754f,
+};
+
+// NTSC RGB -> YIQ, rows Y, I, Q
+const double kRGB2YIQ[9] =
+{
+    0.299, 0.587, 0.114,
+    0.596, -0.274, -0.322,
+    0.211, -0.523, 0.312,
+};
+
+#define YIQ_SCALE 100.0
+
+struct SRGBTables
+{
+    // decode[v]: linear value of the 8-bit code v
+    float decode[256];
+
+    // encode: an 8-bit code not above the correct one for linear values in each
+    // cell, refined with threshold[k], the smallest linear value that rounds to k
+    unsigned char encode[SRGB_ENCODE_LUT_SIZE];
+    float threshold[257];
+};
+
+double srgbDecode(double v)
+{
+    return (v <= 0.04045) ? v / 12.92 : pow((v + 0.055) / 1.055, 2.4);
+}
+
+SRGBTables buildSRGBTables()
+{
+    SRGBTables t;
+    for (int v = 0; v < 256; ++v)
+        t.decode[v] = static_cast<float>(srgbDecode(v / 255.0));
+
+    // convertTo(CV_8U, 255.0, 1.0 / 255.0) rounds 255 * encode(v) + 1/255, so code k
+    // starts where encode(v) reaches (k - 0.5 - 1/255) / 255
+    t.threshold[0] = -1.0f;
+    for (int k = 1; k < 256; ++k)
+        t.threshold[k] = static_cast<float>(srgbDecode((k - 0.5 - 1.0 / 255.0) / 255.0));
+    t.threshold[256] = 2.0f;  // sentinel above every clipped value
+
+    int k = 0;
+    for (int i = 0; i < SRGB_ENCODE_LUT_SIZE; ++i)
+    {
+        const float cell_begin = static_cast<float>(i) / (SRGB_ENCODE_LUT_SIZE - 1);
+        while (t.threshold[k + 1] <= cell_begin)
+            ++k;
+        t.encode[i] = static_cast<unsigned char>(k);
+    }
+    return t;
+}
+
+const SRGBTables& getSRGBTables()
+{
+    static const SRGBTables tables = buildSRGBTables();
+    return tables;
+}
+
+// v clipped to [0, 1]
+inline unsigned char encodeSRGB8(float v, const SRGBTables& t)
+{
+    int k = t.encode[static_cast<int>(v * (SRGB_ENCODE_LUT_SIZE - 1))];
+    while (v >= t.threshold[k + 1])
+        ++k;
+    return static_cast<unsigned char>(k);
+}
+
+inline float labF(float t)
+{
+    return (t > LAB_THRESHOLD) ? cbrtf(t) : LAB_SLOPE * t + LAB_OFFSET;
+}
+
+inline float labFInv(float f)
+{
+    return (f > LAB_F_THRESHOLD) ? f * f * f : (f - LAB_OFFSET) / LAB_SLOPE;
+}
+
+inline float clip01(float v)
+{
+    return std::min(1.0f, std::max(0.0f, v));
+}
+
+inline unsigned char saturate8(float v)
+{
+    return static_cast<unsigned char>(std::min(255, std::max(0, static_cast<int>(lrintf(v)))));
+}
+
+#if defined(__SSE2__)
+inline __m128 select(__m128 mask, __m128 a, __m128 b)
+{
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Cube root of x >= 0: exponent / 3 bit trick, then Newton steps y -= (y^3 - x) / (3y^2)
+inline __m128 cbrt_ps(__m128 x)
+{
+    const __m128 third = _mm_set1_ps(1.0f / 3.0f);
+    const __m128i bits = _mm_castps_si128(x);
+    __m128 y = _mm_castsi128_ps(_mm_add_epi32(_mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(bits), third)),
+                                              _mm_set1_epi32(709921077)));
+    const __m128 tiny = _mm_set1_ps(1e-30f);
+    for (int i = 0; i < 3; ++i)
+    {
+        const __m128 y2 = _mm_max_ps(_mm_mul_ps(y, y), tiny);
+        y = _mm_mul_ps(third, _mm_add_ps(_mm_add_ps(y, y), _mm_div_ps(x, y2)));
+    }
+    return y;
+}
+
+inline __m128 labF_ps(__m128 t)
+{
+    const __m128 linear = _mm_add_ps(_mm_mul_ps(t, _mm_set1_ps(LAB_SLOPE)), _mm_set1_ps(LAB_OFFSET));
+    return select(_mm_cmpgt_ps(t, _mm_set1_ps(LAB_THRESHOLD)), cbrt_ps(t), linear);
+}
+
+inline __m128 labFInv_ps(__m128 f)
+{
+    const __m128 cube = _mm_mul_ps(_mm_mul_ps(f, f), f);
+    const __m128 linear = _mm_mul_ps(_mm_sub_ps(f, _mm_set1_ps(LAB_OFFSET)), _mm_set1_ps(1.0f / LAB_SLOPE));
+    return select(_mm_cmpgt_ps(f, _mm_set1_ps(LAB_F_THRESHOLD)), cube, linear);
+}
+
+inline __m128 clip01_ps(__m128 v)
+{
+    return _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+}
+#endif
+
+void bgr8ToLabRow(const unsigned char* s, float* d, int cols, const SRGBTables& t)
+{
+    const float* m = kRGB2XYZ;
+    int x = 0;
+
+#if defined(__SSE2__)
+    // 4 pixels per step: gather through the decode table, the math runs on R, G, B planes
+    for (; x <= cols - 4; x += 4, s += 12, d += 12)
+    {
+        const __m128 b = _mm_setr_ps(t.decode[s[0]], t.decode[s[3]], t.decode[s[6]], t.decode[s[9]]);
+        const __m128 g = _mm_setr_ps(t.decode[s[1]], t.decode[s[4]], t.decode[s[7]], t.decode[s[10]]);
+        const __m128 r = _mm_setr_ps(t.decode[s[2]], t.decode[s[5]], t.decode[s[8]], t.decode[s[11]]);
+
+        const __m128 fx = labF_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(m[0])), _mm_mul_ps(g, _mm_set1_ps(m[1]))),
+                                             _mm_mul_ps(b, _mm_set1_ps(m[2]))));
+        const __m128 y = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(m[3])), _mm_mul_ps(g, _mm_set1_ps(m[4]))),
+                                    _mm_mul_ps(b, _mm_set1_ps(m[5])));
+        const __m128 fy = labF_ps(y);
+        const __m128 fz = labF_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(m[6])), _mm_mul_ps(g, _mm_set1_ps(m[7]))),
+                                             _mm_mul_ps(b, _mm_set1_ps(m[8]))));
+
+        const __m128 l = select(_mm_cmpgt_ps(y, _mm_set1_ps(LAB_THRESHOLD)),
+                                _mm_sub_ps(_mm_mul_ps(fy, _mm_set1_ps(116.0f)), _mm_set1_ps(16.0f)),
+                                _mm_mul_ps(y, _mm_set1_ps(LAB_L_SLOPE)));
+        const __m128 a = _mm_mul_ps(_mm_sub_ps(fx, fy), _mm_set1_ps(500.0f));
+        const __m128 bb = _mm_mul_ps(_mm_sub_ps(fy, fz), _mm_set1_ps(200.0f));
+
+        float lab[12];
+        _mm_storeu_ps(lab, l);
+        _mm_storeu_ps(lab + 4, a);
+        _mm_storeu_ps(lab + 8, bb);
+        for (int i = 0; i < 4; ++i)
+        {
+            d[3 * i] = lab[i];
+            d[3 * i + 1] = lab[4 + i];
+            d[3 * i + 2] = lab[8 + i];
+        }
+    }
+#endif
+
+    // Scalar tail (and fallback for targets without SSE2)
+    for (; x < cols; ++x, s += 3, d += 3)
+    {
+        const float b = t.decode[s[0]];
+        const float g = t.decode[s[1]];
+        const float r = t.decode[s[2]];
+        const float y = m[3] * r + m[4] * g + m[5] * b;
+        const float fx = labF(m[0] * r + m[1] * g + m[2] * b);
+        const float fy = labF(y);
+        const float fz = labF(m[6] * r + m[7] * g + m[8] * b);
+        d[0] = (y > LAB_THRESHOLD) ? 116.0f * fy - 16.0f : LAB_L_SLOPE * y;
+        d[1] = 500.0f * (fx - fy);
+        d[2] = 200.0f * (fy - fz);
+    }
+}
+
+void labToBGR8Row(const float* s, unsigned char* d, int cols, const SRGBTables& t)
+{
+    const float* m = kXYZ2RGB;
+    int x = 0;
+
+#if defined(__SSE2__)
+    for (; x <= cols - 4; x += 4, s += 12, d += 12)
+    {
+        const __m128 l = _mm_setr_ps(s[0], s[3], s[6], s[9]);
+        const __m128 a = _mm_setr_ps(s[1], s[4], s[7], s[10]);
+        const __m128 bb = _mm_setr_ps(s[2], s[5], s[8], s[11]);
+
+        const __m128 fy_cube = _mm_mul_ps(_mm_add_ps(l, _mm_set1_ps(16.0f)), _mm_set1_ps(1.0f / 116.0f));
+        const __m128 y_linear = _mm_mul_ps(l, _mm_set1_ps(1.0f / LAB_L_SLOPE));
+        const __m128 is_linear = _mm_cmple_ps(l, _mm_set1_ps(LAB_L_THRESHOLD));
+        const __m128 y = select(is_linear, y_linear, _mm_mul_ps(_mm_mul_ps(fy_cube, fy_cube), fy_cube));
+        const __m128 fy = select(is_linear, _mm_add_ps(_mm_mul_ps(y_linear, _mm_set1_ps(LAB_SLOPE)), _mm_set1_ps(LAB_OFFSET)),
+                                 fy_cube);
+        const __m128 xx = labFInv_ps(_mm_add_ps(_mm_mul_ps(a, _mm_set1_ps(1.0f / 500.0f)), fy));
+        const __m128 z = labFInv_ps(_mm_sub_ps(fy, _mm_mul_ps(bb, _mm_set1_ps(1.0f / 200.0f))));
+
+        float rgb[12];
+        _mm_storeu_ps(rgb, clip01_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, _mm_set1_ps(m[0])), _mm_mul_ps(y, _mm_set1_ps(m[1]))),
+                                                _mm_mul_ps(z, _mm_set1_ps(m[2])))));
+        _mm_storeu_ps(rgb + 4, clip01_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, _mm_set1_ps(m[3])), _mm_mul_ps(y, _mm_set1_ps(m[4]))),
+                                                    _mm_mul_ps(z, _mm_set1_ps(m[5])))));
+        _mm_storeu_ps(rgb + 8, clip01_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, _mm_set1_ps(m[6])), _mm_mul_ps(y, _mm_set1_ps(m[7]))),
+                                                    _mm_mul_ps(z, _mm_set1_ps(m[8])))));
+        for (int i = 0; i < 4; ++i)
+        {
+            d[3 * i] = encodeSRGB8(rgb[8 + i], t);
+            d[3 * i + 1] = encodeSRGB8(rgb[4 + i], t);
+            d[3 * i + 2] = encodeSRGB8(rgb[i], t);
+        }
+    }
+#endif
+
+    // Scalar tail (and fallback for targets without SSE2)
+    for (; x < cols; ++x, s += 3, d += 3)
+    {
+        float y, fy;
+        if (s[0] <= LAB_L_THRESHOLD)
+        {
+            y = s[0] / LAB_L_SLOPE;
+            fy = LAB_SLOPE * y + LAB_OFFSET;
+        }
+        else
+        {
+            fy = (s[0] + 16.0f) / 116.0f;
+            y = fy * fy * fy;
+        }
+        const float xx = labFInv(s[1] / 500.0f + fy);
+        const float z = labFInv(fy - s[2] / 200.0f);
+        d[0] = encodeSRGB8(clip01(m[6] * xx + m[7] * y + m[8] * z), t);
+        d[1] = encodeSRGB8(clip01(m[3] * xx + m[4] * y + m[5] * z), t);
+        d[2] = encodeSRGB8(clip01(m[0] * xx + m[1] * y + m[2] * z), t);
+    }
+}
+
+// 3x3 matrices in float, BGR column order: forward[c * 3 + k] multiplies input channel k
+struct YIQMatrices
+{
+    float forward[9];
+    float inverse[9];
+};
+
+YIQMatrices buildYIQMatrices()
+{
+    // Reorder to BGR input, then invert in double
+    double f[9];
+    for (int r = 0; r < 3; ++r)
+        for (int k = 0; k < 3; ++k)
+            f[r * 3 + k] = kRGB2YIQ[r * 3 + (2 - k)];
+
+    const double det = f[0] * (f[4] * f[8] - f[5] * f[7]) - f[1] * (f[3] * f[8] - f[5] * f[6]) +
+                       f[2] * (f[3] * f[7] - f[4] * f[6]);
+    const double inv[9] =
+    {
+        (f[4] * f[8] - f[5] * f[7]) / det, (f[2] * f[7] - f[1] * f[8]) / det, (f[1] * f[5] - f[2] * f[4]) / det,
+        (f[5] * f[6] - f[3] * f[8]) / det, (f[0] * f[8] - f[2] * f[6]) / det, (f[2] * f[3] - f[0] * f[5]) / det,
+        (f[3] * f[7] - f[4] * f[6]) / det, (f[1] * f[6] - f[0] * f[7]) / det, (f[0] * f[4] - f[1] * f[3]) / det,
+    };
+
+    // 8-bit in, [0, 100] scaled out and back
+    YIQMatrices m;
+    for (int i = 0; i < 9; ++i)
+    {
+        m.forward[i] = static_cast<float>(f[i] * YIQ_SCALE / 255.0);
+        m.inverse[i] = static_cast<float>(inv[i] * 255.0 / YIQ_SCALE);
+    }
+    return m;
+}
+
+const YIQMatrices& getYIQMatrices()
+{
+    static const YIQMatrices matrices = buildYIQMatrices();
+    return matrices;
+}
+
+// Per pixel dst = m * src, the scalar form is simple enough for the compiler to unroll
+template <typename S, typename D, typename Store>
+void transformRow(const S* s, D* d, int cols, const float* m, Store store)
+{
+    for (int x = 0; x < cols; ++x, s += 3, d += 3)
+    {
+        const float c0 = s[0];
+        const float c1 = s[1];
+        const float c2 = s[2];
+        d[0] = store(m[0] * c0 + m[1] * c1 + m[2] * c2);
+        d[1] = store(m[3] * c0 + m[4] * c1 + m[5] * c2);
+        d[2] = store(m[6] * c0 + m[7] * c1 + m[8] * c2);
+    }
+}
+
+inline float storeFloat(float v)
+{
+    return v;
+}
+
+// Row converters with a common signature, for compositeMotion()
+typedef void (*ToWorkingRow)(const unsigned char* s, float* d, int cols);
+typedef void (*FromWorkingRow)(const float* s, unsigned char* d, int cols);
+
+void labInRow(const unsigned char* s, float* d, int cols)
+{
+    bgr8ToLabRow(s, d, cols, getSRGBTables());
+}
+
+void labOutRow(const float* s, unsigned char* d, int cols)
+{
+    labToBGR8Row(s, d, cols, getSRGBTables());
+}
+
+void yiqInRow(const unsigned char* s, float* d, int cols)
+{
+    transformRow(s, d, cols, getYIQMatrices().forward, storeFloat);
+}
+
+void yiqOutRow(const float* s, unsigned char* d, int cols)
+{
+    transformRow(s, d, cols, getYIQMatrices().inverse, saturate8);
+}
+
+// Bilinear taps of one axis. Destination pixel centres are mapped into the frame
+// like resize(INTER_LINEAR) does, then into the pyramid level like pyrUp does
+// (level pixel i sits on frame pixel i * 2^level).
+void getMotionTaps(int dst_length, int frame_length, int level, int motion_length, std::vector<int>& i0,
+                   std::vector<float>& w)
+{
+    i0.resize(dst_length);
+    w.resize(dst_length);
+    const double scale = static_cast<double>(frame_length) / dst_length;
+    const double level_scale = 1.0 / (1 << level);
+    for (int x = 0; x < dst_length; ++x)
+    {
+        double p = ((x + 0.5) * scale - 0.5) * level_scale;
+        p = std::min(std::max(p, 0.0), static_cast<double>(motion_length - 1));
+        i0[x] = std::min(static_cast<int>(p), std::max(motion_length - 2, 0));
+        w[x] = static_cast<float>(p - i0[x]);
+    }
+}
+
+// r[x] += channel_scale * motion, bilinearly upsampled to row y of the output
+inline void addMotionRow(const cv::Mat& motion, int y, const std::vector<int>& x0, const std::vector<float>& wx,
+                         const std::vector<int>& y0, const std::vector<float>& wy, const float* channel_scale,
+                         float* r, int cols)
+{
+    const int mcn = motion.channels();
+    const int x_step = (motion.cols > 1) ? mcn : 0;
+    const float* m0 = motion.ptr<float>(y0[y]);
+    const float* m1 = motion.ptr<float>(std::min(y0[y] + 1, motion.rows - 1));
+    const float v = wy[y];
+    for (int x = 0; x < cols; ++x, r += 3)
+    {
+        const int i = x0[x] * mcn;
+        const float u = wx[x];
+        for (int c = 0; c < mcn; ++c)
+        {
+            const float top = m0[i + c] + u * (m0[i + x_step + c] - m0[i + c]);
+            const float bottom = m1[i + c] + u * (m1[i + x_step + c] - m1[i + c]);
+            r[c] += channel_scale[c] * (top + v * (bottom - top));
+        }
+    }
+}
+
+void compositeMotion(const cv::Mat& src, const cv::Mat& motion, const std::vector<int>& x0,
+                     const std::vector<float>& wx, const std::vector<int>& y0, const std::vector<float>& wy,
+                     const float* channel_scale, cv::Mat& rows, cv::Mat& dst, ToWorkingRow to_working,
+                     FromWorkingRow from_working)
+{
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+    {
+        float* row = rows.ptr<float>(omp_get_thread_num());
+        to_working(src.ptr<unsigned char>(y), row, src.cols);
+        addMotionRow(motion, y, x0, wx, y0, wy, channel_scale, row, src.cols);
+        from_working(row, dst.ptr<unsigned char>(y), src.cols);
+    }
+}
+
+}  // namespace
+
+void convertBGR8ToLab(const cv::Mat& src, cv::Mat& dst)
+{
+    CV_Assert(src.type() == CV_8UC3);
+    dst.create(src.size(), CV_32FC3);
+    const SRGBTables& tables = getSRGBTables();
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+        bgr8ToLabRow(src.ptr<unsigned char>(y), dst.ptr<float>(y), src.cols, tables);
+}
+
+void convertLabToBGR8(const cv::Mat& src, cv::Mat& dst)
+{
+    CV_Assert(src.type() == CV_32FC3);
+    dst.create(src.size(), CV_8UC3);
+    const SRGBTables& tables = getSRGBTables();
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+        labToBGR8Row(src.ptr<float>(y), dst.ptr<unsigned char>(y), src.cols, tables);
+}
+
+void convertBGR8ToYIQ(const cv::Mat& src, cv::Mat& dst)
+{
+    CV_Assert(src.type() == CV_8UC3);
+    dst.create(src.size(), CV_32FC3);
+    const YIQMatrices& m = getYIQMatrices();
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+        transformRow(src.ptr<unsigned char>(y), dst.ptr<float>(y), src.cols, m.forward, storeFloat);
+}
+
+void convertYIQToBGR8(const cv::Mat& src, cv::Mat& dst)
+{
+    CV_Assert(src.type() == CV_32FC3);
+    dst.create(src.size(), CV_8UC3);
+    const YIQMatrices& m = getYIQMatrices();
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+        transformRow(src.ptr<float>(y), dst.ptr<unsigned char>(y), src.cols, m.inverse, saturate8);
+}
+
+MotionCompositor::MotionCompositor()
+        : x0_()
+        , y0_()
+        , wx_()
+        , wy_()
+        , rows_()
+        , dst_size_()
+        , motion_size_()
+        , frame_size_()
+        , level_(-1)
+{
+}
+
+void MotionCompositor::prepare(const cv::Mat& src, const cv::Mat& motion, int level, const cv::Size& frame_size)
+{
+    CV_Assert((src.type() == CV_8UC3 || src.type() == CV_32FC3) && !motion.empty() &&
+              (motion.type() == CV_32FC3 || motion.type() == CV_32FC1));
+
+    // create() keeps the buffer when the row count and width are unchanged
+    rows_.create(std::max(omp_get_max_threads(), 1), src.cols * 3, CV_32F);
+
+    if (src.size() == dst_size_ && motion.size() == motion_size_ && frame_size == frame_size_ && level == level_)
+        return;
+    getMotionTaps(src.cols, frame_size.width, level, motion.cols, x0_, wx_);
+    getMotionTaps(src.rows, frame_size.height, level, motion.rows, y0_, wy_);
+    dst_size_ = src.size();
+    motion_size_ = motion.size();
+    frame_size_ = frame_size;
+    level_ = level;
+}
+
+void MotionCompositor::compositeLab(const cv::Mat& src, const cv::Mat& motion, int level, const cv::Size& frame_size,
+                                    const float* channel_scale, cv::Mat& dst)
+{
+    prepare(src, motion, level, frame_size);
+    dst.create(src.size(), CV_8UC3);
+    compositeMotion(src, motion, x0_, wx_, y0_, wy_, channel_scale, rows_, dst, labInRow, labOutRow);
+}
+
+void MotionCompositor::compositeYIQ(const cv::Mat& src, const cv::Mat& motion, int level, const cv::Size& frame_size,
+                                    const float* channel_scale, cv::Mat& dst)
+{
+    prepare(src, motion, level, frame_size);
+    dst.create(src.size(), CV_8UC3);
+    compositeMotion(src, motion, x0_, wx_, y0_, wy_, channel_scale, rows_, dst, yiqInRow, yiqOutRow);
+}
+
+void MotionCompositor::addMotion(const cv::Mat& src, const cv::Mat& motion, int level, const cv::Size& frame_size,
+                                 const float* channel_scale, cv::Mat& dst)
+{
+    CV_Assert(src.type() == CV_32FC3);
+    prepare(src, motion, level, frame_size);
+    dst.create(src.size(), CV_32FC3);
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+    {
+        float* row = dst.ptr<float>(y);
+        if (src.data != dst.data)
+            std::copy(src.ptr<float>(y), src.ptr<float>(y) + 3 * src.cols, row);
+        addMotionRow(motion, y, x0_, wx_, y0_, wy_, channel_scale, row, src.cols);
+    }
+}
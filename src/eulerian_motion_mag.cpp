@@ -13,203 +13,559 @@
 
 #include "eulerian_motion_mag.h"
 
-#define DISPLAY_WINDOW_NAME "Motion Magnified Output"
+namespace
+{
+
+// dst = lab with a one channel motion image added to its first channel
+void addLumaMotion(const cv::Mat& lab, const cv::Mat& motion, cv::Mat& dst)
+{
+    CV_Assert(lab.type() == CV_32FC3 && motion.type() == CV_32FC1 && lab.size() == motion.size());
+    dst.create(lab.size(), lab.type());
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < lab.rows; ++y)
+    {
+        const float* s = lab.ptr<float>(y);
+        const float* m = motion.ptr<float>(y);
+        float* d = dst.ptr<float>(y);
+        for (int x = 0; x < lab.cols; ++x)
+        {
+            d[3 * x] = s[3 * x] + m[x];
+            d[3 * x + 1] = s[3 * x + 1];
+            d[3 * x + 2] = s[3 * x + 2];
+        }
+    }
+}
+
+}  // namespace
+
+MotionMagConfig::MotionMagConfig()
+        : input_width(0)
+        , input_height(0)
+        , output_width(0)
+        , output_height(0)
+        , alpha(20)
+        , lambda_c(16)
+        , chrom_attenuation(0.1)
+        , exaggeration_factor(2.0)
+        , levels(5)
+        , temporal_filter("iir")
+        , cutoff_freq_low(0.05)  // Hz
+        , cutoff_freq_high(0.4)  // Hz
+        , sdft_window(64)
+        , freq_band_low(0.4)
+        , freq_band_high(3.0)
+        , input_fps(30)
+        , fused_kernel(false)
+        , fast_pyramid(false)
+        , fused_color(false)
+        , precision("float")
+        , color_space("lab")
+        , luma_only(false)
+        , direct_output(false)
+        , motion_scale(1.0)
+        , num_threads(0)
+        , shared_num_threads(NULL)
+        , unit_gain(false)
+        , gain_size()
+{
+}
 
 EulerianMotionMag::EulerianMotionMag()
-        : input_file_name_()
-        , output_file_name_()
-        , input_img_width_(0)
-        , input_img_height_(0)
-        , input_cap_(NULL)
-        , output_img_width_(0)
-        , output_img_height_(0)
-        , output_cap_(NULL)
-        , write_output_file_(false)
-        , lap_pyramid_levels_(5)
-        , loop_time_ms_(0)
-        , cutoff_freq_low_(0.05)  // Hz
-        , cutoff_freq_high_(0.4)  // Hz
-        , lambda_c_(16)
-        , alpha_(20)
-        , chrom_attenuation_(0.1)
-        , exaggeration_factor_(2.0)
+        : config_()
         , delta_(0)
         , lambda_(0)
+        , compositor_()
+        , motion_level_offset_(0)
+        , band_active_()
+        , band_coarsest_(-1)
+        , temporal_filters_()
         , frame_num_(0)
-        , frame_count_(0)
-        , input_fps_(30)
 {
 }
 
-EulerianMotionMag::~EulerianMotionMag()
+bool EulerianMotionMag::init(const MotionMagConfig& config, const cv::Size& frame_size)
 {
-    if (input_cap_ != NULL)
-        input_cap_->release();
+    config_ = config;
+    motion_level_offset_ = 0;
+    if (config_.input_width <= 0 || config_.input_height <= 0)
+    {
+        // Use default input image size
+        config_.input_width = frame_size.width;
+        config_.input_height = frame_size.height;
+    }
 
-    if (output_cap_ != NULL)
-        output_cap_->release();
-}
+    if (config_.output_width <= 0 || config_.output_height <= 0)
+    {
+        // Use input image size for output
+        config_.output_width = config_.input_width;
+        config_.output_height = config_.input_height;
+    }
 
-bool EulerianMotionMag::init()
-{
-    // Input:
-    // Input File:
-    input_cap_ = new cv::VideoCapture(input_file_name_);
-    if (!input_cap_->isOpened())
+    if (config_.input_width <= 0 || config_.input_height <= 0)
     {
-        std::cerr << "Error: Unable to open input video file: " << input_file_name_ << std::endl;
+        std::cerr << "Error: Invalid input image size (" << config_.input_width << ", " << config_.input_height << ")"
+                  << std::endl;
         return false;
     }
 
-    if (input_img_width_ <= 0 || input_img_height_ <= 0)
+    if (config_.levels < 1)
     {
-        // Use default input image size
-        input_img_width_ = input_cap_->get(CV_CAP_PROP_FRAME_WIDTH);
-        input_img_height_ = input_cap_->get(CV_CAP_PROP_FRAME_HEIGHT);
+        std::cerr << "Error: Laplacian Pyramid Levels should be larger than 1" << std::endl;
+        return false;
     }
-    frame_count_ = input_cap_->get(CV_CAP_PROP_FRAME_COUNT);
-    input_fps_ = input_cap_->get(CV_CAP_PROP_FPS);
-    std::cout << "Input video resolution is (" << input_img_width_ << ", " << input_img_height_ << ")" << std::endl;
 
-    // Output:
-    // Output Display Window
-    cvNamedWindow(DISPLAY_WINDOW_NAME, CV_WINDOW_AUTOSIZE);
-    if (output_img_width_ <= 0 || output_img_height_ <= 0)
+    if (config_.color_space != "lab" && config_.color_space != "yiq")
     {
-        // Use input image size for output
-        output_img_width_ = input_img_width_;
-        output_img_height_ = input_img_height_;
+        std::cerr << "Error: Unsupported color space: " << config_.color_space << " (use lab or yiq)" << std::endl;
+        return false;
     }
 
-    std::cout << "Output video resolution is (" << output_img_width_ << ", " << output_img_height_ << ")" << std::endl;
+    if (config_.precision != "float" && config_.precision != "int16")
+    {
+        std::cerr << "Error: Unsupported precision: " << config_.precision << " (use float or int16)" << std::endl;
+        return false;
+    }
 
-    // Output File:
-    if (!output_file_name_.empty())
-        write_output_file_ = true;
+    if (config_.precision == "int16" && (!config_.fused_kernel || !config_.fast_pyramid))
+    {
+        // Fixed-point levels and IIR state are only implemented by the fused kernel
+        // and the pyramid engine
+        std::cout << "Reduced precision (int16) uses the fused temporal kernel and the fast pyramid" << std::endl;
+        config_.fused_kernel = true;
+        config_.fast_pyramid = true;
+    }
 
-    if (write_output_file_)
+    if (config_.temporal_filter == "sdft")
     {
-        output_cap_ = new cv::VideoWriter(output_file_name_,                                // filename
-                                          getCodecNumber(output_file_name_),                // codec to be used
-                                          input_fps_,                                       // frame rate of the video
-                                          cv::Size(output_img_width_, output_img_height_),  // frame size
-                                          true                                              // color video
-        );  // NOLINT [whitespace/braces]
-        if (!output_cap_->isOpened())
+        int bin_low, bin_high;
+        if (!SlidingDFTFilter::getBandBins(config_.sdft_window, config_.input_fps, config_.freq_band_low,
+                                           config_.freq_band_high, bin_low, bin_high))
+        {
+            std::cerr << "Error: No DFT bin of a " << config_.sdft_window << " frame window falls in ["
+                      << config_.freq_band_low << ", " << config_.freq_band_high << "] Hz at " << config_.input_fps
+                      << " fps" << std::endl;
+            return false;
+        }
+
+        if (config_.precision == "int16")
         {
-            std::cerr << "Error: Unable to create output video file: " << output_file_name_ << std::endl;
+            std::cerr << "Error: int16 precision is only supported by the iir temporal filter" << std::endl;
             return false;
         }
+
+        if (config_.fused_kernel)
+        {
+            std::cout << "Sliding DFT filter does not use the fused temporal kernel" << std::endl;
+            config_.fused_kernel = false;
+        }
+    }
+    else if (config_.temporal_filter != "iir")
+    {
+        std::cerr << "Error: Unsupported temporal filter: " << config_.temporal_filter << " (use iir or sdft)"
+                  << std::endl;
+        return false;
     }
 
-    std::cout << "Init Successful" << std::endl;
+    if (!initMotionScale())
+        return false;
+
+    buildBandPlan();
+    allocateWorkspace();
+    reset();
+    if (config_.temporal_filter == "sdft")
+        reportSlidingDFTMemory();
     return true;
 }
 
-void EulerianMotionMag::run()
+void EulerianMotionMag::reportSlidingDFTMemory() const
 {
-    std::cout << "Running Eulerian Motion Magnification...\n" << std::endl;
+    // The window ring and the bins are full float planes of every amplified level
+    int bin_low, bin_high;
+    SlidingDFTFilter::getBandBins(config_.sdft_window, config_.input_fps, config_.freq_band_low, config_.freq_band_high,
+                                  bin_low, bin_high);
+    size_t bytes = 0;
+    for (size_t l = 0; l < img_vec_filtered_.size(); ++l)
+    {
+        if (l < band_active_.size() && band_active_[l])
+            bytes += SlidingDFTFilter::getStateBytes(img_vec_filtered_[l].size(), img_vec_filtered_[l].type(),
+                                                     config_.sdft_window, bin_low, bin_high);
+    }
 
-    while (1)
+    const size_t mb = bytes >> 20;
+    std::cout << "Sliding DFT filter: " << config_.sdft_window << " frame window, " << (bin_high - bin_low + 1)
+              << " bins, " << mb << " MB of state" << std::endl;
+    if (mb >= 256)
+        std::cout << "Warning: The sliding DFT state is large, use a shorter sdft_window, more "
+                  << "motion_scale or the iir filter" << std::endl;
+}
+
+bool EulerianMotionMag::initMotionScale()
+{
+    if (config_.motion_scale == 1.0)
+        return true;
+
+    // Only powers of two keep the bands on the levels of the full resolution pyramid
+    const int offset = (config_.motion_scale > 0) ? static_cast<int>(floor(-log2(config_.motion_scale) + 0.5)) : 0;
+    if (offset < 1 || ldexp(1.0, -offset) != config_.motion_scale)
+    {
+        std::cerr << "Error: Unsupported motion scale: " << config_.motion_scale << " (use 1, 0.5, 0.25, ...)"
+                  << std::endl;
+        return false;
+    }
+    if (config_.levels - offset < 1)
     {
-        timer_.start();
+        std::cerr << "Error: Motion scale " << config_.motion_scale << " needs more than " << offset
+                  << " Laplacian Pyramid Levels" << std::endl;
+        return false;
+    }
 
-        input_cap_->read(img_input_);
-        if (img_input_.empty())
-            break;
+    // Level i of the scaled down frame stands in for level i + offset of the full
+    // frame: gains come from the full size, and the finest level is amplified
+    if (config_.gain_size.area() <= 0)
+        config_.gain_size = cv::Size(config_.input_width, config_.input_height);
+    config_.input_width = (config_.input_width + (1 << offset) - 1) >> offset;
+    config_.input_height = (config_.input_height + (1 << offset) - 1) >> offset;
+    config_.levels -= offset;
+    motion_level_offset_ = offset;
+    std::cout << "Motion is estimated at " << config_.input_width << "x" << config_.input_height << " on "
+              << config_.levels << " levels" << std::endl;
+
+    if (!config_.direct_output)
+    {
+        std::cout << "Motion scale composites at the output size (direct_output)" << std::endl;
+        config_.direct_output = true;
+    }
+    config_.motion_scale = 1.0;
+    return true;
+}
+
+void EulerianMotionMag::reset()
+{
+    // Next frame re-initializes the temporal filter state
+    frame_num_ = 0;
+}
+
+void EulerianMotionMag::process(const cv::Mat& input, cv::Mat& output)
+{
+    // OpenMP thread count is per calling thread, and process() may run on a pipeline thread
+    setFrameThreads();
+    decompose(input);
+    processBands(img_input_lab_, img_vec_lap_pyramid_, &input, output);
+}
+
+void EulerianMotionMag::decompose(const cv::Mat& input, const std::vector<bool>* bands)
+{
+    // resize input image
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_RESIZE);
+        resize(input, img_input_, cv::Size(config_.input_width, config_.input_height), 0, 0,
+               (motion_level_offset_ > 0) ? cv::INTER_AREA : cv::INTER_LINEAR);
+    }
 
-        std::cout << "Processing image frame: " << frame_num_ << " / " << frame_count_ << std::flush;
+    // 1. Convert to Lab color space
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_COLOR_IN);
+        convertInputColor(img_input_, img_input_lab_);
+    }
 
-        // resize input image
-        resize(img_input_, img_input_, cv::Size(input_img_width_, input_img_height_));
+    // 2. Spatial filtering one frame (residuals of the amplified bands only)
+    const cv::Mat* spatial_input = &img_input_lab_;
+    if (config_.luma_only)
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_COLOR_IN);
+        cv::extractChannel(img_input_lab_, img_input_luma_, 0);
+        spatial_input = &img_input_luma_;
+    }
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_PYRAMID);
+        buildPyramidBands(*spatial_input, config_.levels, (bands != NULL) ? bands : &band_active_, img_vec_lap_pyramid_);
+    }
+}
 
-        // 1. Convert to Lab color space
-        img_input_lab_ = img_input_.clone();
-        img_input_lab_.convertTo(img_input_lab_, CV_32FC3, 1.0 / 255.0f);
-        cvtColor(img_input_lab_, img_input_lab_, CV_BGR2Lab);
+void EulerianMotionMag::skip(const cv::Mat& input)
+{
+    setFrameThreads();
+    decompose(input);
+    filterBands(img_vec_lap_pyramid_);
+}
 
-        // 2. Spatial filtering one frame
-        img_spatial_filter_ = img_input_lab_.clone();
-        buildLaplacianPyramid(img_spatial_filter_, lap_pyramid_levels_, img_vec_lap_pyramid_);
+void EulerianMotionMag::filterBands(const std::vector<cv::Mat>& pyramid)
+{
+    filterLevels(pyramid);
+    frame_num_++;
+}
 
-        if (frame_num_ == 0)
+// Step 3 on a decomposed frame: seeds the filter state on the first frame,
+// then runs the temporal filter and the gains into img_vec_filtered_
+void EulerianMotionMag::filterLevels(const std::vector<cv::Mat>& pyramid)
+{
+    if (frame_num_ == 0)
+    {
+        // For first image frame
+        initBandState(pyramid);
+    }
+    else if (config_.fused_kernel)
+    {
+        // 3. Temporal filter, amplify and attenuate I, Q channels in a single sweep per level
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_TEMPORAL);
+        const float chrom = config_.unit_gain ? 1.0f : static_cast<float>(config_.chrom_attenuation);
+        const float chrom_scale[3] = {1.0f, chrom, chrom};
+        for (int i = 0; i <= config_.levels; ++i)
         {
-            // For first image frame
-            img_vec_lowpass_1_ = img_vec_lap_pyramid_;
-            img_vec_lowpass_2_ = img_vec_lap_pyramid_;
-            img_vec_filtered_ = img_vec_lap_pyramid_;
+            if (band_active_[i])
+                temporal_filters_[i]->applyScaled(pyramid[i], img_vec_filtered_[i], level_alpha_[i], chrom_scale);
         }
-        else
+    }
+    else
+    {
+        // 3. Temporal filter and amplify each level
         {
-            for (int i = 0; i < lap_pyramid_levels_; ++i)
+            EMM_PROFILE_SCOPE(&profiler_, STAGE_TEMPORAL);
+            for (int i = 0; i <= config_.levels; ++i)
             {
-                temporalIIRFilter(img_vec_lap_pyramid_[i], img_vec_filtered_[i], i);
+                if (band_active_[i])
+                    temporal_filters_[i]->apply(pyramid[i], img_vec_filtered_[i]);
             }
+        }
+        if (config_.unit_gain)
+            return;
 
-            // Amplify each spatial frequency bands, according to Figure 6 of paper
-            delta_ = lambda_c_ / 8.0 / (1.0 + alpha_);
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_AMPLIFY);
+        for (int i = 0; i <= config_.levels; ++i)
+        {
+            if (band_active_[i])
+                amplify(img_vec_filtered_[i], img_vec_filtered_[i], i);
+        }
+    }
+}
 
-            // the factor to boost alpha_ above the bound (for better visualization)
-            exaggeration_factor_ = 2.0;
+void EulerianMotionMag::processBands(const cv::Mat& lab, const std::vector<cv::Mat>& pyramid, const cv::Mat* source,
+                                     cv::Mat& output)
+{
+    filterLevels(pyramid);
+
+    // 4. reconstruct motion image from img_vec_filtered_ pyramid, starting at the
+    //    coarsest amplified band (the first frame only seeds the filter state).
+    //    Direct output stops at level 1, level 0 never has gain and the last
+    //    upsampling step is folded into compositeOutput(). A scaled down frame
+    //    has gain on level 0.
+    const bool direct = config_.direct_output && source != NULL;
+    const int motion_level = (direct && motion_level_offset_ == 0) ? 1 : 0;
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_RECONSTRUCT);
+        if (frame_num_ > 0 && band_coarsest_ >= motion_level)
+            reconBands(img_vec_filtered_, band_coarsest_, motion_level, &band_active_, img_motion_);
+        else
+            img_motion_.setTo(cv::Scalar::all(0));
+    }
 
-            // compute the representative wavelength lambda_
-            // for the lowest spatial frequency band of Laplacian pyramid
-            // Note: 3 is experimental constant
-            lambda_ = sqrt((float)(input_img_width_ * input_img_width_ + input_img_height_ * input_img_height_)) / 3;
+    if (direct)
+    {
+        compositeOutput(*source, motion_level, output);
+        frame_num_++;
+        return;
+    }
 
-            for (int i = lap_pyramid_levels_; i >= 0; i--)
-            {
-                amplify(img_vec_filtered_[i], img_vec_filtered_[i], i);
+    // 5. attenuate I, Q channels (already applied per level by the fused kernel,
+    //    luma only has none)
+    if (!config_.fused_kernel && !config_.luma_only)
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_ATTENUATE);
+        attenuate(img_motion_, img_motion_);
+    }
 
-                // go one level down on pyramid
-                // representative lambda_ will reduce by factor of 2
-                lambda_ /= 2.0;
-            }
-        }
+    // 6. combine source frame and motion image
+    if (frame_num_ > 0 && config_.luma_only)
+        addLumaMotion(lab, img_motion_, img_spatial_filter_);
+    else if (frame_num_ > 0)  // don't amplify first frame
+        add(lab, img_motion_, img_spatial_filter_);
+    else
+        lab.copyTo(img_spatial_filter_);
 
-        // 4. reconstruct motion image from img_vec_filtered_ pyramid
-        reconImgFromLaplacianPyramid(img_vec_filtered_, lap_pyramid_levels_, img_motion_);
+    // 7. convert back to rgb color space and CV_8UC3
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_COLOR_OUT);
+        convertOutputColor(img_spatial_filter_, img_motion_mag_);
+    }
 
-        // 5. attenuate I, Q channels
-        attenuate(img_motion_, img_motion_);
+    // resize output image
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_RESIZE);
+        resize(img_motion_mag_, output, cv::Size(config_.output_width, config_.output_height));
+    }
 
-        // 6. combine source frame and motion image
-        if (frame_num_ > 0)  // don't amplify first frame
-            img_spatial_filter_ += img_motion_;
+    frame_num_++;
+}
 
-        // 7. convert back to rgb color space and CV_8UC3
-        img_motion_mag_ = img_spatial_filter_.clone();
-        cvtColor(img_motion_mag_, img_motion_mag_, CV_Lab2BGR);
-        img_motion_mag_.convertTo(img_motion_mag_, CV_8UC3, 255.0, 1.0 / 255.0);
+void EulerianMotionMag::initBandState(const std::vector<cv::Mat>& pyramid)
+{
+    // The temporal filter of every amplified band starts at the first frame
+    for (int i = 0; i <= config_.levels; ++i)
+    {
+        if (!band_active_[i])
+            continue;
+        temporal_filters_[i]->init(pyramid[i]);
+        pyramid[i].copyTo(img_vec_filtered_[i]);
+    }
+}
 
-        // resize output image
-        resize(img_motion_mag_, img_motion_mag_, cv::Size(output_img_width_, output_img_height_));
+void EulerianMotionMag::allocateWorkspace()
+{
+    // Every buffer used by process() is sized once here, so that the
+    // per-frame OpenCV calls only ever write into existing storage. The repo's
+    // kernels (fast_pyramid, fused_kernel, fused_color) then do no heap
+    // allocation at all; OpenCV's pyrDown / pyrUp, cvtColor and resize still
+    // allocate scratch inside each call (see test/test_allocations.cpp).
+    cv::Size size(config_.input_width, config_.input_height);
+    img_input_.create(size, CV_8UC3);
+    img_input_float_.create(size, CV_32FC3);
+    img_input_lab_.create(size, CV_32FC3);
+    if (config_.luma_only)
+        img_input_luma_.create(size, CV_32FC1);
+    else
+        img_input_luma_.release();
+    img_spatial_filter_.create(size, CV_32FC3);
+    // Direct output keeps the motion image at pyramid level 1 (unless level 0 has gain)
+    const bool motion_half = config_.direct_output && motion_level_offset_ == 0;
+    const int band_type = CV_MAKETYPE(CV_32F, getBandChannels());
+    const int level_type = getLevelType();
+    img_motion_.create(motion_half ? cv::Size((size.width + 1) / 2, (size.height + 1) / 2) : size, band_type);
+    img_output_float_.create(size, CV_32FC3);
+    img_motion_mag_.create(size, CV_8UC3);
+    if (config_.direct_output && !config_.fused_color && config_.color_space != "yiq")
+    {
+        const cv::Size output_size(config_.output_width, config_.output_height);
+        img_output_bgr_float_.create(output_size, CV_32FC3);
+        img_output_lab_.create(output_size, CV_32FC3);
+    }
 
-        imshow(DISPLAY_WINDOW_NAME, img_motion_mag_);
-        if (write_output_file_)
-            output_cap_->write(img_motion_mag_);
+    const int levels = std::max(config_.levels, 1);
+    pyramid_engine_.init(size.width, getBandChannels());
+    img_vec_lap_pyramid_.resize(levels + 1);
+    img_vec_lowpass_1_.resize(levels + 1);
+    img_vec_lowpass_2_.resize(levels + 1);
+    img_vec_filtered_.resize(levels + 1);
+    temporal_filters_.resize(levels + 1);
+    img_vec_pyr_down_.resize(levels);
+    img_vec_pyr_up_.resize(levels);
+
+    cv::Size level_size = size;
+    for (int l = 0; l <= levels; ++l)
+    {
+        img_vec_lap_pyramid_[l].create(level_size, level_type);
+        if (l < levels)
+            img_vec_pyr_up_[l].create(level_size, band_type);
+        if (band_active_[l])
+            img_vec_filtered_[l].create(level_size, level_type);
+        else
+            img_vec_filtered_[l].release();
+
+        // no gain, no filter state. The IIR states are shared with the
+        // lowpass vectors for getLowpassState1/2(); the sliding DFT sizes its
+        // window buffers on the first frame.
+        temporal_filters_[l].release();
+        img_vec_lowpass_1_[l].release();
+        img_vec_lowpass_2_[l].release();
+        if (band_active_[l] && config_.temporal_filter == "iir")
+        {
+            IIRBandpassFilter* iir = new IIRBandpassFilter(config_.cutoff_freq_low, config_.cutoff_freq_high,
+                                                           level_size, getStateType());
+            img_vec_lowpass_1_[l] = iir->getLowpass1();
+            img_vec_lowpass_2_[l] = iir->getLowpass2();
+            temporal_filters_[l] = cv::Ptr<TemporalFilter>(iir);
+        }
+        else if (band_active_[l] && config_.temporal_filter == "sdft")
+        {
+            int bin_low, bin_high;
+            SlidingDFTFilter::getBandBins(config_.sdft_window, config_.input_fps, config_.freq_band_low,
+                                          config_.freq_band_high, bin_low, bin_high);
+            temporal_filters_[l] = cv::Ptr<TemporalFilter>(new SlidingDFTFilter(config_.sdft_window, bin_low, bin_high));
+        }
 
-        frame_num_++;
-        loop_time_ms_ = timer_.getTimeMilliSec();
-        std::cout << " | Time taken: " << loop_time_ms_ << " ms" << std::endl;
+        // pyrDown output size
+        level_size = cv::Size((level_size.width + 1) / 2, (level_size.height + 1) / 2);
+        if (l < levels)
+            img_vec_pyr_down_[l].create(level_size, band_type);
+    }
+}
 
-        char c = cv::waitKey(1);
-        if (c == 27)
-            break;
+void EulerianMotionMag::convertInputColor(const cv::Mat& src, cv::Mat& dst)
+{
+    if (config_.color_space == "yiq")
+    {
+        convertBGR8ToYIQ(src, dst);
+    }
+    else if (config_.fused_color)
+    {
+        convertBGR8ToLab(src, dst);
+    }
+    else
+    {
+        src.convertTo(img_input_float_, CV_32FC3, 1.0 / 255.0f);
+        cvtColor(img_input_float_, dst, CV_BGR2Lab);
     }
 }
 
-int EulerianMotionMag::getCodecNumber(std::string file_name)
+void EulerianMotionMag::compositeOutput(const cv::Mat& source, int motion_level, cv::Mat& output)
 {
-    std::string file_extn = file_name.substr(file_name.find_last_of('.') + 1);
+    // The source frame is brought to the output size once (not at all when it has
+    // it already) instead of resized for processing and the result resized again
+    const cv::Size output_size(config_.output_width, config_.output_height);
+    const cv::Mat* frame = &source;
+    if (source.size() != output_size)
+    {
+        EMM_PROFILE_SCOPE(&profiler_, STAGE_RESIZE);
+        resize(source, img_output_source_, output_size);
+        frame = &img_output_source_;
+    }
+
+    EMM_PROFILE_SCOPE(&profiler_, STAGE_COLOR_OUT);
+    if (frame_num_ == 0 || band_coarsest_ < motion_level)
+    {
+        // don't amplify first frame
+        frame->copyTo(output);
+        return;
+    }
+
+    // I, Q attenuation is applied here unless the fused kernel did it per level
+    const float chrom = config_.fused_kernel ? 1.0f : static_cast<float>(config_.chrom_attenuation);
+    const float channel_scale[3] = {1.0f, chrom, chrom};
+    const cv::Size frame_size(config_.input_width, config_.input_height);
+    if (config_.color_space == "yiq")
+    {
+        compositor_.compositeYIQ(*frame, img_motion_, motion_level, frame_size, channel_scale, output);
+    }
+    else if (config_.fused_color)
+    {
+        compositor_.compositeLab(*frame, img_motion_, motion_level, frame_size, channel_scale, output);
+    }
+    else
+    {
+        // cvtColor over the whole frame both ways, the motion is added in between
+        frame->convertTo(img_output_bgr_float_, CV_32FC3, 1.0 / 255.0f);
+        cvtColor(img_output_bgr_float_, img_output_lab_, CV_BGR2Lab);
+        compositor_.addMotion(img_output_lab_, img_motion_, motion_level, frame_size, channel_scale, img_output_lab_);
+        cvtColor(img_output_lab_, img_output_bgr_float_, CV_Lab2BGR);
+        img_output_bgr_float_.convertTo(output, CV_8UC3, 255.0, 1.0 / 255.0);
+    }
+}
 
-    // Currently supported video formats are AVI and MPEG-4
-    if (file_extn == "avi")
-        return CV_FOURCC('M', 'J', 'P', 'G');
-    else if (file_extn == "mp4")
-        return CV_FOURCC('D', 'I', 'V', 'X');
+void EulerianMotionMag::convertOutputColor(const cv::Mat& src, cv::Mat& dst)
+{
+    if (config_.color_space == "yiq")
+    {
+        convertYIQToBGR8(src, dst);
+    }
+    else if (config_.fused_color)
+    {
+        convertLabToBGR8(src, dst);
+    }
     else
-        return -1;
+    {
+        cvtColor(src, img_output_float_, CV_Lab2BGR);
+        img_output_float_.convertTo(dst, CV_8UC3, 255.0, 1.0 / 255.0);
+    }
 }
 
 cv::Mat EulerianMotionMag::LaplacianPyr(cv::Mat img)
@@ -222,6 +578,12 @@ cv::Mat EulerianMotionMag::LaplacianPyr(cv::Mat img)
 }
 
 bool EulerianMotionMag::buildLaplacianPyramid(const cv::Mat& img, const int levels, std::vector<cv::Mat>& pyramid)
+{
+    return buildPyramidBands(img, levels, NULL, pyramid);
+}
+
+bool EulerianMotionMag::buildPyramidBands(const cv::Mat& img, const int levels, const std::vector<bool>* bands,
+                                          std::vector<cv::Mat>& pyramid)
 {
     if (levels < 1)
     {
@@ -229,60 +591,179 @@ bool EulerianMotionMag::buildLaplacianPyramid(const cv::Mat& img, const int leve
         return false;
     }
 
-    pyramid.clear();
-    cv::Mat currentImg = img;
-    for (int l = 0; l < levels; l++)
+    // Levels write into the workspace buffers, allocation only happens if the
+    // workspace does not match (first call with a different size or depth)
+    if (config_.fast_pyramid)
     {
-        cv::Mat down, up;
-        pyrDown(currentImg, down);
-        pyrUp(down, up, currentImg.size());
-        cv::Mat lap = currentImg - up;
-        pyramid.push_back(lap);
-        currentImg = down;
+        pyramid_engine_.buildPyramid(img, levels, bands, img_vec_pyr_down_, pyramid, CV_MAT_DEPTH(getLevelType()));
+        return true;
     }
-    pyramid.push_back(currentImg);
+
+    pyramid.resize(levels + 1);
+    img_vec_pyr_down_.resize(levels);
+    img_vec_pyr_up_.resize(levels);
+
+    // Bands outside the mask are not computed, nothing below the coarsest wanted one
+    int top = levels;
+    if (bands != NULL)
+        while (top >= 0 && !(*bands)[top])
+            top--;
+
+    const cv::Mat* current_img = &img;
+    for (int l = 0; l < std::min(top + 1, levels); l++)
+    {
+        pyrDown(*current_img, img_vec_pyr_down_[l]);
+        if (bands == NULL || (*bands)[l])
+        {
+            pyrUp(img_vec_pyr_down_[l], img_vec_pyr_up_[l], current_img->size());
+            subtract(*current_img, img_vec_pyr_up_[l], pyramid[l]);
+        }
+        current_img = &img_vec_pyr_down_[l];
+    }
+    if (top == levels)
+        current_img->copyTo(pyramid[levels]);
 
     return true;
 }
 
 void EulerianMotionMag::reconImgFromLaplacianPyramid(const std::vector<cv::Mat>& pyramid, const int levels, cv::Mat& dst)
 {
-    cv::Mat curr_img = pyramid[levels];
-    for (int i = levels - 1; i >= 0; --i)
+    if (levels == 0)
+    {
+        pyramid[0].copyTo(dst);
+        return;
+    }
+
+    reconBands(pyramid, levels, 0, NULL, dst);
+}
+
+void EulerianMotionMag::reconBands(const std::vector<cv::Mat>& pyramid, const int top, const int bottom,
+                                   const std::vector<bool>* bands, cv::Mat& dst)
+{
+    // Upsample into the pyr_up workspace, level bottom goes straight into dst.
+    // Bands outside the mask are all zero, so those levels are only upsampled.
+    img_vec_pyr_up_.resize(std::max<size_t>(img_vec_pyr_up_.size(), top));
+    if (config_.fast_pyramid)
+    {
+        level_sizes_.resize(top + 1);
+        for (int i = bottom; i <= top; ++i)
+            level_sizes_[i] = pyramid[i].empty() ? img_vec_lap_pyramid_[i].size() : pyramid[i].size();
+        pyramid_engine_.collapsePyramid(pyramid, level_sizes_, top, bottom, bands, img_vec_pyr_up_, dst);
+        return;
+    }
+
+    const cv::Mat* curr_img = &pyramid[top];
+    for (int i = top - 1; i >= bottom; --i)
     {
-        cv::Mat up;
-        pyrUp(curr_img, up, pyramid[i].size());
-        curr_img = up + pyramid[i];
+        const cv::Size size = pyramid[i].empty() ? img_vec_lap_pyramid_[i].size() : pyramid[i].size();
+        cv::Mat& level_dst = (i > bottom) ? img_vec_pyr_up_[i] : dst;
+
+        if (bands == NULL || (*bands)[i])
+        {
+            pyrUp(*curr_img, img_vec_pyr_up_[i], size);
+            add(img_vec_pyr_up_[i], pyramid[i], level_dst);
+        }
+        else
+        {
+            pyrUp(*curr_img, level_dst, size);
+        }
+        curr_img = &level_dst;
     }
-    dst = curr_img.clone();
+    if (top == bottom)
+        pyramid[bottom].copyTo(dst);
 }
 
 void EulerianMotionMag::temporalIIRFilter(const cv::Mat& src, cv::Mat& dst, int level)
 {
-    cv::Mat temp_1 = (1 - cutoff_freq_high_) * img_vec_lowpass_1_[level] + cutoff_freq_high_ * src;
-    cv::Mat temp_2 = (1 - cutoff_freq_low_) * img_vec_lowpass_2_[level] + cutoff_freq_low_ * src;
-    img_vec_lowpass_1_[level] = temp_1;
-    img_vec_lowpass_2_[level] = temp_2;
-    dst = img_vec_lowpass_1_[level] - img_vec_lowpass_2_[level];
+    temporal_filters_[level]->apply(src, dst);
 }
 
 void EulerianMotionMag::amplify(const cv::Mat& src, cv::Mat& dst, int level)
+{
+    dst = src * getLevelAlpha(level);
+}
+
+void EulerianMotionMag::resetLevelParams()
+{
+    // Amplify each spatial frequency bands, according to Figure 6 of paper
+    delta_ = config_.lambda_c / 8.0 / (1.0 + config_.alpha);
+
+    // compute the representative wavelength lambda_
+    // for the lowest spatial frequency band of Laplacian pyramid
+    // Note: 3 is experimental constant
+    const cv::Size size = (config_.gain_size.area() > 0) ? config_.gain_size
+                                                         : cv::Size(config_.input_width, config_.input_height);
+    lambda_ = sqrt((float)(size.width * size.width + size.height * size.height)) / 3;
+}
+
+void EulerianMotionMag::buildBandPlan()
+{
+    // The gains only depend on the parameters and the frame size, so the bands
+    // that amplify() would zero out are known before the first frame. With
+    // unit_gain every band is filtered as is.
+    resetLevelParams();
+    level_alpha_.assign(config_.levels + 1, 0.0);
+    band_active_.assign(config_.levels + 1, false);
+    band_coarsest_ = -1;
+    for (int i = config_.levels; i >= 0; i--)
+    {
+        level_alpha_[i] = config_.unit_gain ? 1.0 : computeLevelAlpha(i);
+        band_active_[i] = (level_alpha_[i] != 0);
+        if (band_active_[i] && band_coarsest_ < 0)
+            band_coarsest_ = i;
+
+        // go one level down on pyramid
+        // representative lambda_ will reduce by factor of 2
+        lambda_ /= 2.0;
+    }
+}
+
+int EulerianMotionMag::getBandChannels() const
+{
+    return config_.luma_only ? 1 : 3;
+}
+
+void EulerianMotionMag::setFrameThreads() const
+{
+    const int threads = (config_.shared_num_threads != NULL) ? config_.shared_num_threads->load() : config_.num_threads;
+    if (threads > 0)
+        omp_set_num_threads(threads);
+}
+
+int EulerianMotionMag::getStateType() const
+{
+    return CV_MAKETYPE((config_.precision == "int16") ? CV_16S : CV_32F, getBandChannels());
+}
+
+int EulerianMotionMag::getLevelType() const
+{
+    // The pyramid engine writes the same Q8.7 format the fixed-point state uses
+    return getStateType();
+}
+
+double EulerianMotionMag::getLevelAlpha(int level) const
+{
+    // Gains of the current band plan, computed once per plan by buildBandPlan()
+    if (level < 0 || level >= static_cast<int>(level_alpha_.size()))
+        return 0;
+    return level_alpha_[level];
+}
+
+double EulerianMotionMag::computeLevelAlpha(int level) const
 {
     double curr_alpha;
-    // Compute modified alpha_ for this level
+    // Compute modified alpha for this level
     curr_alpha = lambda_ / delta_ / 8 - 1;
-    curr_alpha *= exaggeration_factor_;
-    if (level == lap_pyramid_levels_ || level == 0)  // ignore the highest and lowest frequency band
-        dst = src * 0;
+    curr_alpha *= config_.exaggeration_factor;
+    // ignore the highest and lowest frequency band (of the full frame with motion_scale)
+    if (level == config_.levels || level + motion_level_offset_ == 0)
+        return 0;
     else
-        dst = src *std:: min(alpha_, curr_alpha);
+        return std::min(config_.alpha, curr_alpha);
 }
 
 void EulerianMotionMag::attenuate(cv::Mat& src, cv::Mat& dst)
 {
-    cv::Mat planes[3];
-    split(src, planes);
-    planes[1] = planes[1] * chrom_attenuation_;
-    planes[2] = planes[2] * chrom_attenuation_;
-    merge(planes, 3, dst);
+    // Per-channel scale in place, no split/merge temporaries
+    multiply(src, cv::Scalar(1.0, config_.chrom_attenuation, config_.chrom_attenuation), dst);
 }
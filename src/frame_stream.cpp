@@ -0,0 +1,477 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "frame_stream.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+// stdio buffer. Frame payloads are larger, so stdio moves them straight between the
+// pipe and the cv::Mat (no copy through the buffer); the buffer only batches headers.
+#define STREAM_BUFFER_SIZE (64 << 10)
+
+bool getFrameStreamFormat(const std::string& path, const std::string& format, bool& is_stream,
+                          FrameStreamFormat& stream_format)
+{
+    if (format.empty())
+    {
+        // "synthetic" or "synthetic:...", not a file such as synthetic_clip.avi
+        const std::string extn = path.substr(path.find_last_of('.') + 1);
+        const bool synthetic = (path == "synthetic" || path.compare(0, 10, "synthetic:") == 0);
+        is_stream = (path == "-" || extn == "y4m" || extn == "bgr" || synthetic);
+        stream_format = (extn == "bgr") ? STREAM_BGR : STREAM_Y4M;
+        if (synthetic)
+            stream_format = STREAM_SYNTHETIC;
+        return true;
+    }
+
+    is_stream = (format != "video");
+    if (format == "y4m")
+        stream_format = STREAM_Y4M;
+    else if (format == "bgr")
+        stream_format = STREAM_BGR;
+    else if (format == "synthetic")
+        stream_format = STREAM_SYNTHETIC;
+    else if (format != "video")
+        return false;
+    return true;
+}
+
+FrameStreamReader::FrameStreamReader()
+        : file_(NULL)
+        , owns_file_(false)
+        , seekable_(false)
+        , format_(STREAM_Y4M)
+        , size_()
+        , fps_(0)
+        , frame_count_(0)
+        , frame_index_(0)
+        , data_offset_(0)
+        , synthetic_freq_(0)
+        , synthetic_amplitude_(0)
+{
+}
+
+FrameStreamReader::~FrameStreamReader()
+{
+    close();
+}
+
+bool FrameStreamReader::open(const std::string& path, FrameStreamFormat format, const cv::Size& size, double fps)
+{
+    close();
+
+    format_ = format;
+    size_ = size;
+    fps_ = fps;
+    frame_count_ = 0;
+    frame_index_ = 0;
+    if (format_ == STREAM_SYNTHETIC)
+        return openSynthetic(path);
+
+    owns_file_ = (path != "-");
+    file_ = owns_file_ ? fopen(path.c_str(), "rb") : stdin;
+    if (file_ == NULL)
+    {
+        std::cerr << "Error: Unable to open input stream: " << path << std::endl;
+        return false;
+    }
+
+    buffer_.resize(STREAM_BUFFER_SIZE);
+    setvbuf(file_, &buffer_[0], _IOFBF, buffer_.size());
+
+    if (format_ == STREAM_Y4M && !readHeader())
+        return false;
+
+    if (size_.width <= 0 || size_.height <= 0 || fps_ <= 0)
+    {
+        std::cerr << "Error: Input stream needs a frame size and rate (" << size_.width << "x" << size_.height
+                  << " at " << fps_ << " fps)" << std::endl;
+        return false;
+    }
+    if (format_ == STREAM_Y4M)
+        planar_.create(cv::Size(size_.width, size_.height * 3 / 2), CV_8UC1);
+
+    // Regular files can be counted (and seeked), stdin and named pipes only read through
+    struct stat info;
+    seekable_ = (fstat(fileno(file_), &info) == 0 && S_ISREG(info.st_mode));
+    if (seekable_)
+    {
+        data_offset_ = ftello(file_);
+        frame_count_ = countFrames();
+    }
+    return true;
+}
+
+bool FrameStreamReader::seek(int frame)
+{
+    if (format_ == STREAM_SYNTHETIC)
+    {
+        if (frame < 0 || frame > frame_count_)
+            return false;
+        frame_index_ = frame;
+        return true;
+    }
+
+    if (file_ == NULL || !seekable_ || frame < 0 || frame > frame_count_)
+        return false;
+
+    if (format_ == STREAM_BGR)
+        return fseeko(file_, data_offset_ + static_cast<off_t>(frame) * size_.area() * 3, SEEK_SET) == 0;
+
+    // Y4M frame headers may carry parameters, so the offsets are not fixed
+    if (fseeko(file_, data_offset_, SEEK_SET) != 0)
+        return false;
+    for (int f = 0; f < frame; ++f)
+        if (!skipFrame(-1))
+            return false;
+    return true;
+}
+
+bool FrameStreamReader::skipFrame(off_t end)
+{
+    // FRAME[ <params>]\n and the payload; end (if >= 0) is the file size, a
+    // truncated last frame does not count
+    int c = fgetc(file_);
+    while (c != EOF && c != '\n')
+        c = fgetc(file_);
+    if (c == EOF)
+        return false;
+
+    const off_t next = ftello(file_) + static_cast<off_t>(planar_.total());
+    if (end >= 0 && next > end)
+        return false;
+    return fseeko(file_, next, SEEK_SET) == 0;
+}
+
+int FrameStreamReader::countFrames()
+{
+    if (fseeko(file_, 0, SEEK_END) != 0)
+        return 0;
+    const off_t end = ftello(file_);
+
+    int frames = 0;
+    if (format_ == STREAM_BGR)
+        frames = static_cast<int>((end - data_offset_) / (static_cast<off_t>(size_.area()) * 3));
+    else if (fseeko(file_, data_offset_, SEEK_SET) == 0)
+        while (skipFrame(end))
+            frames++;
+
+    fseeko(file_, data_offset_, SEEK_SET);
+    return frames;
+}
+
+void FrameStreamReader::close()
+{
+    if (file_ != NULL && owns_file_)
+        fclose(file_);
+    file_ = NULL;
+    seekable_ = false;
+}
+
+bool FrameStreamReader::readHeader()
+{
+    // YUV4MPEG2 W<width> H<height> F<num>:<den> [I.. A.. C.. X..]\n
+    std::string header;
+    int c;
+    while ((c = fgetc(file_)) != EOF && c != '\n')
+        header.push_back(static_cast<char>(c));
+
+    std::stringstream tokens(header);
+    std::string token;
+    tokens >> token;
+    if (token != "YUV4MPEG2")
+    {
+        std::cerr << "Error: Input stream is not YUV4MPEG2" << std::endl;
+        return false;
+    }
+
+    std::string colorspace = "420";
+    while (tokens >> token)
+    {
+        const std::string value = token.substr(1);
+        switch (token[0])
+        {
+            case 'W':
+                size_.width = atoi(value.c_str());
+                break;
+            case 'H':
+                size_.height = atoi(value.c_str());
+                break;
+            case 'F':
+            {
+                const int num = atoi(value.c_str());
+                const size_t colon = value.find(':');
+                const int den = (colon == std::string::npos) ? 1 : atoi(value.c_str() + colon + 1);
+                fps_ = (den > 0) ? static_cast<double>(num) / den : 0;
+                break;
+            }
+            case 'C':
+                colorspace = value;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // 8-bit 4:2:0 only; 420jpeg, 420mpeg2 and 420paldv only differ in chroma siting
+    // (C420p10, C420p12 and the like have 16-bit samples)
+    if (colorspace != "420" && colorspace != "420jpeg" && colorspace != "420mpeg2" && colorspace != "420paldv")
+    {
+        std::cerr << "Error: Unsupported Y4M colorspace: C" << colorspace << " (only 8-bit 4:2:0 is supported)" << std::endl;
+        return false;
+    }
+    if (size_.width % 2 != 0 || size_.height % 2 != 0)
+    {
+        std::cerr << "Error: Y4M frame size must be even (" << size_.width << "x" << size_.height << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FrameStreamReader::openSynthetic(const std::string& path)
+{
+    // synthetic[:freq[:amplitude[:frames]]]
+    synthetic_freq_ = 1.0;
+    synthetic_amplitude_ = 1.0;
+    frame_count_ = 300;
+    std::stringstream fields(path);
+    std::string field;
+    std::getline(fields, field, ':');
+    if (std::getline(fields, field, ':'))
+        synthetic_freq_ = atof(field.c_str());
+    if (std::getline(fields, field, ':'))
+        synthetic_amplitude_ = atof(field.c_str());
+    if (std::getline(fields, field, ':'))
+        frame_count_ = atoi(field.c_str());
+
+    if (size_.width <= 0 || size_.height <= 0)
+        size_ = cv::Size(640, 480);
+    if (fps_ <= 0 || frame_count_ <= 0)
+    {
+        std::cerr << "Error: Invalid synthetic clip: " << path << " at " << fps_ << " fps" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void FrameStreamReader::renderSynthetic(cv::Mat& frame) const
+{
+    // Smooth texture (so that every pyramid level has content) and a disc with a
+    // 2 pixel soft edge, in double precision and rounded once
+    const double t = frame_index_ / fps_;
+    const double radius = 0.25 * std::min(size_.width, size_.height) +
+                          synthetic_amplitude_ * sin(2 * M_PI * synthetic_freq_ * t);
+    const double cx = 0.5 * size_.width;
+    const double cy = 0.5 * size_.height;
+    const double disc[3] = {70, 110, 200};
+
+    frame.create(size_, CV_8UC3);
+    for (int y = 0; y < size_.height; ++y)
+    {
+        uchar* row = frame.ptr<uchar>(y);
+        for (int x = 0; x < size_.width; ++x, row += 3)
+        {
+            const double texture = 112 + 40 * sin(2 * M_PI * x / 64) * sin(2 * M_PI * y / 48) +
+                                   16 * sin(2 * M_PI * (x + y) / 13);
+            const double d = sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy)) - radius;
+            const double cover = std::min(1.0, std::max(0.0, 0.5 - d / 2));
+            row[0] = static_cast<uchar>(floor(texture * 0.9 + cover * (disc[0] - texture * 0.9) + 0.5));
+            row[1] = static_cast<uchar>(floor(texture + cover * (disc[1] - texture) + 0.5));
+            row[2] = static_cast<uchar>(floor(texture * 1.1 + cover * (disc[2] - texture * 1.1) + 0.5));
+        }
+    }
+}
+
+bool FrameStreamReader::read(cv::Mat& frame)
+{
+    if (format_ == STREAM_SYNTHETIC && frame_index_ < frame_count_)
+    {
+        renderSynthetic(frame);
+        frame_index_++;
+        return true;
+    }
+
+    if (file_ == NULL)
+    {
+        frame.release();
+        return false;
+    }
+
+    if (format_ == STREAM_BGR)
+    {
+        frame.create(size_, CV_8UC3);
+        if (readBytes(frame))
+            return true;
+        frame.release();
+        return false;
+    }
+
+    // FRAME[ <params>]\n
+    std::string header;
+    int c;
+    while ((c = fgetc(file_)) != EOF && c != '\n')
+        header.push_back(static_cast<char>(c));
+    if (header.compare(0, 5, "FRAME") != 0 || !readBytes(planar_))
+    {
+        if (c != EOF || !header.empty())
+            std::cerr << "Warning: Truncated or corrupt Y4M frame, stopping" << std::endl;
+        frame.release();
+        return false;
+    }
+
+    cv::cvtColor(planar_, frame, CV_YUV2BGR_I420);
+    return true;
+}
+
+bool FrameStreamReader::readBytes(cv::Mat& mat)
+{
+    const size_t row_bytes = static_cast<size_t>(mat.cols) * mat.channels();
+    if (mat.isContinuous())
+        return fread(mat.ptr<uchar>(0), 1, row_bytes * mat.rows, file_) == row_bytes * mat.rows;
+
+    for (int y = 0; y < mat.rows; ++y)
+        if (fread(mat.ptr<uchar>(y), 1, row_bytes, file_) != row_bytes)
+            return false;
+    return true;
+}
+
+FrameStreamWriter::FrameStreamWriter()
+        : file_(NULL)
+        , format_(STREAM_Y4M)
+        , size_()
+{
+}
+
+FrameStreamWriter::~FrameStreamWriter()
+{
+    close();
+}
+
+bool FrameStreamWriter::open(const std::string& path, FrameStreamFormat format, const cv::Size& size, double fps)
+{
+    close();
+
+    if (format == STREAM_SYNTHETIC)
+    {
+        std::cerr << "Error: Synthetic clips can only be read: " << path << std::endl;
+        return false;
+    }
+
+    if (format == STREAM_Y4M && (size.width % 2 != 0 || size.height % 2 != 0))
+    {
+        std::cerr << "Error: Y4M frame size must be even (" << size.width << "x" << size.height << ")" << std::endl;
+        return false;
+    }
+
+    if (path == "-")
+    {
+        // Own descriptor, so that close() leaves the reserved one open
+        const int fd = reserveStdout();
+        file_ = (fd >= 0) ? fdopen(dup(fd), "wb") : NULL;
+    }
+    else
+    {
+        file_ = fopen(path.c_str(), "wb");
+    }
+    if (file_ == NULL)
+    {
+        std::cerr << "Error: Unable to open output stream: " << path << std::endl;
+        return false;
+    }
+
+    buffer_.resize(STREAM_BUFFER_SIZE);
+    setvbuf(file_, &buffer_[0], _IOFBF, buffer_.size());
+
+    format_ = format;
+    size_ = size;
+    if (format_ != STREAM_Y4M)
+        return true;
+
+    // Frame rate as a ratio: integer rates, NTSC style x/1.001 rates, otherwise millihertz
+    int num = static_cast<int>(floor(fps * 1000 + 0.5));
+    int den = 1000;
+    if (fabs(fps - floor(fps + 0.5)) < 1e-3)
+    {
+        num = static_cast<int>(floor(fps + 0.5));
+        den = 1;
+    }
+    else if (fabs(fps * 1.001 - floor(fps * 1.001 + 0.5)) < 1e-3)
+    {
+        num = static_cast<int>(floor(fps * 1.001 + 0.5)) * 1000;
+        den = 1001;
+    }
+    fprintf(file_, "YUV4MPEG2 W%d H%d F%d:%d Ip A1:1 C420jpeg\n", size_.width, size_.height, num, den);
+    return true;
+}
+
+void FrameStreamWriter::close()
+{
+    if (file_ != NULL)
+        fclose(file_);
+    file_ = NULL;
+}
+
+int FrameStreamWriter::reserveStdout()
+{
+    // Frames get a private copy of stdout, everything printed to stdout goes to stderr
+    static int fd = -1;
+    if (fd < 0)
+    {
+        std::cout.flush();
+        fflush(stdout);
+        fd = dup(STDOUT_FILENO);
+        if (fd >= 0 && dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+        {
+            ::close(fd);
+            fd = -1;
+        }
+        if (fd < 0)
+            std::cerr << "Error: Unable to redirect stdout" << std::endl;
+    }
+    return fd;
+}
+
+bool FrameStreamWriter::write(const cv::Mat& frame)
+{
+    CV_Assert(frame.type() == CV_8UC3 && frame.size() == size_);
+    if (file_ == NULL)
+        return false;
+
+    if (format_ == STREAM_BGR)
+        return writeBytes(frame);
+
+    cv::cvtColor(frame, planar_, CV_BGR2YUV_I420);
+    fputs("FRAME\n", file_);
+    return writeBytes(planar_);
+}
+
+bool FrameStreamWriter::writeBytes(const cv::Mat& mat)
+{
+    const size_t row_bytes = static_cast<size_t>(mat.cols) * mat.channels();
+    if (mat.isContinuous())
+        return fwrite(mat.ptr<uchar>(0), 1, row_bytes * mat.rows, file_) == row_bytes * mat.rows;
+
+    for (int y = 0; y < mat.rows; ++y)
+        if (fwrite(mat.ptr<uchar>(y), 1, row_bytes, file_) != row_bytes)
+            return false;
+    return true;
+}
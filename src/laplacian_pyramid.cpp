@@ -0,0 +1,554 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "laplacian_pyramid.h"
+
+#include <omp.h>
+#include <stdint.h>
+
+#include <algorithm>
+
+// Rows of the downsampled image handled by one strip (one OpenMP work item)
+#define PYR_STRIP_ROWS 8
+
+namespace
+{
+
+// Channel count of a kernel instantiation: CN > 0 is fixed at compile time, so the
+// per-channel loops unroll and the interior loops vectorize; CN = 0 takes cn
+template <int CN>
+inline int kernelChannels(int cn)
+{
+    return (CN > 0) ? CN : cn;
+}
+
+inline int reflect101(int p, int len)
+{
+    if (len == 1)
+        return 0;
+    while (p < 0 || p >= len)
+        p = (p < 0) ? -p : 2 * (len - 1) - p;
+    return p;
+}
+
+// Vertical 1-4-6-4-1 of the five source rows around 2 * y
+inline void verticalDown(const cv::Mat& src, int y, float* row)
+{
+    const int len = src.cols * src.channels();
+    const float* r0 = src.ptr<float>(reflect101(2 * y - 2, src.rows));
+    const float* r1 = src.ptr<float>(reflect101(2 * y - 1, src.rows));
+    const float* r2 = src.ptr<float>(reflect101(2 * y, src.rows));
+    const float* r3 = src.ptr<float>(reflect101(2 * y + 1, src.rows));
+    const float* r4 = src.ptr<float>(reflect101(2 * y + 2, src.rows));
+    for (int i = 0; i < len; ++i)
+        row[i] = r0[i] + r4[i] + 4.0f * (r1[i] + r3[i]) + 6.0f * r2[i];
+}
+
+// Horizontal 1-4-6-4-1 of one vertically filtered row, at source column sx (border safe)
+template <int CN>
+inline void downPixel(const float* row, int sx, int src_width, int channels, float* dst)
+{
+    const int cn = kernelChannels<CN>(channels);
+    const float scale = 1.0f / 256.0f;
+    const int x0 = reflect101(sx - 2, src_width) * cn;
+    const int x1 = reflect101(sx - 1, src_width) * cn;
+    const int x2 = reflect101(sx, src_width) * cn;
+    const int x3 = reflect101(sx + 1, src_width) * cn;
+    const int x4 = reflect101(sx + 2, src_width) * cn;
+    for (int c = 0; c < cn; ++c)
+        dst[c] = (row[x0 + c] + row[x4 + c] + 4.0f * (row[x1 + c] + row[x3 + c]) + 6.0f * row[x2 + c]) * scale;
+}
+
+// Horizontal 1-4-6-4-1 and decimation of one vertically filtered row
+template <int CN>
+inline void horizontalDown(const float* row, int src_width, int channels, float* dst, int dst_width)
+{
+    const int cn = kernelChannels<CN>(channels);
+    const float scale = 1.0f / 256.0f;
+
+    // Interior columns have all five taps inside the row
+    const int x_begin = std::min(1, dst_width);
+    const int x_end = std::max(x_begin, std::min(dst_width, (src_width - 3) / 2 + 1));
+
+    int x = 0;
+    for (; x < x_begin; ++x)
+        downPixel<CN>(row, 2 * x, src_width, cn, dst + x * cn);
+    for (; x < x_end; ++x)
+    {
+        const float* p = row + (2 * x - 2) * cn;
+        float* d = dst + x * cn;
+        for (int c = 0; c < cn; ++c)
+            d[c] = (p[c] + p[4 * cn + c] + 4.0f * (p[cn + c] + p[3 * cn + c]) + 6.0f * p[2 * cn + c]) * scale;
+    }
+    for (; x < dst_width; ++x)
+        downPixel<CN>(row, 2 * x, src_width, cn, dst + x * cn);
+}
+
+// Length of the zero-stuffed image pyrUp filters: twice the coarse length. OpenCV
+// reflects at that length and crops an odd destination afterwards, so the last
+// column of an odd width is 8 * s[n - 1], not a reflection at the odd width.
+inline int upLength(int length)
+{
+    return 2 * ((length + 1) / 2);
+}
+
+// Vertical pass of pyrUp for output row y: only the even (non-zero) rows of the
+// zero-stuffed image contribute, and reflect-101 keeps the parity of an index.
+template <typename RowFn>
+inline void verticalUp(int y, int height, int len, RowFn coarse_row, float* row)
+{
+    const int up_height = upLength(height);
+    if ((y & 1) == 0)
+    {
+        const float* r0 = coarse_row(reflect101(y - 2, up_height) / 2);
+        const float* r1 = coarse_row(y / 2);
+        const float* r2 = coarse_row(reflect101(y + 2, up_height) / 2);
+        for (int i = 0; i < len; ++i)
+            row[i] = r0[i] + r2[i] + 6.0f * r1[i];
+    }
+    else
+    {
+        const float* r0 = coarse_row(reflect101(y - 1, up_height) / 2);
+        const float* r1 = coarse_row(reflect101(y + 1, up_height) / 2);
+        for (int i = 0; i < len; ++i)
+            row[i] = 4.0f * (r0[i] + r1[i]);
+    }
+}
+
+// Horizontal pass of pyrUp at output column x (border safe)
+template <int CN>
+inline float upPixel(const float* row, int x, int width, int channels, int c)
+{
+    const int cn = kernelChannels<CN>(channels);
+    const int up_width = upLength(width);
+    if ((x & 1) == 0)
+    {
+        return row[(reflect101(x - 2, up_width) / 2) * cn + c] + row[(reflect101(x + 2, up_width) / 2) * cn + c] +
+               6.0f * row[(x / 2) * cn + c];
+    }
+    return 4.0f * (row[(reflect101(x - 1, up_width) / 2) * cn + c] + row[(reflect101(x + 1, up_width) / 2) * cn + c]);
+}
+
+// How horizontalUp combines the upsampled row with the residual row
+enum UpOp
+{
+    UP_SUBTRACT,  // out = in - up
+    UP_ADD,       // out = in + up
+    UP_ONLY       // out = up (in is unused)
+};
+
+// Residual elements as float, and back: CV_16S levels are Q8.7 (PYR_FIXED_POINT_SHIFT)
+inline float loadLevel(const float* p, int i)
+{
+    return p[i];
+}
+
+inline float loadLevel(const int16_t* p, int i)
+{
+    return p[i] * (1.0f / PYR_FIXED_POINT_SCALE);
+}
+
+inline void storeLevel(float* p, int i, float v)
+{
+    p[i] = v;
+}
+
+inline void storeLevel(int16_t* p, int i, float v)
+{
+    p[i] = cv::saturate_cast<int16_t>(v * PYR_FIXED_POINT_SCALE);
+}
+
+// Level value to stored value (convertTo scale) for a level depth
+inline double getStoredScale(int depth)
+{
+    return (depth == CV_16S) ? PYR_FIXED_POINT_SCALE : 1.0;
+}
+
+template <int kOp, typename TI>
+inline float combineUp(const TI* in, int i, float up)
+{
+    return (kOp == UP_ADD) ? loadLevel(in, i) + up : (kOp == UP_SUBTRACT) ? loadLevel(in, i) - up : up;
+}
+
+// Horizontal pass of pyrUp fused with the residual (see UpOp). The residual (in
+// for UP_ADD, out for UP_SUBTRACT) may be float or int16_t fixed-point.
+template <int kOp, int CN, typename TI, typename TO>
+inline void horizontalUp(const float* row, int channels, const TI* in, TO* out, int width)
+{
+    const int cn = kernelChannels<CN>(channels);
+    const float scale = 1.0f / 64.0f;
+
+    // Interior pairs (2i, 2i + 1) read coarse columns i - 1, i and i + 1 only
+    const int i_end = (width >= 3) ? (width - 3) / 2 + 1 : 1;
+
+    for (int x = 0; x < std::min(2, width); ++x)
+        for (int c = 0; c < cn; ++c)
+        {
+            float up = upPixel<CN>(row, x, width, cn, c) * scale;
+            storeLevel(out, x * cn + c, combineUp<kOp>(in, x * cn + c, up));
+        }
+
+    for (int i = 1; i < i_end; ++i)
+    {
+        const float* p = row + (i - 1) * cn;
+        const int even = 2 * i * cn;
+        const int odd = even + cn;
+        for (int c = 0; c < cn; ++c)
+        {
+            float up_even = (p[c] + p[2 * cn + c] + 6.0f * p[cn + c]) * scale;
+            float up_odd = 4.0f * (p[cn + c] + p[2 * cn + c]) * scale;
+            storeLevel(out, even + c, combineUp<kOp>(in, even + c, up_even));
+            storeLevel(out, odd + c, combineUp<kOp>(in, odd + c, up_odd));
+        }
+    }
+
+    for (int x = std::max(2, 2 * i_end); x < width; ++x)
+        for (int c = 0; c < cn; ++c)
+        {
+            float up = upPixel<CN>(row, x, width, cn, c) * scale;
+            storeLevel(out, x * cn + c, combineUp<kOp>(in, x * cn + c, up));
+        }
+}
+
+}  // namespace
+
+LaplacianPyramidEngine::LaplacianPyramidEngine()
+        : scratch_()
+        , coarse_()
+        , scratch_stride_(0)
+        , max_width_(0)
+        , channels_(0)
+{
+}
+
+void LaplacianPyramidEngine::init(int max_width, int channels)
+{
+    const int threads = std::max(omp_get_max_threads(), 1);
+    max_width_ = std::max(max_width, max_width_);
+    channels_ = std::max(channels, channels_);
+
+    // Per thread: one full-width row and three half-width rows (two halos and the
+    // vertically upsampled row), padded to a cache line
+    const size_t half = static_cast<size_t>((max_width_ + 1) / 2) * channels_;
+    scratch_stride_ = (static_cast<size_t>(max_width_) * channels_ + 3 * half + 15) & ~static_cast<size_t>(15);
+    if (scratch_.size() < scratch_stride_ * threads)
+        scratch_.resize(scratch_stride_ * threads);
+}
+
+float* LaplacianPyramidEngine::getScratch(int thread_num)
+{
+    return &scratch_[scratch_stride_ * thread_num];
+}
+
+// The public entry points check and allocate, then run the kernels specialized
+// for the channel count: 3 (Lab / YIQ frames), 1, or any other at runtime
+#define PYR_DISPATCH_CHANNELS(cn, kernel, args) \
+    do                                          \
+    {                                           \
+        if ((cn) == 3)                          \
+            kernel<3> args;                     \
+        else if ((cn) == 1)                     \
+            kernel<1> args;                     \
+        else                                    \
+            kernel<0> args;                     \
+    } while (0)
+
+// The row kernels are worksharing loops: the single level entry points open a
+// parallel region for one kernel, the whole-pyramid ones for all levels
+
+void LaplacianPyramidEngine::buildLevel(const cv::Mat& src, cv::Mat& down, cv::Mat& lap)
+{
+    CV_Assert(src.depth() == CV_32F && src.rows > 0 && src.cols > 0);
+    const int cn = src.channels();
+    if (src.cols > max_width_ || cn > channels_ || scratch_.size() < scratch_stride_ * omp_get_max_threads())
+        init(src.cols, cn);
+
+    down.create(cv::Size((src.cols + 1) / 2, (src.rows + 1) / 2), src.type());
+    lap.create(src.size(), src.type());
+    #pragma omp parallel
+    PYR_DISPATCH_CHANNELS(cn, buildLevelRows, (src, down, lap));
+}
+
+template <int CN>
+void LaplacianPyramidEngine::buildLevelRows(const cv::Mat& src, cv::Mat& down, cv::Mat& lap)
+{
+    const int cn = kernelChannels<CN>(src.channels());
+
+    const size_t half = static_cast<size_t>((max_width_ + 1) / 2) * channels_;
+    const int num_strips = (down.rows + PYR_STRIP_ROWS - 1) / PYR_STRIP_ROWS;
+
+    #pragma omp for schedule(static)
+    for (int s = 0; s < num_strips; ++s)
+    {
+        float* vert_row = getScratch(omp_get_thread_num());
+        float* halo_top = vert_row + static_cast<size_t>(max_width_) * channels_;
+        float* halo_bottom = halo_top + half;
+        float* up_row = halo_bottom + half;
+
+        const int y0 = s * PYR_STRIP_ROWS;
+        const int y1 = std::min(y0 + PYR_STRIP_ROWS, down.rows);
+
+        // 1. Downsampled rows owned by this strip, and the neighbouring rows
+        //    (owned by other strips) recomputed locally
+        for (int y = y0; y < y1; ++y)
+        {
+            verticalDown(src, y, vert_row);
+            horizontalDown<CN>(vert_row, src.cols, cn, down.ptr<float>(y), down.cols);
+        }
+        if (y0 > 0)
+        {
+            verticalDown(src, y0 - 1, vert_row);
+            horizontalDown<CN>(vert_row, src.cols, cn, halo_top, down.cols);
+        }
+        if (y1 < down.rows)
+        {
+            verticalDown(src, y1, vert_row);
+            horizontalDown<CN>(vert_row, src.cols, cn, halo_bottom, down.cols);
+        }
+
+        // 2. Residual rows, upsampling on the fly
+        const cv::Mat& coarse = down;
+        struct CoarseRow
+        {
+            const cv::Mat& img;
+            int y0, y1;
+            const float* top;
+            const float* bottom;
+            const float* operator()(int r) const
+            {
+                return (r < y0) ? top : (r >= y1) ? bottom : img.ptr<float>(r);
+            }
+        } coarse_row = {coarse, y0, y1, halo_top, halo_bottom};
+
+        const int len = down.cols * cn;
+        const int lap_end = std::min(2 * y1, lap.rows);
+        for (int y = 2 * y0; y < lap_end; ++y)
+        {
+            verticalUp(y, lap.rows, len, coarse_row, up_row);
+            if (lap.depth() == CV_16S)
+                horizontalUp<UP_SUBTRACT, CN>(up_row, cn, src.ptr<float>(y), lap.ptr<int16_t>(y), lap.cols);
+            else
+                horizontalUp<UP_SUBTRACT, CN>(up_row, cn, src.ptr<float>(y), lap.ptr<float>(y), lap.cols);
+        }
+    }
+}
+
+void LaplacianPyramidEngine::collapseLevel(const cv::Mat& src, const cv::Mat& lap, cv::Mat& dst)
+{
+    CV_Assert(src.depth() == CV_32F && src.type() == lap.type());
+    CV_Assert(src.cols == (lap.cols + 1) / 2 && src.rows == (lap.rows + 1) / 2);
+    const int cn = src.channels();
+    if (lap.cols > max_width_ || cn > channels_ || scratch_.size() < scratch_stride_ * omp_get_max_threads())
+        init(lap.cols, cn);
+
+    dst.create(lap.size(), lap.type());
+    #pragma omp parallel
+    PYR_DISPATCH_CHANNELS(cn, collapseLevelRows, (src, lap, dst));
+}
+
+template <int CN>
+void LaplacianPyramidEngine::collapseLevelRows(const cv::Mat& src, const cv::Mat& lap, cv::Mat& dst)
+{
+    const int cn = kernelChannels<CN>(src.channels());
+    struct CoarseRow
+    {
+        const cv::Mat& img;
+        const float* operator()(int r) const { return img.ptr<float>(r); }
+    } coarse_row = {src};
+
+    const int len = src.cols * cn;
+
+    #pragma omp for schedule(static)
+    for (int y = 0; y < lap.rows; ++y)
+    {
+        float* up_row = getScratch(omp_get_thread_num());
+        verticalUp(y, lap.rows, len, coarse_row, up_row);
+        if (lap.depth() == CV_16S)
+            horizontalUp<UP_ADD, CN>(up_row, cn, lap.ptr<int16_t>(y), dst.ptr<float>(y), lap.cols);
+        else
+            horizontalUp<UP_ADD, CN>(up_row, cn, lap.ptr<float>(y), dst.ptr<float>(y), lap.cols);
+    }
+}
+
+void LaplacianPyramidEngine::downLevel(const cv::Mat& src, cv::Mat& down)
+{
+    CV_Assert(src.depth() == CV_32F && src.rows > 0 && src.cols > 0);
+    const int cn = src.channels();
+    if (src.cols > max_width_ || cn > channels_ || scratch_.size() < scratch_stride_ * omp_get_max_threads())
+        init(src.cols, cn);
+
+    down.create(cv::Size((src.cols + 1) / 2, (src.rows + 1) / 2), src.type());
+    #pragma omp parallel
+    PYR_DISPATCH_CHANNELS(cn, downLevelRows, (src, down));
+}
+
+template <int CN>
+void LaplacianPyramidEngine::downLevelRows(const cv::Mat& src, cv::Mat& down)
+{
+    const int cn = kernelChannels<CN>(src.channels());
+
+    #pragma omp for schedule(static)
+    for (int y = 0; y < down.rows; ++y)
+    {
+        float* vert_row = getScratch(omp_get_thread_num());
+        verticalDown(src, y, vert_row);
+        horizontalDown<CN>(vert_row, src.cols, cn, down.ptr<float>(y), down.cols);
+    }
+}
+
+void LaplacianPyramidEngine::upLevel(const cv::Mat& src, const cv::Size& size, cv::Mat& dst)
+{
+    CV_Assert(src.depth() == CV_32F);
+    CV_Assert(src.cols == (size.width + 1) / 2 && src.rows == (size.height + 1) / 2);
+    const int cn = src.channels();
+    if (size.width > max_width_ || cn > channels_ || scratch_.size() < scratch_stride_ * omp_get_max_threads())
+        init(size.width, cn);
+
+    dst.create(size, src.type());
+    #pragma omp parallel
+    PYR_DISPATCH_CHANNELS(cn, upLevelRows, (src, dst));
+}
+
+template <int CN>
+void LaplacianPyramidEngine::upLevelRows(const cv::Mat& src, cv::Mat& dst)
+{
+    const int cn = kernelChannels<CN>(src.channels());
+    struct CoarseRow
+    {
+        const cv::Mat& img;
+        const float* operator()(int r) const { return img.ptr<float>(r); }
+    } coarse_row = {src};
+
+    const int len = src.cols * cn;
+
+    #pragma omp for schedule(static)
+    for (int y = 0; y < dst.rows; ++y)
+    {
+        float* up_row = getScratch(omp_get_thread_num());
+        verticalUp(y, dst.rows, len, coarse_row, up_row);
+        horizontalUp<UP_ONLY, CN>(up_row, cn, static_cast<const float*>(NULL), dst.ptr<float>(y), dst.cols);
+    }
+}
+
+void LaplacianPyramidEngine::buildPyramid(const cv::Mat& src, int levels, const std::vector<bool>* bands,
+                                          std::vector<cv::Mat>& down, std::vector<cv::Mat>& pyramid, int depth)
+{
+    CV_Assert(src.depth() == CV_32F && src.rows > 0 && src.cols > 0 && levels > 0);
+    CV_Assert(depth == CV_32F || depth == CV_16S);
+    CV_Assert(bands == NULL || static_cast<int>(bands->size()) > levels);
+    const int cn = src.channels();
+    if (src.cols > max_width_ || cn > channels_ || scratch_.size() < scratch_stride_ * omp_get_max_threads())
+        init(src.cols, cn);
+
+    // Bands outside the mask are not computed, nothing below the coarsest wanted one
+    int top = levels;
+    if (bands != NULL)
+        while (top >= 0 && !(*bands)[top])
+            top--;
+
+    // Allocate every level up front, the parallel region only runs the kernels
+    down.resize(levels);
+    pyramid.resize(levels + 1);
+    cv::Size size = src.size();
+    for (int l = 0; l < std::min(top + 1, levels); ++l)
+    {
+        if (bands == NULL || (*bands)[l])
+            pyramid[l].create(size, CV_MAKETYPE(depth, cn));
+        size = cv::Size((size.width + 1) / 2, (size.height + 1) / 2);
+        down[l].create(size, src.type());
+    }
+
+    PYR_DISPATCH_CHANNELS(cn, buildPyramidImpl, (src, levels, top, bands, down, pyramid));
+
+    if (top == levels)
+        down[levels - 1].convertTo(pyramid[levels], CV_MAKETYPE(depth, cn), getStoredScale(depth));
+}
+
+template <int CN>
+void LaplacianPyramidEngine::buildPyramidImpl(const cv::Mat& src, int levels, int top,
+                                              const std::vector<bool>* bands, std::vector<cv::Mat>& down,
+                                              std::vector<cv::Mat>& pyramid)
+{
+    #pragma omp parallel
+    {
+        const cv::Mat* current = &src;
+        for (int l = 0; l < std::min(top + 1, levels); ++l)
+        {
+            if (bands == NULL || (*bands)[l])
+                buildLevelRows<CN>(*current, down[l], pyramid[l]);
+            else
+                downLevelRows<CN>(*current, down[l]);
+            current = &down[l];
+        }
+    }
+}
+
+void LaplacianPyramidEngine::collapsePyramid(const std::vector<cv::Mat>& pyramid, const std::vector<cv::Size>& sizes,
+                                             int top, int bottom, const std::vector<bool>* bands,
+                                             std::vector<cv::Mat>& up, cv::Mat& dst)
+{
+    CV_Assert(bottom >= 0 && top >= bottom && static_cast<int>(sizes.size()) > top);
+    const int depth = pyramid[top].depth();
+    const int cn = pyramid[top].channels();
+    CV_Assert(depth == CV_32F || depth == CV_16S);
+    if (top == bottom)
+    {
+        pyramid[top].convertTo(dst, CV_MAKETYPE(CV_32F, cn), 1.0 / getStoredScale(depth));
+        return;
+    }
+
+    // The upsampling runs in float: a fixed-point top level is converted first
+    CV_Assert(pyramid[top].size() == sizes[top]);
+    const cv::Mat* coarse = &pyramid[top];
+    if (depth == CV_16S)
+    {
+        pyramid[top].convertTo(coarse_, CV_MAKETYPE(CV_32F, cn), 1.0 / PYR_FIXED_POINT_SCALE);
+        coarse = &coarse_;
+    }
+
+    const int width = sizes[bottom].width;
+    if (width > max_width_ || cn > channels_ || scratch_.size() < scratch_stride_ * omp_get_max_threads())
+        init(width, cn);
+
+    // Allocate every level up front, the parallel region only runs the kernels
+    up.resize(std::max<size_t>(up.size(), top));
+    for (int l = top - 1; l >= bottom; --l)
+    {
+        CV_Assert(sizes[l + 1].width == (sizes[l].width + 1) / 2 && sizes[l + 1].height == (sizes[l].height + 1) / 2);
+        if (bands == NULL || (*bands)[l])
+            CV_Assert(pyramid[l].type() == pyramid[top].type() && pyramid[l].size() == sizes[l]);
+        ((l > bottom) ? up[l] : dst).create(sizes[l], CV_MAKETYPE(CV_32F, cn));
+    }
+
+    PYR_DISPATCH_CHANNELS(cn, collapsePyramidImpl, (*coarse, pyramid, top, bottom, bands, up, dst));
+}
+
+template <int CN>
+void LaplacianPyramidEngine::collapsePyramidImpl(const cv::Mat& coarse, const std::vector<cv::Mat>& pyramid, int top,
+                                                 int bottom, const std::vector<bool>* bands,
+                                                 std::vector<cv::Mat>& up, cv::Mat& dst)
+{
+    #pragma omp parallel
+    {
+        const cv::Mat* current = &coarse;
+        for (int l = top - 1; l >= bottom; --l)
+        {
+            cv::Mat& level_dst = (l > bottom) ? up[l] : dst;
+            if (bands == NULL || (*bands)[l])
+                collapseLevelRows<CN>(*current, pyramid[l], level_dst);
+            else
+                upLevelRows<CN>(*current, level_dst);
+            current = &level_dst;
+        }
+    }
+}
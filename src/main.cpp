@@ -11,101 +11,153 @@
 //
 //*****************************************************************************
 
+#include <stdlib.h>
+
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <thread>  // NOLINT [build/c++11]
+#include <vector>
 
-#include <boost/program_options.hpp>
-
-#include "eulerian_motion_mag.h"
+#include "batch_scheduler.h"
+#include "param_file.h"
+#include "run_modes.h"
 
-namespace po = boost::program_options;
+namespace
+{
 
-int main(int argc, char **argv)
+// One param file path per line, empty lines and lines starting with # are skipped
+bool readManifest(const std::string& manifest, std::vector<std::string>& param_files)
 {
-    std::string input_filename;
-    std::string output_filename;
-    int input_width;
-    int input_height;
-    int output_width;
-    int output_height;
-    double alpha;
-    double lambda_c;
-    double cutoff_freq_low;
-    double cutoff_freq_high;
-    double chrom_attenuation;
-    double exaggeration_factor;
-    double delta;
-    double lambda;
-    int levels;
-
-    if (argc <= 1)
+    std::ifstream file(manifest.c_str());
+    if (!file.is_open())
     {
-        std::cerr << "Error: Input param filename must be specified!" << std::endl;
-        return 1;
+        std::cerr << "Error: Unable to open batch manifest: " << manifest << std::endl;
+        return false;
     }
 
-    // Read input param file
-    std::ifstream file(argv[1]);
-    if (!file.is_open())
+    std::string line;
+    while (std::getline(file, line))
     {
-        std::cerr << "Error: Unable to open param file: " << std::string(argv[1]) << std::endl;
-        return 1;
+        const size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#')
+            continue;
+        const size_t end = line.find_last_not_of(" \t\r");
+        param_files.push_back(line.substr(begin, end - begin + 1));
     }
+    return true;
+}
 
-    // Parse param file for getting parameter values
-    po::options_description desc("Eulerian-Motion-Magnification");
-    desc.add_options()
-        ("help,h", "produce help message")
-        ("input_filename", po::value<std::string>(&input_filename)->default_value( "" ))  // NOLINT [whitespace/parens]
-        ("output_filename", po::value<std::string>(&output_filename)->default_value( "" ))  // NOLINT [whitespace/parens]
-        ("input_width", po::value<int>(&input_width)->default_value( 0 ))  // NOLINT [whitespace/parens]
-        ("input_height", po::value<int>(&input_height)->default_value( 0 ))  // NOLINT [whitespace/parens]
-        ("output_width", po::value<int>(&output_width)->default_value( 0 ))  // NOLINT [whitespace/parens]
-        ("output_height", po::value<int>(&output_height)->default_value( 0 ))  // NOLINT [whitespace/parens]
-        ("alpha", po::value<double>(&alpha)->default_value( 20 ))  // NOLINT [whitespace/parens]
-        ("lambda_c", po::value<double>(&lambda_c)->default_value( 16 ))  // NOLINT [whitespace/parens]
-        ("cutoff_freq_low", po::value<double>(&cutoff_freq_low)->default_value( 0.05 ))  // NOLINT [whitespace/parens]
-        ("cutoff_freq_high", po::value<double>(&cutoff_freq_high)->default_value( 0.4 ))  // NOLINT [whitespace/parens]
-        ("chrom_attenuation", po::value<double>(&chrom_attenuation)->default_value( 0.1 ))  // NOLINT [whitespace/parens]
-        ("exaggeration_factor", po::value<double>(&exaggeration_factor)->default_value( 2.0 ))  // NOLINT [whitespace/parens]
-        ("delta", po::value<double>(&delta)->default_value( 0 ))  // NOLINT [whitespace/parens]
-        ("lambda", po::value<double>(&lambda)->default_value( 0 ))  // NOLINT [whitespace/parens]
-        ("levels", po::value<int>(&levels)->default_value( 5 ))  // NOLINT [whitespace/parens]
-    ;  // NOLINT [whitespace/semicolon]
-    po::variables_map vm;
-    po::store(po::parse_config_file(file, desc), vm);
-    po::notify(vm);
-
-    // EulerianMotionMag
-    EulerianMotionMag* motion_mag = new EulerianMotionMag();
-
+int runSingle(const std::string& param_file)
+{
     // Set params
-    motion_mag->setInputFileName(input_filename);
-    motion_mag->setOutputFileName(output_filename);
-    motion_mag->setInputImgWidth(input_width);
-    motion_mag->setInputImgHeight(input_height);
-    motion_mag->setOutputImgWidth(output_width);
-    motion_mag->setOutputImgHeight(output_height);
-    motion_mag->setAlpha(alpha);
-    motion_mag->setLambdaC(lambda_c);
-    motion_mag->setCutoffFreqLow(cutoff_freq_low);
-    motion_mag->setCutoffFreqHigh(cutoff_freq_high);
-    motion_mag->setChromAttenuation(chrom_attenuation);
-    motion_mag->setExaggerationFactor(exaggeration_factor);
-    motion_mag->setDelta(delta);
-    motion_mag->setLambda(lambda);
-    motion_mag->setLapPyramidLevels(levels);
-
-    // Init Motion Magnification object
-    bool init_status = motion_mag->init();
-    if (!init_status)
+    MotionMagConfig config;
+    RunOptions options;
+    if (!loadParamFile(param_file, config, options))
         return 1;
 
-    // Run Motion Magnification
-    motion_mag->run();
+    // Runner for the selected mode
+    Runner* runner = createRunner(config, options);
+    if (runner == NULL)
+        return 1;
+
+    // Init and run Motion Magnification
+    bool passed = false;
+    if (runner->init())
+    {
+        runner->run();
+        passed = runner->isPassed();
+    }
 
     // Exit
-    delete motion_mag;
+    delete runner;
+    return passed ? 0 : 1;
+}
+
+int runBatch(const std::vector<std::string>& param_files, int num_workers)
+{
+    const int num_threads = std::max(1U, std::thread::hardware_concurrency());
+    if (num_workers <= 0)
+        num_workers = std::max(1, num_threads / 2);
+
+    // The OpenMP count is per job. OpenCV's pool is process wide, so it follows
+    // the per-job share, which is the same for every running job.
+    BatchScheduler scheduler(num_workers, num_threads);
+    scheduler.setRebalanceCallback([](int threads) { cv::setNumThreads(threads); });
+    for (size_t i = 0; i < param_files.size(); ++i)
+    {
+        // Validate every param file up front, and use the input size as the cost
+        MotionMagConfig probe_config;
+        RunOptions probe_options;
+        if (!loadParamFile(param_files[i], probe_config, probe_options))
+            return 1;
+        std::ifstream input(probe_options.input_file.c_str(), std::ios::binary | std::ios::ate);
+
+        BatchJob job;
+        job.name = param_files[i];
+        job.cost = input.is_open() ? static_cast<double>(input.tellg()) : 0;
+        job.run = [param_files, i](const std::atomic<int>& threads) -> int
+        {
+            MotionMagConfig config;
+            RunOptions options;
+            if (!loadParamFile(param_files[i], config, options))
+                return -1;
+
+            // No windows from worker threads, thread count follows the scheduler
+            options.headless = true;
+            config.shared_num_threads = &threads;
+            cv::Ptr<Runner> runner(createRunner(config, options));
+            if (runner.empty() || !runner->init())
+                return -1;
+            runner->run();
+            return runner->isPassed() ? runner->getFrameNum() : -1;
+        };  // NOLINT [whitespace/braces]
+        scheduler.add(job);
+    }
+
+    std::cout << "Batch: " << param_files.size() << " jobs, " << std::min<size_t>(num_workers, param_files.size())
+              << " at a time on " << num_threads << " threads" << std::endl;
+    scheduler.run();
+    scheduler.printReport(std::cout);
+
+    for (size_t i = 0; i < scheduler.getResults().size(); ++i)
+        if (!scheduler.getResults()[i].ok)
+            return 1;
     return 0;
 }
 
+}  // namespace
+
+int main(int argc, char **argv)
+{
+    // <param_file>                      : process one clip
+    // <param_file> <param_file> ...     : batch
+    // --batch <manifest> [--jobs <n>]   : batch, n clips at a time
+    std::vector<std::string> param_files;
+    std::string manifest;
+    int num_workers = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg(argv[i]);
+        if (arg == "--batch" && i + 1 < argc)
+            manifest = argv[++i];
+        else if (arg == "--jobs" && i + 1 < argc)
+            num_workers = atoi(argv[++i]);
+        else
+            param_files.push_back(arg);
+    }
+
+    if (!manifest.empty() && !readManifest(manifest, param_files))
+        return 1;
+
+    if (param_files.empty())
+    {
+        std::cerr << "Error: Input param filename must be specified!" << std::endl;
+        return 1;
+    }
+
+    if (param_files.size() == 1 && manifest.empty())
+        return runSingle(param_files[0]);
+    return runBatch(param_files, num_workers);
+}
@@ -0,0 +1,292 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "motion_kernels.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define MAX_KERNEL_CHANNELS 4
+
+// Rounding thresholds of the fixed-point state: the R1 low-discrepancy sequence
+// over the element index, shifted by the golden ratio per frame. An element sees
+// evenly spread thresholds over consecutive frames, so a slow lowpass keeps moving
+// by its mean update instead of sticking in the rounding dead band, and the result
+// only depends on the frame number (no random state).
+#define DITHER_FRAME_STEP 0.6180339887498949
+#define DITHER_INDEX_STEP 0.7548776662466927
+
+void fusedTemporalAmplify(const cv::Mat& src, cv::Mat& lowpass_1, cv::Mat& lowpass_2, cv::Mat& dst,
+                          float cutoff_high, float cutoff_low, float gain, const float* channel_scale)
+{
+    CV_Assert(src.depth() == CV_32F && src.channels() <= MAX_KERNEL_CHANNELS);
+    CV_Assert(lowpass_1.size() == src.size() && lowpass_1.type() == src.type());
+    CV_Assert(lowpass_2.size() == src.size() && lowpass_2.type() == src.type());
+    dst.create(src.size(), src.type());
+
+    const int cn = src.channels();
+    const float keep_high = 1.0f - cutoff_high;
+    const float keep_low = 1.0f - cutoff_low;
+
+    // Per element scale pattern. A run of 4 * cn floats always starts on channel 0,
+    // so it can be covered by cn vectors of 4 lanes each.
+    float scale[4 * MAX_KERNEL_CHANNELS];
+    for (int i = 0; i < 4 * cn; ++i)
+        scale[i] = gain * channel_scale[i % cn];
+
+    const int row_len = src.cols * cn;
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+    {
+        const float* s = src.ptr<float>(y);
+        float* lp1 = lowpass_1.ptr<float>(y);
+        float* lp2 = lowpass_2.ptr<float>(y);
+        float* d = dst.ptr<float>(y);
+        int x = 0;
+
+#if defined(__SSE__)
+        const __m128 v_keep_high = _mm_set1_ps(keep_high);
+        const __m128 v_cut_high = _mm_set1_ps(cutoff_high);
+        const __m128 v_keep_low = _mm_set1_ps(keep_low);
+        const __m128 v_cut_low = _mm_set1_ps(cutoff_low);
+        const int block = 4 * cn;
+        for (; x <= row_len - block; x += block)
+        {
+            for (int v = 0; v < cn; ++v)
+            {
+                const int i = x + 4 * v;
+                __m128 v_src = _mm_loadu_ps(s + i);
+                __m128 v_lp1 = _mm_add_ps(_mm_mul_ps(v_keep_high, _mm_loadu_ps(lp1 + i)), _mm_mul_ps(v_cut_high, v_src));
+                __m128 v_lp2 = _mm_add_ps(_mm_mul_ps(v_keep_low, _mm_loadu_ps(lp2 + i)), _mm_mul_ps(v_cut_low, v_src));
+                _mm_storeu_ps(lp1 + i, v_lp1);
+                _mm_storeu_ps(lp2 + i, v_lp2);
+                _mm_storeu_ps(d + i, _mm_mul_ps(_mm_sub_ps(v_lp1, v_lp2), _mm_loadu_ps(scale + 4 * v)));
+            }
+        }
+#endif
+
+        // Scalar tail (and fallback for targets without SSE)
+        for (; x < row_len; ++x)
+        {
+            lp1[x] = keep_high * lp1[x] + cutoff_high * s[x];
+            lp2[x] = keep_low * lp2[x] + cutoff_low * s[x];
+            d[x] = (lp1[x] - lp2[x]) * scale[x % cn];
+        }
+    }
+}
+
+namespace
+{
+
+// Threshold of element index in frame, in [0, 1)
+inline float getDither(int frame, double index)
+{
+    const double u = 0.5 + frame * DITHER_FRAME_STEP + index * DITHER_INDEX_STEP;
+    return static_cast<float>(u - floor(u));
+}
+
+// floor(v + u), saturated to int16
+inline int16_t roundDither(float v, float u)
+{
+    const float shifted = std::max(0.0f, std::min(65535.0f, v + u + 32768.0f));
+    return static_cast<int16_t>(static_cast<int>(shifted) - 32768);
+}
+
+#if defined(__SSE2__)
+inline __m128i roundDither(__m128 v, __m128 u)
+{
+    const __m128 offset = _mm_set1_ps(32768.0f);
+    // Truncation of a positive value is floor(); clamp so that the int32 conversion cannot overflow
+    __m128 shifted = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_add_ps(v, u), offset), _mm_setzero_ps()), _mm_set1_ps(65535.0f));
+    return _mm_sub_epi32(_mm_cvttps_epi32(shifted), _mm_set1_epi32(32768));
+}
+
+// Thresholds of the next 4 elements: u + 4 * DITHER_INDEX_STEP, wrapped to [0, 1)
+inline __m128 nextDither(__m128 u, __m128 step)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    u = _mm_add_ps(u, step);
+    return _mm_sub_ps(u, _mm_and_ps(_mm_cmpge_ps(u, one), one));
+}
+
+inline void loadFixed(const int16_t* p, __m128 scale, __m128& lo, __m128& hi)
+{
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16)), scale);
+    hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16)), scale);
+}
+#endif
+
+// Band elements (src and dst) as float and back, one or 8 at a time: float, or
+// int16_t in the fixed-point format of the state, written rounded to nearest
+inline float loadBand(const float* p, int i, float)
+{
+    return p[i];
+}
+
+inline float loadBand(const int16_t* p, int i, float to_float)
+{
+    return p[i] * to_float;
+}
+
+inline void storeBand(float* p, int i, float v, float)
+{
+    p[i] = v;
+}
+
+inline void storeBand(int16_t* p, int i, float v, float to_fixed)
+{
+    p[i] = cv::saturate_cast<int16_t>(v * to_fixed);
+}
+
+#if defined(__SSE2__)
+inline void loadBand(const float* p, __m128, __m128& lo, __m128& hi)
+{
+    lo = _mm_loadu_ps(p);
+    hi = _mm_loadu_ps(p + 4);
+}
+
+inline void loadBand(const int16_t* p, __m128 to_float, __m128& lo, __m128& hi)
+{
+    loadFixed(p, to_float, lo, hi);
+}
+
+inline void storeBand(float* p, __m128 lo, __m128 hi, __m128)
+{
+    _mm_storeu_ps(p, lo);
+    _mm_storeu_ps(p + 4, hi);
+}
+
+inline void storeBand(int16_t* p, __m128 lo, __m128 hi, __m128 to_fixed)
+{
+    // Round to nearest (even), like saturate_cast; the pack saturates
+    const __m128i fixed_lo = _mm_cvtps_epi32(_mm_mul_ps(lo, to_fixed));
+    const __m128i fixed_hi = _mm_cvtps_epi32(_mm_mul_ps(hi, to_fixed));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_packs_epi32(fixed_lo, fixed_hi));
+}
+#endif
+
+// Rows of fusedTemporalAmplifyFixed() for a band of element type T
+template <typename T>
+void fusedTemporalAmplifyFixedRows(const cv::Mat& src, cv::Mat& lowpass_1, cv::Mat& lowpass_2, cv::Mat& dst,
+                                   float cutoff_high, float cutoff_low, const float* scale, int frame)
+{
+    const int cn = src.channels();
+    const float keep_high = 1.0f - cutoff_high;
+    const float keep_low = 1.0f - cutoff_low;
+    const float to_float = 1.0f / IIR_FIXED_POINT_SCALE;
+    const float to_fixed = static_cast<float>(IIR_FIXED_POINT_SCALE);
+    const int row_len = src.cols * cn;
+
+    // Rows are split over the threads, but the dither sequence restarts at every
+    // row from the element index: an element gets the same threshold whatever the
+    // thread count
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+    {
+        const T* s = src.ptr<T>(y);
+        int16_t* lp1 = lowpass_1.ptr<int16_t>(y);
+        int16_t* lp2 = lowpass_2.ptr<int16_t>(y);
+        T* d = dst.ptr<T>(y);
+        const double row_index = static_cast<double>(y) * row_len;
+        int x = 0;
+
+#if defined(__SSE2__)
+        const __m128 v_keep_high = _mm_set1_ps(keep_high);
+        const __m128 v_cut_high = _mm_set1_ps(cutoff_high);
+        const __m128 v_keep_low = _mm_set1_ps(keep_low);
+        const __m128 v_cut_low = _mm_set1_ps(cutoff_low);
+        const __m128 v_to_float = _mm_set1_ps(to_float);
+        const __m128 v_to_fixed = _mm_set1_ps(to_fixed);
+        const __m128 v_dither_step = _mm_set1_ps(static_cast<float>(4 * DITHER_INDEX_STEP - floor(4 * DITHER_INDEX_STEP)));
+        __m128 v_dither = _mm_setr_ps(getDither(frame, row_index), getDither(frame, row_index + 1),
+                                      getDither(frame, row_index + 2), getDither(frame, row_index + 3));
+        const int block = 8 * cn;
+        for (; x <= row_len - block; x += block)
+        {
+            for (int v = 0; v < cn; ++v)
+            {
+                const int i = x + 8 * v;
+                __m128 lp1_lo, lp1_hi, lp2_lo, lp2_hi;
+                loadFixed(lp1 + i, v_to_float, lp1_lo, lp1_hi);
+                loadFixed(lp2 + i, v_to_float, lp2_lo, lp2_hi);
+                __m128 src_lo, src_hi;
+                loadBand(s + i, v_to_float, src_lo, src_hi);
+
+                lp1_lo = _mm_add_ps(_mm_mul_ps(v_keep_high, lp1_lo), _mm_mul_ps(v_cut_high, src_lo));
+                lp1_hi = _mm_add_ps(_mm_mul_ps(v_keep_high, lp1_hi), _mm_mul_ps(v_cut_high, src_hi));
+                lp2_lo = _mm_add_ps(_mm_mul_ps(v_keep_low, lp2_lo), _mm_mul_ps(v_cut_low, src_lo));
+                lp2_hi = _mm_add_ps(_mm_mul_ps(v_keep_low, lp2_hi), _mm_mul_ps(v_cut_low, src_hi));
+
+                storeBand(d + i, _mm_mul_ps(_mm_sub_ps(lp1_lo, lp2_lo), _mm_loadu_ps(scale + 8 * v)),
+                          _mm_mul_ps(_mm_sub_ps(lp1_hi, lp2_hi), _mm_loadu_ps(scale + 8 * v + 4)), v_to_fixed);
+
+                // Both states of an element use the same threshold
+                const __m128 dither_lo = v_dither;
+                const __m128 dither_hi = nextDither(dither_lo, v_dither_step);
+                v_dither = nextDither(dither_hi, v_dither_step);
+                __m128i fixed_lo = roundDither(_mm_mul_ps(lp1_lo, v_to_fixed), dither_lo);
+                __m128i fixed_hi = roundDither(_mm_mul_ps(lp1_hi, v_to_fixed), dither_hi);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(lp1 + i), _mm_packs_epi32(fixed_lo, fixed_hi));
+                fixed_lo = roundDither(_mm_mul_ps(lp2_lo, v_to_fixed), dither_lo);
+                fixed_hi = roundDither(_mm_mul_ps(lp2_hi, v_to_fixed), dither_hi);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(lp2 + i), _mm_packs_epi32(fixed_lo, fixed_hi));
+            }
+        }
+#endif
+
+        // Scalar tail (and fallback for targets without SSE2)
+        for (; x < row_len; ++x)
+        {
+            const float s_f = loadBand(s, x, to_float);
+            float lp1_f = keep_high * (lp1[x] * to_float) + cutoff_high * s_f;
+            float lp2_f = keep_low * (lp2[x] * to_float) + cutoff_low * s_f;
+            storeBand(d, x, (lp1_f - lp2_f) * scale[x % cn], to_fixed);
+            const float dither = getDither(frame, row_index + x);
+            lp1[x] = roundDither(lp1_f * to_fixed, dither);
+            lp2[x] = roundDither(lp2_f * to_fixed, dither);
+        }
+    }
+}
+
+}  // namespace
+
+void fusedTemporalAmplifyFixed(const cv::Mat& src, cv::Mat& lowpass_1, cv::Mat& lowpass_2, cv::Mat& dst,
+                               float cutoff_high, float cutoff_low, float gain, const float* channel_scale,
+                               int frame)
+{
+    CV_Assert((src.depth() == CV_32F || src.depth() == CV_16S) && src.channels() <= MAX_KERNEL_CHANNELS);
+    CV_Assert(lowpass_1.size() == src.size() && lowpass_1.type() == CV_MAKETYPE(CV_16S, src.channels()));
+    CV_Assert(lowpass_2.size() == src.size() && lowpass_2.type() == CV_MAKETYPE(CV_16S, src.channels()));
+    dst.create(src.size(), src.type());
+
+    // Per element scale pattern, a run of 8 * cn elements starts on channel 0
+    const int cn = src.channels();
+    float scale[8 * MAX_KERNEL_CHANNELS];
+    for (int i = 0; i < 8 * cn; ++i)
+        scale[i] = gain * channel_scale[i % cn];
+
+    if (src.depth() == CV_16S)
+        fusedTemporalAmplifyFixedRows<int16_t>(src, lowpass_1, lowpass_2, dst, cutoff_high, cutoff_low, scale, frame);
+    else
+        fusedTemporalAmplifyFixedRows<float>(src, lowpass_1, lowpass_2, dst, cutoff_high, cutoff_low, scale, frame);
+}
@@ -0,0 +1,223 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "param_file.h"
+
+#include <stdlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+namespace po = boost::program_options;
+
+namespace
+{
+
+// Comma separated list of values ("5,10,20"), an empty list gives {fallback}
+bool parseSweepList(const std::string& name, const std::string& list, double fallback, std::vector<double>& values)
+{
+    values.clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        char* end = NULL;
+        double value = strtod(item.c_str(), &end);
+        if (end == item.c_str())
+        {
+            std::cerr << "Error: Invalid value in " << name << ": " << item << std::endl;
+            return false;
+        }
+        values.push_back(value);
+    }
+    if (values.empty())
+        values.push_back(fallback);
+    return true;
+}
+
+// "x,y,w,h;x,y,w,h;..."
+bool parseRois(const std::string& list, std::vector<cv::Rect>& rois)
+{
+    rois.clear();
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ';'))
+    {
+        if (item.find_first_not_of(" \t") == std::string::npos)
+            continue;
+
+        cv::Rect roi;
+        char c1, c2, c3;
+        std::stringstream fields(item);
+        if (!(fields >> roi.x >> c1 >> roi.y >> c2 >> roi.width >> c3 >> roi.height) || c1 != ',' || c2 != ',' ||
+            c3 != ',' || roi.width <= 0 || roi.height <= 0)
+        {
+            std::cerr << "Error: Invalid ROI (expected x,y,w,h): " << item << std::endl;
+            return false;
+        }
+        rois.push_back(roi);
+    }
+    return true;
+}
+
+// The grid of every listed value, unlisted params keep their single value
+bool parseSweep(const std::string lists[5], const MotionMagConfig& config, std::vector<SweepConfig>& configs)
+{
+    configs.clear();
+    if (lists[0].empty() && lists[1].empty() && lists[2].empty() && lists[3].empty() && lists[4].empty())
+        return true;
+
+    std::vector<double> alphas, lambda_cs, lows, highs, chroms;
+    if (!parseSweepList("sweep_alpha", lists[0], config.alpha, alphas) ||
+        !parseSweepList("sweep_lambda_c", lists[1], config.lambda_c, lambda_cs) ||
+        !parseSweepList("sweep_cutoff_freq_low", lists[2], config.cutoff_freq_low, lows) ||
+        !parseSweepList("sweep_cutoff_freq_high", lists[3], config.cutoff_freq_high, highs) ||
+        !parseSweepList("sweep_chrom_attenuation", lists[4], config.chrom_attenuation, chroms))
+        return false;
+
+    for (size_t a = 0; a < alphas.size(); ++a)
+        for (size_t l = 0; l < lambda_cs.size(); ++l)
+            for (size_t fl = 0; fl < lows.size(); ++fl)
+                for (size_t fh = 0; fh < highs.size(); ++fh)
+                    for (size_t c = 0; c < chroms.size(); ++c)
+                    {
+                        SweepConfig sweep = {alphas[a], lambda_cs[l], lows[fl], highs[fh], chroms[c]};
+                        configs.push_back(sweep);
+                    }
+    return true;
+}
+
+}  // namespace
+
+bool loadParamFile(const std::string& file_name, MotionMagConfig& config, RunOptions& options)
+{
+    // Read input param file
+    std::ifstream file(file_name.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to open param file: " << file_name << std::endl;
+        return false;
+    }
+
+    // Values that are parsed further, and delta / lambda, which older param files
+    // still set (they are derived from lambda_c)
+    double delta = 0;
+    double lambda = 0;
+    std::string rois;
+    std::string sweep[5];
+
+    po::options_description io("Input / output");
+    io.add_options()
+        ("input_filename", po::value<std::string>(&options.input_file)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("output_filename", po::value<std::string>(&options.output_file)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("input_format", po::value<std::string>(&options.input_format)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("output_format", po::value<std::string>(&options.output_format)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("raw_width", po::value<int>(&options.raw_width)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("raw_height", po::value<int>(&options.raw_height)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("input_fps", po::value<double>(&config.input_fps)->default_value( 30 ))  // NOLINT [whitespace/parens]
+        ("input_width", po::value<int>(&config.input_width)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("input_height", po::value<int>(&config.input_height)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("output_width", po::value<int>(&config.output_width)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("output_height", po::value<int>(&config.output_height)->default_value( 0 ))  // NOLINT [whitespace/parens]
+    ;  // NOLINT [whitespace/semicolon]
+
+    po::options_description mag("Magnification");
+    mag.add_options()
+        ("alpha", po::value<double>(&config.alpha)->default_value( 20 ))  // NOLINT [whitespace/parens]
+        ("lambda_c", po::value<double>(&config.lambda_c)->default_value( 16 ))  // NOLINT [whitespace/parens]
+        ("cutoff_freq_low", po::value<double>(&config.cutoff_freq_low)->default_value( 0.05 ))  // NOLINT [whitespace/parens]
+        ("cutoff_freq_high", po::value<double>(&config.cutoff_freq_high)->default_value( 0.4 ))  // NOLINT [whitespace/parens]
+        ("chrom_attenuation", po::value<double>(&config.chrom_attenuation)->default_value( 0.1 ))  // NOLINT [whitespace/parens]
+        ("exaggeration_factor", po::value<double>(&config.exaggeration_factor)->default_value( 2.0 ))  // NOLINT [whitespace/parens]
+        ("delta", po::value<double>(&delta)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("lambda", po::value<double>(&lambda)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("levels", po::value<int>(&config.levels)->default_value( 5 ))  // NOLINT [whitespace/parens]
+        ("temporal_filter", po::value<std::string>(&config.temporal_filter)->default_value( "iir" ))  // NOLINT [whitespace/parens]
+        ("sdft_window", po::value<int>(&config.sdft_window)->default_value( 64 ))  // NOLINT [whitespace/parens]
+        ("freq_band_low", po::value<double>(&config.freq_band_low)->default_value( 0.4 ))  // NOLINT [whitespace/parens]
+        ("freq_band_high", po::value<double>(&config.freq_band_high)->default_value( 3.0 ))  // NOLINT [whitespace/parens]
+    ;  // NOLINT [whitespace/semicolon]
+
+    po::options_description kernels("Kernels");
+    kernels.add_options()
+        ("fused_kernel", po::value<bool>(&config.fused_kernel)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("fast_pyramid", po::value<bool>(&config.fast_pyramid)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("fused_color", po::value<bool>(&config.fused_color)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("precision", po::value<std::string>(&config.precision)->default_value( "float" ))  // NOLINT [whitespace/parens]
+        ("color_space", po::value<std::string>(&config.color_space)->default_value( "lab" ))  // NOLINT [whitespace/parens]
+        ("luma_only", po::value<bool>(&config.luma_only)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("direct_output", po::value<bool>(&config.direct_output)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("motion_scale", po::value<double>(&config.motion_scale)->default_value( 1.0 ))  // NOLINT [whitespace/parens]
+    ;  // NOLINT [whitespace/semicolon]
+
+    po::options_description run("Run modes");
+    run.add_options()
+        ("pipelined", po::value<bool>(&options.pipelined)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("pipeline_queue_depth", po::value<int>(&options.pipeline_queue_depth)->default_value( 4 ))  // NOLINT [whitespace/parens]
+        ("headless", po::value<bool>(&options.headless)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("progress_interval", po::value<double>(&options.progress_interval)->default_value( 1.0 ))  // NOLINT [whitespace/parens]
+        ("realtime", po::value<bool>(&options.realtime)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("realtime_log", po::value<std::string>(&options.realtime_log_file)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("max_frames", po::value<int>(&options.max_frames)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("segments", po::value<int>(&options.segments)->default_value( 1 ))  // NOLINT [whitespace/parens]
+        ("segment_warmup", po::value<int>(&options.segment_warmup)->default_value( -1 ))  // NOLINT [whitespace/parens]
+        ("segment_check", po::value<bool>(&options.segment_check)->default_value( false ))  // NOLINT [whitespace/parens]
+        ("pyramid_cache", po::value<std::string>(&options.pyramid_cache_file)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("rois", po::value<std::string>(&rois)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("roi_padding", po::value<int>(&options.roi_padding)->default_value( -1 ))  // NOLINT [whitespace/parens]
+    ;  // NOLINT [whitespace/semicolon]
+
+    po::options_description checks("Profiling and checks");
+    checks.add_options()
+        ("profile_output", po::value<std::string>(&options.profile_output)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("profile_interval", po::value<int>(&options.profile_interval)->default_value( 0 ))  // NOLINT [whitespace/parens]
+        ("reference_file", po::value<std::string>(&options.reference_file)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("reference_min_psnr", po::value<double>(&options.reference_min_psnr)->default_value( 40.0 ))  // NOLINT [whitespace/parens]
+        ("reference_max_error", po::value<double>(&options.reference_max_error)->default_value( 8.0 ))  // NOLINT [whitespace/parens]
+        ("reference_report", po::value<std::string>(&options.reference_report_file)->default_value( "" ))  // NOLINT [whitespace/parens]
+    ;  // NOLINT [whitespace/semicolon]
+
+    po::options_description analysis("Analysis");
+    analysis.add_options()
+        ("analysis_file", po::value<std::string>(&options.analysis_file)->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("analysis_format", po::value<std::string>(&options.analysis_format)->default_value( "csv" ))  // NOLINT [whitespace/parens]
+        ("analysis_grid_cols", po::value<int>(&options.analysis_grid_cols)->default_value( 1 ))  // NOLINT [whitespace/parens]
+        ("analysis_grid_rows", po::value<int>(&options.analysis_grid_rows)->default_value( 1 ))  // NOLINT [whitespace/parens]
+    ;  // NOLINT [whitespace/semicolon]
+
+    // Parameter sweep, comma separated values per parameter
+    po::options_description sweeps("Parameter sweep");
+    sweeps.add_options()
+        ("sweep_alpha", po::value<std::string>(&sweep[0])->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("sweep_lambda_c", po::value<std::string>(&sweep[1])->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("sweep_cutoff_freq_low", po::value<std::string>(&sweep[2])->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("sweep_cutoff_freq_high", po::value<std::string>(&sweep[3])->default_value( "" ))  // NOLINT [whitespace/parens]
+        ("sweep_chrom_attenuation", po::value<std::string>(&sweep[4])->default_value( "" ))  // NOLINT [whitespace/parens]
+    ;  // NOLINT [whitespace/semicolon]
+
+    // Parse param file for getting parameter values
+    po::options_description desc("Eulerian-Motion-Magnification");
+    desc.add_options()
+        ("help,h", "produce help message")
+    ;  // NOLINT [whitespace/semicolon]
+    desc.add(io).add(mag).add(kernels).add(run).add(checks).add(analysis).add(sweeps);
+    po::variables_map vm;
+    po::store(po::parse_config_file(file, desc), vm);
+    po::notify(vm);
+
+    return parseRois(rois, options.rois) && parseSweep(sweep, config, options.sweep_configs);
+}
@@ -0,0 +1,290 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "pyramid_cache.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <iostream>
+
+#define PYRAMID_CACHE_MAGIC "EMMPYRC"
+#define PYRAMID_CACHE_ALIGN 64
+
+namespace
+{
+
+// On-disk header, native byte order (the cache is a local file, not an exchange format)
+struct PyramidCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    int32_t width;
+    int32_t height;
+    int32_t levels;
+    char color_space[8];
+    char pyramid_impl[8];
+    int32_t fused_color;
+    char lab_impl[28];
+    int64_t source_bytes;
+    int64_t source_mtime;
+    uint64_t frame_bytes;
+    int32_t frame_count;
+    uint32_t source_length;
+};
+
+uint64_t getMatBytes(const cv::Size& size)
+{
+    return static_cast<uint64_t>(size.width) * size.height * 3 * sizeof(int16_t);
+}
+
+}  // namespace
+
+PyramidCache::PyramidCache()
+        : key_()
+        , level_sizes_()
+        , frame_bytes_(0)
+        , data_offset_(0)
+        , frame_count_(0)
+        , mapping_(NULL)
+        , mapping_bytes_(0)
+        , file_(NULL)
+        , path_()
+{
+}
+
+PyramidCache::~PyramidCache()
+{
+    close();
+}
+
+bool PyramidCache::getKey(const std::string& source_file, const cv::Size& size, int levels,
+                          const std::string& color_space, bool fast_pyramid, bool fused_color, PyramidCacheKey& key)
+{
+    struct stat info;
+    if (stat(source_file.c_str(), &info) != 0)
+        return false;
+
+    key.source = source_file;
+    key.source_bytes = info.st_size;
+    key.source_mtime = info.st_mtime;
+    key.size = size;
+    key.levels = levels;
+    key.color_space = color_space.substr(0, sizeof(PyramidCacheHeader().color_space) - 1);
+    key.pyramid_impl = fast_pyramid ? "fast" : "opencv";
+    key.fused_color = fused_color;
+    key.lab_impl = fused_color ? "fused" : "cvtColor " CV_VERSION;
+    key.lab_impl = key.lab_impl.substr(0, sizeof(PyramidCacheHeader().lab_impl) - 1);
+    return true;
+}
+
+void PyramidCache::setLayout(const PyramidCacheKey& key)
+{
+    key_ = key;
+
+    // Same sizes as pyrDown: every level rounds up
+    level_sizes_.resize(key.levels + 1);
+    level_sizes_[0] = key.size;
+    for (int l = 1; l <= key.levels; ++l)
+        level_sizes_[l] = cv::Size((level_sizes_[l - 1].width + 1) / 2, (level_sizes_[l - 1].height + 1) / 2);
+
+    frame_bytes_ = 0;
+    for (int l = 0; l <= key.levels; ++l)
+        frame_bytes_ += getMatBytes(level_sizes_[l]);
+
+    const uint64_t header_bytes = sizeof(PyramidCacheHeader) + key.source.size();
+    data_offset_ = (header_bytes + PYRAMID_CACHE_ALIGN - 1) / PYRAMID_CACHE_ALIGN * PYRAMID_CACHE_ALIGN;
+    frame_count_ = 0;
+}
+
+bool PyramidCache::openRead(const std::string& path, const PyramidCacheKey& key, std::string& reason)
+{
+    close();
+    setLayout(key);
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        reason = "missing";
+        return false;
+    }
+
+    struct stat info;
+    PyramidCacheHeader header;
+    std::string source(key.source.size(), '\0');
+    const bool read_ok = fstat(fd, &info) == 0 && pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+                         (source.empty() || pread(fd, &source[0], source.size(), sizeof(header)) ==
+                                                static_cast<ssize_t>(source.size()));
+    if (!read_ok || memcmp(header.magic, PYRAMID_CACHE_MAGIC, sizeof(header.magic)) != 0)
+        reason = "unreadable";
+    else if (header.version != PYRAMID_CACHE_VERSION)
+        reason = "from another version";
+    else if (header.width != key.size.width || header.height != key.size.height || header.levels != key.levels ||
+             strncmp(header.color_space, key.color_space.c_str(), sizeof(header.color_space)) != 0 ||
+             strncmp(header.pyramid_impl, key.pyramid_impl.c_str(), sizeof(header.pyramid_impl)) != 0 ||
+             (header.fused_color != 0) != key.fused_color ||
+             strncmp(header.lab_impl, key.lab_impl.c_str(), sizeof(header.lab_impl)) != 0 ||
+             header.source_bytes != key.source_bytes || header.source_mtime != key.source_mtime ||
+             header.source_length != key.source.size() || source != key.source)
+        reason = "stale";
+    else if (header.frame_bytes != frame_bytes_ || header.frame_count <= 0 ||
+             static_cast<uint64_t>(info.st_size) != data_offset_ + header.frame_count * frame_bytes_)
+        reason = "truncated";
+    if (!reason.empty())
+    {
+        ::close(fd);
+        return false;
+    }
+
+    mapping_bytes_ = info.st_size;
+    void* mapping = mmap(NULL, mapping_bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED)
+    {
+        reason = "not mappable";
+        return false;
+    }
+
+    // Frames are consumed in order, let the kernel read ahead
+    madvise(mapping, mapping_bytes_, MADV_SEQUENTIAL);
+    mapping_ = static_cast<char*>(mapping);
+    frame_count_ = header.frame_count;
+    return true;
+}
+
+bool PyramidCache::openWrite(const std::string& path, const PyramidCacheKey& key)
+{
+    close();
+    setLayout(key);
+
+    path_ = path;
+    file_ = fopen((path_ + ".tmp").c_str(), "wb");
+    if (file_ == NULL)
+    {
+        std::cerr << "Error: Unable to create pyramid cache: " << path_ << ".tmp" << std::endl;
+        return false;
+    }
+    return writeHeader();
+}
+
+bool PyramidCache::writeHeader()
+{
+    PyramidCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PYRAMID_CACHE_MAGIC, sizeof(header.magic));
+    header.version = PYRAMID_CACHE_VERSION;
+    header.width = key_.size.width;
+    header.height = key_.size.height;
+    header.levels = key_.levels;
+    strncpy(header.color_space, key_.color_space.c_str(), sizeof(header.color_space) - 1);
+    strncpy(header.pyramid_impl, key_.pyramid_impl.c_str(), sizeof(header.pyramid_impl) - 1);
+    header.fused_color = key_.fused_color ? 1 : 0;
+    strncpy(header.lab_impl, key_.lab_impl.c_str(), sizeof(header.lab_impl) - 1);
+    header.source_bytes = key_.source_bytes;
+    header.source_mtime = key_.source_mtime;
+    header.frame_bytes = frame_bytes_;
+    header.frame_count = frame_count_;
+    header.source_length = static_cast<uint32_t>(key_.source.size());
+
+    const std::vector<char> padding(data_offset_ - sizeof(header) - key_.source.size(), 0);
+    return fseek(file_, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file_) == 1 &&
+           fwrite(key_.source.data(), 1, key_.source.size(), file_) == key_.source.size() &&
+           fwrite(padding.data(), 1, padding.size(), file_) == padding.size();
+}
+
+bool PyramidCache::append(const std::vector<cv::Mat>& pyramid)
+{
+    CV_Assert(file_ != NULL && static_cast<int>(pyramid.size()) == key_.levels + 1);
+
+    bool ok = true;
+    for (int l = 0; l <= key_.levels && ok; ++l)
+    {
+        CV_Assert((pyramid[l].type() == CV_32FC3 || pyramid[l].type() == CV_16SC3) &&
+                  pyramid[l].size() == level_sizes_[l]);
+        const cv::Mat* quantized = &pyramid[l];
+        if (pyramid[l].type() == CV_32FC3)
+        {
+            pyramid[l].convertTo(quantized_, CV_16SC3, PYRAMID_CACHE_FIXED_POINT_SCALE);
+            quantized = &quantized_;
+        }
+
+        // Rows one after the other, whatever the step of the level
+        for (int y = 0; y < quantized->rows && ok; ++y)
+        {
+            const size_t bytes = quantized->cols * quantized->elemSize();
+            ok = fwrite(quantized->ptr<int16_t>(y), 1, bytes, file_) == bytes;
+        }
+    }
+    if (!ok)
+    {
+        std::cerr << "Warning: Unable to write pyramid cache, dropping it" << std::endl;
+        close();
+        return false;
+    }
+
+    frame_count_++;
+    return true;
+}
+
+bool PyramidCache::finish()
+{
+    if (file_ == NULL)
+        return false;
+
+    // The frame count goes in last, then the file appears under its real name
+    bool ok = writeHeader();
+    ok = (fclose(file_) == 0) && ok;
+    ok = ok && rename((path_ + ".tmp").c_str(), path_.c_str()) == 0;
+    file_ = NULL;
+    if (!ok)
+    {
+        std::cerr << "Error: Unable to commit pyramid cache: " << path_ << std::endl;
+        remove((path_ + ".tmp").c_str());
+    }
+    return ok;
+}
+
+void PyramidCache::close()
+{
+    if (mapping_ != NULL)
+        munmap(mapping_, mapping_bytes_);
+    mapping_ = NULL;
+
+    if (file_ != NULL)
+    {
+        fclose(file_);
+        remove((path_ + ".tmp").c_str());
+    }
+    file_ = NULL;
+}
+
+void PyramidCache::getFrame(int frame, std::vector<cv::Mat>& pyramid, int depth) const
+{
+    CV_Assert(mapping_ != NULL && frame >= 0 && frame < frame_count_);
+    CV_Assert(depth == CV_32F || depth == CV_16S);
+
+    char* data = mapping_ + data_offset_ + frame * frame_bytes_;
+    pyramid.resize(key_.levels + 1);
+    for (int l = 0; l <= key_.levels; ++l)
+    {
+        const cv::Mat quantized(level_sizes_[l], CV_16SC3, data);
+        if (depth == CV_16S)
+            quantized.copyTo(pyramid[l]);
+        else
+            quantized.convertTo(pyramid[l], CV_32FC3, 1.0 / PYRAMID_CACHE_FIXED_POINT_SCALE);
+        data += getMatBytes(level_sizes_[l]);
+    }
+}
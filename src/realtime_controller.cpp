@@ -0,0 +1,83 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "realtime_controller.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <sstream>
+
+// Weight of the newest frame in the cost average
+#define REALTIME_SMOOTHING 0.2
+
+RealtimeController::RealtimeController()
+        : budget_ms_(0)
+        , num_steps_(1)
+        , up_frames_(0)
+        , retry_frames_(0)
+        , step_(0)
+        , step_frames_(0)
+        , average_ms_(0)
+        , too_slow_frame_()
+        , reason_()
+{
+}
+
+void RealtimeController::init(double fps, int num_steps)
+{
+    budget_ms_ = 1000.0 / fps;
+    num_steps_ = std::max(num_steps, 1);
+    up_frames_ = static_cast<int>(ceil(REALTIME_UP_SEC * fps));
+    retry_frames_ = static_cast<int>(ceil(REALTIME_RETRY_SEC * fps));
+    step_ = 0;
+    step_frames_ = 0;
+    average_ms_ = 0;
+    too_slow_frame_.assign(num_steps_, -1);
+    reason_.clear();
+}
+
+bool RealtimeController::update(int frame, double cost_ms)
+{
+    // The average restarts with every step, the previous one measured other work
+    average_ms_ = (step_frames_ == 0) ? cost_ms : average_ms_ + REALTIME_SMOOTHING * (cost_ms - average_ms_);
+    step_frames_++;
+
+    std::ostringstream reason;
+    if (average_ms_ > REALTIME_HIGH_LOAD * budget_ms_ && step_frames_ >= REALTIME_DOWN_FRAMES &&
+        step_ + 1 < num_steps_)
+    {
+        too_slow_frame_[step_] = frame;
+        reason << "average cost " << average_ms_ << " ms over a budget of " << budget_ms_ << " ms";
+        setStep(step_ + 1, reason.str());
+        return true;
+    }
+
+    const int slow_frame = (step_ > 0) ? too_slow_frame_[step_ - 1] : -1;
+    const bool retry = (slow_frame < 0 || frame - slow_frame >= retry_frames_);
+    if (step_ > 0 && average_ms_ < REALTIME_LOW_LOAD * budget_ms_ && step_frames_ >= up_frames_ && retry)
+    {
+        reason << "average cost " << average_ms_ << " ms, under " << REALTIME_LOW_LOAD * 100 << "% of "
+               << budget_ms_ << " ms";
+        setStep(step_ - 1, reason.str());
+        return true;
+    }
+    return false;
+}
+
+void RealtimeController::setStep(int step, const std::string& reason)
+{
+    step_ = step;
+    step_frames_ = 0;
+    reason_ = reason;
+}
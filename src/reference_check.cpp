@@ -0,0 +1,136 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "reference_check.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+ReferenceCheck::ReferenceCheck()
+        : reference_()
+        , open_(false)
+        , file_name_()
+        , min_psnr_(0)
+        , max_error_(0)
+        , frames_(0)
+        , failures_(0)
+        , mse_sum_(0)
+        , worst_psnr_(0)
+        , worst_error_(0)
+{
+}
+
+bool ReferenceCheck::open(const std::string& file_name, const cv::Size& output_size, double fps, double min_psnr,
+                          double max_error)
+{
+    if (!reference_.open(file_name, "", output_size, fps))
+    {
+        std::cerr << "Error: Unable to open reference video file: " << file_name << std::endl;
+        return false;
+    }
+
+    open_ = true;
+    file_name_ = file_name;
+    min_psnr_ = min_psnr;
+    max_error_ = max_error;
+    frames_ = 0;
+    failures_ = 0;
+    mse_sum_ = 0;
+    worst_psnr_ = std::numeric_limits<double>::infinity();
+    worst_error_ = 0;
+    std::cout << "Comparing the output with " << file_name_ << " (PSNR >= " << min_psnr_ << " dB, max abs error <= "
+              << max_error_ << ")" << std::endl;
+    return true;
+}
+
+void ReferenceCheck::compare(const cv::Mat& frame)
+{
+    const int n = frames_++;
+    if (!reference_.read(img_reference_) || img_reference_.size() != frame.size() ||
+        img_reference_.type() != frame.type())
+    {
+        std::cout << "Reference: frame " << n << " has no reference frame of the output size" << std::endl;
+        failures_++;
+        return;
+    }
+
+    const double l2 = cv::norm(frame, img_reference_, cv::NORM_L2);
+    const double mse = l2 * l2 / (static_cast<double>(frame.total()) * frame.channels());
+    const double psnr = (mse > 0) ? 10 * log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+    const double max_error = cv::norm(frame, img_reference_, cv::NORM_INF);
+    mse_sum_ += mse;
+    worst_psnr_ = std::min(worst_psnr_, psnr);
+    worst_error_ = std::max(worst_error_, max_error);
+
+    if (psnr < min_psnr_ || max_error > max_error_)
+    {
+        std::cout << "Reference: frame " << n << " differs, PSNR " << psnr << " dB, max abs error " << max_error
+                  << std::endl;
+        failures_++;
+    }
+}
+
+void ReferenceCheck::finish(const std::string& report_file, const std::string& input_file,
+                            const MotionMagConfig& config)
+{
+    if (!open_)
+        return;
+
+    // A longer reference means frames went missing from the output
+    cv::Mat extra;
+    if (reference_.read(extra))
+    {
+        std::cout << "Reference: has more frames than the " << frames_ << " output frames" << std::endl;
+        failures_++;
+    }
+
+    const double seconds = timer_.getTimeMicroSec() / 1e6;
+    const double fps = (seconds > 0) ? frames_ / seconds : 0;
+    const double mean_mse = (frames_ > 0) ? mse_sum_ / frames_ : 0;
+    const double psnr = (mean_mse > 0) ? 10 * log10(255.0 * 255.0 / mean_mse) : std::numeric_limits<double>::infinity();
+    const bool passed = isPassed();
+    std::cout << "Reference: " << (passed ? "PASS" : "FAIL") << ", " << frames_ << " frames, " << failures_
+              << " failed, PSNR " << psnr << " dB (worst frame " << worst_psnr_ << " dB), max abs error "
+              << worst_error_ << ", " << fps << " fps" << std::endl;
+
+    if (report_file.empty())
+        return;
+
+    // One row per run, so that the accuracy of a code path is recorded next to its speed
+    const bool new_file = !std::ifstream(report_file.c_str()).good();
+    std::ofstream report(report_file.c_str(), std::ios::app);
+    if (!report.is_open())
+    {
+        std::cerr << "Warning: Unable to write reference report: " << report_file << std::endl;
+        return;
+    }
+    if (new_file)
+        report << "input,reference,precision,temporal_filter,color_space,fused_kernel,fast_pyramid,fused_color,"
+               << "direct_output,levels,frames,fps,psnr_db,worst_psnr_db,max_abs_error,failed_frames,result" << std::endl;
+    report << input_file << "," << file_name_ << "," << config.precision << "," << config.temporal_filter << ","
+           << config.color_space << "," << config.fused_kernel << "," << config.fast_pyramid << ","
+           << config.fused_color << "," << config.direct_output << "," << config.levels << "," << frames_ << ","
+           << fps << "," << psnr << "," << worst_psnr_ << "," << worst_error_ << "," << failures_ << ","
+           << (passed ? "pass" : "fail") << std::endl;
+}
+
+bool ReferenceCheck::isPassed() const
+{
+    if (!open_)
+        return true;
+    return frames_ > 0 && failures_ == 0;
+}
@@ -0,0 +1,134 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "roi_processor.h"
+
+RoiProcessor::RoiProcessor()
+        : output_size_()
+{
+}
+
+bool RoiProcessor::init(const MotionMagConfig& config, const std::vector<cv::Rect>& rois, int padding,
+                        const cv::Size& frame_size)
+{
+    // Crops are processed at the source resolution, only the composited frame is resized
+    if ((config.input_width > 0 && config.input_width != frame_size.width) ||
+        (config.input_height > 0 && config.input_height != frame_size.height))
+    {
+        std::cerr << "Error: ROIs are processed at the source resolution (" << frame_size.width << ", "
+                  << frame_size.height << "), remove input_width / input_height or the rois" << std::endl;
+        return false;
+    }
+    output_size_ = (config.output_width > 0 && config.output_height > 0)
+                       ? cv::Size(config.output_width, config.output_height) : frame_size;
+
+    // Padding keeps the crop border out of the coarsest pyramid level under the ROI
+    const int context = (padding >= 0) ? padding : (1 << config.levels);
+    const cv::Rect frame_rect(0, 0, frame_size.width, frame_size.height);
+
+    children_.resize(rois.size());
+    padded_.resize(rois.size());
+    weights_.resize(rois.size());
+    inv_weights_.resize(rois.size());
+    outputs_.resize(rois.size());
+    for (size_t r = 0; r < rois.size(); ++r)
+    {
+        const cv::Rect roi = rois[r] & frame_rect;
+        if (roi.area() <= 0)
+        {
+            std::cerr << "Error: ROI (" << rois[r].x << ", " << rois[r].y << ", " << rois[r].width << ", "
+                      << rois[r].height << ") is outside the frame" << std::endl;
+            return false;
+        }
+        const cv::Rect padded = cv::Rect(roi.x - context, roi.y - context, roi.width + 2 * context,
+                                         roi.height + 2 * context) & frame_rect;
+        padded_[r] = padded;
+
+        MotionMagConfig child_config = config;
+        child_config.gain_size = frame_size;  // same per-level gains as the full frame
+        child_config.input_width = padded.width;
+        child_config.input_height = padded.height;
+        child_config.output_width = padded.width;
+        child_config.output_height = padded.height;
+        children_[r] = cv::Ptr<EulerianMotionMag>(new EulerianMotionMag());
+        if (!children_[r]->init(child_config, padded.size()))
+            return false;
+
+        // Blend weight: 1 on the ROI, ramping to 0 across the padding (not at the frame border)
+        const int left = roi.x - padded.x;
+        const int top = roi.y - padded.y;
+        const int right = padded.br().x - roi.br().x;
+        const int bottom = padded.br().y - roi.br().y;
+        weights_[r].create(padded.size(), CV_32FC1);
+        inv_weights_[r].create(padded.size(), CV_32FC1);
+        for (int y = 0; y < padded.height; ++y)
+        {
+            float wy = 1.0f;
+            if (y < top)
+                wy = (y + 0.5f) / top;
+            else if (y >= padded.height - bottom)
+                wy = (padded.height - y - 0.5f) / bottom;
+
+            float* w = weights_[r].ptr<float>(y);
+            float* inv_w = inv_weights_[r].ptr<float>(y);
+            for (int x = 0; x < padded.width; ++x)
+            {
+                float wx = 1.0f;
+                if (x < left)
+                    wx = (x + 0.5f) / left;
+                else if (x >= padded.width - right)
+                    wx = (padded.width - x - 0.5f) / right;
+                w[x] = wx * wy;
+                inv_w[x] = 1.0f - w[x];
+            }
+        }
+
+        std::cout << "ROI " << r << ": (" << roi.x << ", " << roi.y << ", " << roi.width << ", " << roi.height
+                  << "), processed as (" << padded.x << ", " << padded.y << ", " << padded.width << ", "
+                  << padded.height << ")" << std::endl;
+    }
+    return true;
+}
+
+void RoiProcessor::process(const cv::Mat& input, cv::Mat& output)
+{
+    // Composite straight into output when no resize is needed, the frame outside
+    // the ROIs is copied untouched
+    cv::Mat& composite = (output_size_ == input.size()) ? output : img_composite_;
+    input.copyTo(composite);
+
+    for (size_t r = 0; r < children_.size(); ++r)
+    {
+        const cv::Mat crop = input(padded_[r]);
+        children_[r]->process(crop, outputs_[r]);
+
+        // Overlapping ROIs: the later one wins
+        cv::Mat target = composite(padded_[r]);
+        cv::blendLinear(outputs_[r], crop, weights_[r], inv_weights_[r], target);
+    }
+
+    if (&composite != &output)
+        resize(composite, output, output_size_);
+}
+
+void RoiProcessor::skip(const cv::Mat& input)
+{
+    for (size_t r = 0; r < children_.size(); ++r)
+        children_[r]->skip(input(padded_[r]));
+}
+
+void RoiProcessor::reset()
+{
+    for (size_t r = 0; r < children_.size(); ++r)
+        children_[r]->reset();
+}
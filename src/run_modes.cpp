@@ -0,0 +1,1290 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "run_modes.h"
+
+#include <math.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <chrono>  // NOLINT [build/c++11]
+#include <thread>  // NOLINT [build/c++11]
+
+#include <opencv2/highgui/highgui.hpp>
+
+#include "frame_queue.h"
+#include "roi_processor.h"
+
+#define DISPLAY_WINDOW_NAME "Motion Magnified Output"
+
+RunOptions::RunOptions()
+        : input_file()
+        , output_file()
+        , input_format()
+        , output_format()
+        , raw_width(0)
+        , raw_height(0)
+        , max_frames(0)
+        , headless(false)
+        , progress_interval(1.0)
+        , profile_output()
+        , profile_interval(0)
+        , pipelined(false)
+        , pipeline_queue_depth(4)
+        , rois()
+        , roi_padding(-1)
+        , pyramid_cache_file()
+        , segments(1)
+        , segment_warmup(-1)
+        , segment_check(false)
+        , sweep_configs()
+        , realtime(false)
+        , realtime_log_file()
+        , reference_file()
+        , reference_min_psnr(40.0)
+        , reference_max_error(8.0)
+        , reference_report_file()
+        , analysis_file()
+        , analysis_format("csv")
+        , analysis_grid_cols(1)
+        , analysis_grid_rows(1)
+{
+}
+
+Runner::Runner(const MotionMagConfig& config, const RunOptions& options)
+        : config_(config)
+        , options_(options)
+        , processor_(NULL)
+        , core_(NULL)
+        , recorder_(NULL)
+        , cache_(NULL)
+        , profile_frames_(0)
+        , progress_last_frame_(0)
+        , loop_time_ms_(0)
+        , frame_num_(0)
+        , frame_count_(0)
+{
+}
+
+Runner::~Runner()
+{
+    delete recorder_;
+    delete processor_;
+    delete cache_;
+}
+
+bool Runner::init()
+{
+    bool output_is_stream = false;
+    FrameStreamFormat output_stream_format = STREAM_Y4M;
+    if (!options_.output_file.empty() &&
+        !getFrameStreamFormat(options_.output_file, options_.output_format, output_is_stream, output_stream_format))
+    {
+        std::cerr << "Error: Unsupported output format: " << options_.output_format << " (use video, y4m or bgr)"
+                  << std::endl;
+        return false;
+    }
+
+    // Frames on stdout: move the log output to stderr before anything is printed
+    if (usesOutput() && output_is_stream && options_.output_file == "-" && FrameStreamWriter::reserveStdout() < 0)
+        return false;
+
+    // Input:
+    input_.setMaxFrames(options_.max_frames);
+    if (!input_.open(options_.input_file, options_.input_format, cv::Size(options_.raw_width, options_.raw_height),
+                     config_.input_fps))
+        return false;
+    config_.input_fps = input_.getFps();
+    frame_count_ = input_.getFrameCount();
+
+    // Processing sizes and workspace
+    if (!initMode(input_.getSize()))
+        return false;
+    if (options_.max_frames > 0 && (frame_count_ <= 0 || frame_count_ > options_.max_frames))
+        frame_count_ = options_.max_frames;
+    std::cout << "Input video resolution is (" << processing_size_.width << ", " << processing_size_.height << ")"
+              << std::endl;
+
+    // Output:
+    // Output Display Window (not used in headless mode or by modes without one)
+    if (!options_.headless && usesDisplay())
+        cvNamedWindow(DISPLAY_WINDOW_NAME, CV_WINDOW_AUTOSIZE);
+
+    std::cout << "Output video resolution is (" << output_size_.width << ", " << output_size_.height << ")"
+              << std::endl;
+
+    // Output File (a sweep writes one file per configuration instead, and analysis writes no video):
+    if (usesOutput() && !options_.output_file.empty() &&
+        !output_.open(options_.output_file, options_.output_format, output_size_, config_.input_fps))
+        return false;
+
+    if (!options_.reference_file.empty() &&
+        !reference_.open(options_.reference_file, output_size_, config_.input_fps, options_.reference_min_psnr,
+                         options_.reference_max_error))
+        return false;
+
+#ifndef EMM_ENABLE_PROFILER
+    if (!options_.profile_output.empty() || options_.profile_interval > 0)
+        std::cout << "Warning: Profiling requested but not compiled in (cmake -DENABLE_PROFILER=ON)" << std::endl;
+#endif
+
+    if (options_.headless && usesOutput() && !output_.isOpened())
+        std::cout << "Warning: Running headless without an output file, frames will be discarded" << std::endl;
+
+    std::cout << "Init Successful" << std::endl;
+    return true;
+}
+
+void Runner::run()
+{
+    std::cout << "Running Eulerian Motion Magnification...\n" << std::endl;
+
+    progress_timer_.start();
+    progress_last_frame_ = 0;
+    reference_.start();
+
+    runMode();
+
+    finishPyramidCache();
+    reference_.finish(options_.reference_report_file, options_.input_file,
+                      (core_ != NULL) ? core_->getConfig() : config_);
+    reportProfile();
+}
+
+FrameProcessor* Runner::newProcessor(const MotionMagConfig& config, const cv::Size& size) const
+{
+    if (!options_.rois.empty())
+    {
+        RoiProcessor* rois = new RoiProcessor();
+        if (rois->init(config, options_.rois, options_.roi_padding, size))
+            return rois;
+        delete rois;
+        return NULL;
+    }
+
+    EulerianMotionMag* core = new EulerianMotionMag();
+    if (core->init(config, size))
+        return core;
+    delete core;
+    return NULL;
+}
+
+bool Runner::setProcessor(FrameProcessor* processor)
+{
+    if (processor == NULL)
+        return false;
+
+    delete processor_;
+    processor_ = processor;
+    core_ = dynamic_cast<EulerianMotionMag*>(processor_);
+
+    // ROIs are processed at the source size
+    processing_size_ = (core_ != NULL) ? cv::Size(core_->getConfig().input_width, core_->getConfig().input_height)
+                                       : input_.getSize();
+    output_size_ = processor_->getOutputSize();
+    return true;
+}
+
+bool Runner::openPyramidCache(bool supported)
+{
+    if (options_.pyramid_cache_file.empty())
+        return true;
+
+    // The cache replaces the decode of one whole file. Replays have no source
+    // frames, so there is nothing to composite a scaled down motion onto.
+    if (!supported || input_.isStream() || core_ == NULL || config_.motion_scale != 1.0 || config_.luma_only)
+    {
+        std::cout << "Pyramid cache is not used with stream input, ROIs, segment-parallel runs, motion_scale,"
+                  << " real-time or luma only mode" << std::endl;
+        return true;
+    }
+
+    const MotionMagConfig& config = core_->getConfig();
+    PyramidCacheKey key;
+    if (!PyramidCache::getKey(options_.input_file, processing_size_, config.levels, config.color_space,
+                              config.fast_pyramid, config.fused_color, key))
+    {
+        std::cerr << "Error: Unable to stat input video file: " << options_.input_file << std::endl;
+        return false;
+    }
+
+    cache_ = new PyramidCache();
+    std::string reason;
+    if (cache_->openRead(options_.pyramid_cache_file, key, reason))
+    {
+        frame_count_ = cache_->getFrameCount();
+        std::cout << "Pyramid cache: " << frame_count_ << " frames from " << options_.pyramid_cache_file << std::endl;
+
+        // Replay buffers of the type of the core's levels, the levels are
+        // dequantized (or with int16 precision copied) into them every frame
+        cached_pyramid_.resize(config.levels + 1);
+        for (int l = 0; l <= config.levels; ++l)
+            cached_pyramid_[l].create(core_->getLaplacianPyramid()[l].size(), core_->getLaplacianPyramid()[l].type());
+        cached_image_.create(processing_size_, CV_32FC3);
+        return true;
+    }
+
+    std::cout << "Pyramid cache " << reason << ", recording " << options_.pyramid_cache_file << std::endl;
+    return cache_->openWrite(options_.pyramid_cache_file, key);
+}
+
+void Runner::readCachedFrame(int frame, bool with_image)
+{
+    // The cache holds the pyramid only, the color image is its collapse
+    EMM_PROFILE_SCOPE(getProfiler(), STAGE_READ);
+    cache_->getFrame(frame, cached_pyramid_, cached_pyramid_[0].depth());
+    if (with_image)
+        core_->reconImgFromLaplacianPyramid(cached_pyramid_, core_->getConfig().levels, cached_image_);
+}
+
+void Runner::finishPyramidCache()
+{
+    if (!isCacheRecording())
+        return;
+
+    // Only a pass over every frame of the input is worth keeping
+    if (!input_.isComplete() || cache_->getFrameCount() != input_.getFramesRead())
+    {
+        std::cout << "Pyramid cache discarded, the run stopped before the end of the input" << std::endl;
+        cache_->close();
+        return;
+    }
+
+    if (cache_->finish())
+        std::cout << "Pyramid cache: recorded " << input_.getFramesRead() << " frames to "
+                  << options_.pyramid_cache_file << std::endl;
+}
+
+bool Runner::readFrame(cv::Mat& frame)
+{
+    EMM_PROFILE_SCOPE(getProfiler(), STAGE_READ);
+    return input_.read(frame);
+}
+
+bool Runner::writeFrame(const cv::Mat& frame)
+{
+    EMM_PROFILE_SCOPE(getProfiler(), STAGE_WRITE);
+    return output_.write(frame);
+}
+
+bool Runner::outputFrame(const cv::Mat& frame)
+{
+    if (reference_.isOpen())
+        reference_.compare(frame);
+
+    if (output_.isOpened() && !writeFrame(frame))
+    {
+        std::cerr << "Error: Unable to write to output stream: " << options_.output_file << std::endl;
+        return false;
+    }
+
+    if (options_.profile_interval > 0 && ++profile_frames_ % options_.profile_interval == 0)
+        reportProfile();
+
+    // Headless: no window, no GUI event pumping
+    if (options_.headless)
+        return true;
+
+    imshow(DISPLAY_WINDOW_NAME, frame);
+    char c = cv::waitKey(1);
+    return (c != 27);
+}
+
+void Runner::reportProfile()
+{
+#ifdef EMM_ENABLE_PROFILER
+    if (!options_.profile_output.empty())
+    {
+        getProfiler()->save(options_.profile_output);
+        return;
+    }
+
+    std::cout << "\nStage latency profile:" << std::endl;
+    getProfiler()->print(std::cout);
+#endif
+}
+
+void Runner::reportProgress(int frames_done)
+{
+    // Throttled progress report for headless runs
+    double elapsed_sec = progress_timer_.getTimeMicroSec() / 1e6;
+    if (elapsed_sec < options_.progress_interval && frames_done != frame_count_)
+        return;
+
+    double fps = (elapsed_sec > 0) ? (frames_done - progress_last_frame_) / elapsed_sec : 0;
+    std::cout << "Processed " << frames_done << " / " << frame_count_ << " frames (" << fps << " fps)" << std::endl;
+
+    progress_timer_.start();
+    progress_last_frame_ = frames_done;
+}
+
+void Runner::beginFrameLog(const char* action, int frame)
+{
+    if (!options_.headless)
+        std::cout << action << " image frame: " << frame << " / " << frame_count_ << std::flush;
+}
+
+void Runner::endFrameLog(int frames_done)
+{
+    loop_time_ms_ = timer_.getTimeMilliSec();
+    if (!options_.headless)
+        std::cout << " | Time taken: " << loop_time_ms_ << " ms" << std::endl;
+    else
+        reportProgress(frames_done);
+}
+
+PyramidCacheRecorder::PyramidCacheRecorder(EulerianMotionMag* core, PyramidCache* cache)
+        : core_(core)
+        , cache_(cache)
+        , all_bands_(core->getConfig().levels + 1, true)
+{
+}
+
+void PyramidCacheRecorder::process(const cv::Mat& input, cv::Mat& output)
+{
+    core_->setFrameThreads();
+    core_->decompose(input, &all_bands_);
+    cache_->append(core_->getLaplacianPyramid());
+    core_->processBands(core_->getInputImage(), core_->getLaplacianPyramid(), &input, output);
+}
+
+void PyramidCacheRecorder::skip(const cv::Mat& input)
+{
+    core_->setFrameThreads();
+    core_->decompose(input, &all_bands_);
+    cache_->append(core_->getLaplacianPyramid());
+    core_->filterBands(core_->getLaplacianPyramid());
+}
+
+bool SerialRunner::initMode(const cv::Size& source_size)
+{
+    if (!setProcessor(newProcessor(config_, source_size)) || !openPyramidCache(true))
+        return false;
+
+    if (isCacheRecording())
+        recorder_ = new PyramidCacheRecorder(core_, cache_);
+
+    if (isCacheReplay() && core_->getConfig().direct_output)
+    {
+        // No source frames to composite onto: full size motion image, default path
+        std::cout << "Direct output is not used when replaying a pyramid cache" << std::endl;
+        config_.direct_output = false;
+        return setProcessor(newProcessor(config_, source_size));
+    }
+    return true;
+}
+
+void SerialRunner::runMode()
+{
+    if (isCacheReplay())
+    {
+        runCached();
+        return;
+    }
+
+    FrameProcessor* processor = getFrameProcessor();
+    while (1)
+    {
+        timer_.start();
+
+        if (!readFrame(img_frame_))
+            break;
+
+        beginFrameLog("Processing", frame_num_);
+        processor->process(img_frame_, img_output_);
+        frame_num_++;
+        bool keep_running = outputFrame(img_output_);
+        endFrameLog(frame_num_);
+
+        if (!keep_running)
+            break;
+    }
+}
+
+void SerialRunner::runCached()
+{
+    // Decode, resize, color conversion and pyramid all come from the cache
+    for (int f = 0; f < frame_count_; ++f)
+    {
+        timer_.start();
+
+        readCachedFrame(f, true);
+
+        beginFrameLog("Processing", frame_num_);
+        core_->setFrameThreads();
+        core_->processBands(cached_image_, cached_pyramid_, NULL, img_output_);
+        frame_num_++;
+        bool keep_running = outputFrame(img_output_);
+        endFrameLog(frame_num_);
+
+        if (!keep_running)
+            break;
+    }
+}
+
+void PipelinedRunner::runMode()
+{
+    if (isCacheReplay())
+    {
+        std::cout << "A pyramid cache is replayed serially, pipelined is ignored" << std::endl;
+        SerialRunner::runMode();
+        return;
+    }
+
+    // Decoder and processing stages run on their own threads, the calling thread is the sink
+    // (HighGUI has to stay on the main thread). Stages exchange pointers to recycled frame
+    // buffers: the free queues return consumed buffers to the stage that fills them.
+    const size_t depth = std::max(options_.pipeline_queue_depth, 1);
+    const size_t num_buffers = depth + 2;  // queued frames + one held by each side
+    std::vector<cv::Mat> input_buffers(num_buffers);
+    std::vector<cv::Mat> output_buffers(num_buffers);
+    FrameQueue<cv::Mat*> free_input(num_buffers);
+    FrameQueue<cv::Mat*> decoded(depth);
+    FrameQueue<cv::Mat*> free_output(num_buffers);
+    FrameQueue<cv::Mat*> processed(depth);
+    for (size_t i = 0; i < num_buffers; ++i)
+    {
+        free_input.tryPush(&input_buffers[i]);
+        free_output.tryPush(&output_buffers[i]);
+    }
+
+    FrameProcessor* processor = getFrameProcessor();
+    std::atomic<bool> abort(false);
+    double decode_ms = 0;
+    double process_ms = 0;
+    double sink_ms = 0;
+    int num_frames = 0;
+    Timer wall_timer;
+
+    // Stage 1: decode
+    std::thread decoder([&]()
+    {
+        cv::Mat* frame;
+        while (free_input.pop(frame, abort))
+        {
+            Timer stage_timer;
+            readFrame(*frame);
+            decode_ms += stage_timer.getTimeMicroSec() / 1000.0;
+            if (frame->empty() || !decoded.push(frame, abort))
+                break;
+        }
+        decoded.push(NULL, abort);  // end of stream
+    });  // NOLINT [whitespace/braces]
+
+    // Stage 2: process
+    std::thread worker([&]()
+    {
+        cv::Mat* input;
+        cv::Mat* output;
+        while (decoded.pop(input, abort) && input != NULL)
+        {
+            if (!free_output.pop(output, abort))
+                break;
+
+            Timer stage_timer;
+            processor->process(*input, *output);
+            process_ms += stage_timer.getTimeMicroSec() / 1000.0;
+
+            free_input.push(input, abort);
+            if (!processed.push(output, abort))
+                break;
+        }
+        processed.push(NULL, abort);  // end of stream
+    });  // NOLINT [whitespace/braces]
+
+    // Stage 3: display / encode
+    cv::Mat* output;
+    while (processed.pop(output, abort) && output != NULL)
+    {
+        timer_.start();
+        beginFrameLog("Processing", num_frames);
+
+        bool keep_running = outputFrame(*output);
+        free_output.push(output, abort);
+        num_frames++;
+
+        endFrameLog(num_frames);
+        sink_ms += loop_time_ms_;
+
+        if (!keep_running)
+            abort = true;
+    }
+    abort = true;
+    decoder.join();
+    worker.join();
+    frame_num_ = num_frames;
+
+    double wall_ms = wall_timer.getTimeMilliSec();
+    std::cout << "\nPipeline stats: " << num_frames << " frames in " << wall_ms << " ms ("
+              << (wall_ms > 0 ? num_frames * 1000.0 / wall_ms : 0) << " fps)" << std::endl;
+    std::cout << "  decode  : busy " << decode_ms << " ms, stalled "
+              << free_input.getPopStallMilliSec() + decoded.getPushStallMilliSec() << " ms" << std::endl;
+    std::cout << "  process : busy " << process_ms << " ms, stalled "
+              << decoded.getPopStallMilliSec() + free_output.getPopStallMilliSec() + processed.getPushStallMilliSec()
+              << " ms" << std::endl;
+    std::cout << "  sink    : busy " << sink_ms << " ms, stalled " << processed.getPopStallMilliSec() << " ms" << std::endl;
+    std::cout << "  queue decode -> process : depth avg " << decoded.getAverageDepth() << " / max "
+              << decoded.getMaxDepth() << " (capacity " << decoded.capacity() << ")" << std::endl;
+    std::cout << "  queue process -> sink   : depth avg " << processed.getAverageDepth() << " / max "
+              << processed.getMaxDepth() << " (capacity " << processed.capacity() << ")" << std::endl;
+}
+
+// One time segment of a segment-parallel run
+struct SegmentRunner::Job
+{
+    int begin;          // first output frame
+    int end;            // one past the last output frame
+    int warmup_begin;   // first frame fed to the filter
+    std::string temp_file;
+    bool ok;
+    int frames;
+
+    // Boundary check (segment_check): output and motion image of the first
+    // frame of this segment, and of the same frame from a serial pass
+    cv::Mat first_output;
+    cv::Mat first_motion;
+    cv::Mat serial_output;
+    cv::Mat serial_motion;
+};
+
+bool SegmentRunner::initMode(const cv::Size& source_size)
+{
+    // The processor of this thread only checks the config and resolves the sizes,
+    // every segment runs its own
+    if (!setProcessor(newProcessor(config_, source_size)) || !openPyramidCache(false))
+        return false;
+    source_size_ = source_size;
+
+    if (options_.output_file.empty())
+    {
+        std::cerr << "Error: Segment-parallel processing needs an output_filename" << std::endl;
+        return false;
+    }
+
+    if (options_.input_file == "-")
+    {
+        std::cerr << "Error: Segment-parallel processing needs a seekable input, not stdin" << std::endl;
+        return false;
+    }
+
+    if (frame_count_ <= 0 && options_.max_frames <= 0)
+    {
+        std::cerr << "Error: Segment-parallel processing needs a known frame count" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void SegmentRunner::runMode()
+{
+    const int num_segments = std::min(options_.segments, frame_count_);
+    const int warmup = getWarmupFrames();
+    std::cout << "Segment-parallel run: " << num_segments << " segments, " << warmup << " warm-up frames" << std::endl;
+
+    std::vector<Job> jobs(num_segments);
+    for (int s = 0; s < num_segments; ++s)
+    {
+        std::ostringstream temp_file;
+        temp_file << options_.output_file << ".seg" << s << ".avi";
+
+        jobs[s].begin = static_cast<int>(static_cast<int64_t>(frame_count_) * s / num_segments);
+        jobs[s].end = static_cast<int>(static_cast<int64_t>(frame_count_) * (s + 1) / num_segments);
+        jobs[s].warmup_begin = std::max(0, jobs[s].begin - warmup);
+        jobs[s].temp_file = temp_file.str();
+        jobs[s].ok = false;
+        jobs[s].frames = 0;
+    }
+
+    // Segments run on their own threads, each with its own reader, filter state and
+    // temp file. The serial check pass is one more thread, up to the last boundary.
+    const int num_workers = num_segments + (options_.segment_check ? 1 : 0);
+    const int budget = (config_.shared_num_threads != NULL) ? config_.shared_num_threads->load() : omp_get_num_procs();
+    const int num_threads = std::max(1, budget / num_workers);
+    std::atomic<int> frames_done(0);
+    std::atomic<int> workers_done(0);
+    std::vector<std::thread> workers;
+    for (int s = 0; s < num_segments; ++s)
+    {
+        workers.push_back(std::thread([this, &jobs, &frames_done, &workers_done, s, num_threads]()
+        {
+            processSegment(jobs[s], num_threads, frames_done);
+            workers_done++;
+        }));  // NOLINT [whitespace/braces]
+    }
+    if (options_.segment_check)
+    {
+        workers.push_back(std::thread([this, &jobs, &workers_done, num_threads]()
+        {
+            processSerialCheck(jobs, num_threads);
+            workers_done++;
+        }));  // NOLINT [whitespace/braces]
+    }
+    while (workers_done < num_workers)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        reportProgress(frames_done);
+    }
+    for (size_t i = 0; i < workers.size(); ++i)
+        workers[i].join();
+
+    // Concatenate in order
+    bool ok = true;
+    for (int s = 0; s < num_segments; ++s)
+    {
+        if (!jobs[s].ok)
+        {
+            std::cerr << "Error: Segment " << s << " failed" << std::endl;
+            ok = false;
+            continue;
+        }
+
+        cv::VideoCapture segment(jobs[s].temp_file);
+        int frames = 0;
+        while (segment.read(img_output_))
+        {
+            writeFrame(img_output_);
+            frames++;
+        }
+        segment.release();
+        remove(jobs[s].temp_file.c_str());
+
+        if (frames != jobs[s].frames)
+            std::cerr << "Warning: Segment " << s << " wrote " << jobs[s].frames << " frames, read back " << frames
+                      << std::endl;
+    }
+    frame_num_ = frames_done;
+    if (!ok || !options_.segment_check)
+        return;
+
+    // Deviation of the first frame of every segment from the serial pass
+    std::cout << "\nSegment boundaries (max abs deviation from serial):" << std::endl;
+    for (int s = 1; s < num_segments; ++s)
+    {
+        const Job& job = jobs[s];
+        if (job.serial_output.empty() || job.first_output.empty())
+            continue;
+        std::cout << "  frame " << job.begin << " : output " << cv::norm(job.serial_output, job.first_output, cv::NORM_INF)
+                  << " (8-bit)";
+        if (!job.serial_motion.empty() && !job.first_motion.empty())  // no full-frame motion image with ROIs
+            std::cout << ", motion " << cv::norm(job.serial_motion, job.first_motion, cv::NORM_INF) << " (Lab)";
+        std::cout << std::endl;
+    }
+}
+
+bool SegmentRunner::openInput(int first_frame, VideoInput& input) const
+{
+    // The same source init() opened (stdin is rejected by initMode())
+    if (!input.open(options_.input_file, options_.input_format, cv::Size(options_.raw_width, options_.raw_height),
+                    config_.input_fps))
+        return false;
+    if (!input.seek(first_frame))
+    {
+        std::cerr << "Error: Unable to seek to frame " << first_frame << " of " << options_.input_file << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void SegmentRunner::processSegment(Job& job, int num_threads, std::atomic<int>& frames_done) const
+{
+    VideoInput input;
+    if (!openInput(job.warmup_begin, input))
+        return;
+
+    // Lossless intermediate, so the final encode is the only lossy step
+    cv::VideoWriter writer(job.temp_file, CV_FOURCC('F', 'F', 'V', '1'), config_.input_fps, output_size_, true);
+    if (!writer.isOpened())
+        writer.open(job.temp_file, VideoOutput::getCodecNumber(options_.output_file), config_.input_fps, output_size_,
+                    true);
+    if (!writer.isOpened())
+    {
+        std::cerr << "Error: Unable to create segment file: " << job.temp_file << std::endl;
+        return;
+    }
+
+    MotionMagConfig config = config_;
+    config.num_threads = num_threads;
+    config.shared_num_threads = NULL;
+    cv::Ptr<FrameProcessor> processor(newProcessor(config, source_size_));
+    if (processor.empty())
+        return;
+
+    cv::Mat frame, output;
+    for (int f = job.warmup_begin; f < job.end && input.read(frame); ++f)
+    {
+        processor->process(frame, output);
+        if (f < job.begin)
+            continue;  // warm-up
+
+        if (f == job.begin)
+        {
+            output.copyTo(job.first_output);
+            processor->getMotionImage().copyTo(job.first_motion);
+        }
+
+        writer.write(output);
+        job.frames++;
+        frames_done++;
+    }
+    writer.release();
+    job.ok = true;
+}
+
+void SegmentRunner::processSerialCheck(std::vector<Job>& jobs, int num_threads) const
+{
+    VideoInput input;
+    if (!openInput(0, input))
+        return;
+
+    MotionMagConfig config = config_;
+    config.num_threads = num_threads;
+    config.shared_num_threads = NULL;
+    cv::Ptr<FrameProcessor> processor(newProcessor(config, source_size_));
+    if (processor.empty())
+        return;
+
+    // From the first frame without warm-up, up to the first frame of the last segment
+    cv::Mat frame, output;
+    size_t next = 1;
+    for (int f = 0; next < jobs.size() && input.read(frame); ++f)
+    {
+        processor->process(frame, output);
+        if (f == jobs[next].begin)
+        {
+            output.copyTo(jobs[next].serial_output);
+            processor->getMotionImage().copyTo(jobs[next].serial_motion);
+            next++;
+        }
+    }
+}
+
+int SegmentRunner::getWarmupFrames() const
+{
+    if (options_.segment_warmup >= 0)
+        return options_.segment_warmup;
+
+    // The sliding DFT state is exactly the last window of frames
+    if (config_.temporal_filter == "sdft")
+        return config_.sdft_window;
+
+    // Slowest IIR pole (1 - cutoff) decayed to 1e-3 of the initial state
+    const double pole = 1.0 - std::min(config_.cutoff_freq_low, config_.cutoff_freq_high);
+    if (pole <= 0)
+        return 1;
+    if (pole >= 1)
+        return frame_count_;
+    return static_cast<int>(ceil(log(1e-3) / log(pole)));
+}
+
+bool SweepRunner::initMode(const cv::Size& source_size)
+{
+    bool output_is_stream = false;
+    FrameStreamFormat format = STREAM_Y4M;
+    if (options_.output_file.empty())
+    {
+        std::cerr << "Error: Parameter sweep needs an output_filename" << std::endl;
+        return false;
+    }
+
+    getFrameStreamFormat(options_.output_file, options_.output_format, output_is_stream, format);
+    if (output_is_stream)
+    {
+        std::cerr << "Error: Parameter sweep writes video files, not an output stream" << std::endl;
+        return false;
+    }
+
+    // processor_ decomposes every frame once, its own gains are not used
+    if (!setProcessor(newProcessor(config_, source_size)) || !openPyramidCache(true))
+        return false;
+    if (isCacheReplay() && config_.direct_output)
+    {
+        std::cout << "Direct output is not used when replaying a pyramid cache" << std::endl;
+        config_.direct_output = false;
+    }
+
+    // One child per configuration owns the temporal filter state and the output.
+    // The pyramid is built once for the union of the bands any child amplifies.
+    const int num_configs = static_cast<int>(options_.sweep_configs.size());
+    const int levels = core_->getConfig().levels;
+    std::cout << "Parameter sweep: " << num_configs << " configurations" << std::endl;
+    children_.resize(num_configs);
+    outputs_.resize(num_configs);
+    images_.resize(num_configs);
+    bands_.assign(levels + 1, false);
+    for (int c = 0; c < num_configs; ++c)
+    {
+        const SweepConfig& sweep = options_.sweep_configs[c];
+        MotionMagConfig config = config_;
+        config.alpha = sweep.alpha;
+        config.lambda_c = sweep.lambda_c;
+        config.cutoff_freq_low = sweep.cutoff_freq_low;
+        config.cutoff_freq_high = sweep.cutoff_freq_high;
+        config.chrom_attenuation = sweep.chrom_attenuation;
+        children_[c] = cv::Ptr<EulerianMotionMag>(new EulerianMotionMag());
+        if (!children_[c]->init(config, source_size))
+            return false;
+        for (int l = 0; l <= levels; ++l)
+            bands_[l] = bands_[l] || children_[c]->getActiveBands()[l];
+
+        const std::string file_name = getFileName(sweep);
+        outputs_[c] = cv::Ptr<VideoOutput>(new VideoOutput());
+        if (!outputs_[c]->open(file_name, "video", output_size_, config_.input_fps))
+            return false;
+        std::cout << "  " << file_name << std::endl;
+    }
+    return true;
+}
+
+void SweepRunner::runMode()
+{
+    const int num_configs = static_cast<int>(children_.size());
+    const bool cache_read = isCacheReplay();
+    const bool cache_write = isCacheRecording();
+    const std::vector<bool> all_bands(bands_.size(), true);
+    while (1)
+    {
+        // Decode, color conversion and pyramid once per frame (or straight from the cache)
+        const cv::Mat* image = &core_->getInputImage();
+        const std::vector<cv::Mat>* pyramid = &core_->getLaplacianPyramid();
+        const cv::Mat* source = cache_read ? NULL : &img_frame_;
+        if (cache_read)
+        {
+            if (frame_num_ >= frame_count_)
+                break;
+            readCachedFrame(frame_num_, true);
+            image = &cached_image_;
+            pyramid = &cached_pyramid_;
+        }
+        else
+        {
+            if (!readFrame(img_frame_))
+                break;
+
+            core_->setFrameThreads();
+            core_->decompose(img_frame_, cache_write ? &all_bands : &bands_);
+            if (cache_write)
+                cache_->append(core_->getLaplacianPyramid());
+        }
+
+        // Temporal filter, amplify and reconstruct per configuration. Nested OpenMP
+        // regions inside the children run on the calling thread.
+        #pragma omp parallel for schedule(dynamic)
+        for (int c = 0; c < num_configs; ++c)
+        {
+            children_[c]->processBands(*image, *pyramid, source, images_[c]);
+            outputs_[c]->write(images_[c]);
+        }
+
+        frame_num_++;
+        reportProgress(frame_num_);
+    }
+}
+
+std::string SweepRunner::getFileName(const SweepConfig& sweep) const
+{
+    std::ostringstream suffix;
+    suffix << "_a" << sweep.alpha << "_lc" << sweep.lambda_c << "_fl" << sweep.cutoff_freq_low << "_fh"
+           << sweep.cutoff_freq_high << "_ca" << sweep.chrom_attenuation;
+
+    // output.avi -> output_a10_lc16_fl0.05_fh0.4_ca0.1.avi
+    const std::string& output_file = options_.output_file;
+    const size_t dot = output_file.find_last_of('.');
+    const size_t slash = output_file.find_last_of('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return output_file + suffix.str();
+    return output_file.substr(0, dot) + suffix.str() + output_file.substr(dot);
+}
+
+bool RealtimeRunner::initMode(const cv::Size& source_size)
+{
+    if (!(config_.input_fps > 0))
+    {
+        std::cerr << "Error: Real-time mode needs the frame rate of the input (input_fps)" << std::endl;
+        return false;
+    }
+
+    if (options_.pipelined)
+        std::cout << "Real-time mode runs decode, processing and output in turn, pipelined is ignored" << std::endl;
+
+    if (!setProcessor(newProcessor(config_, source_size)) || !openPyramidCache(false))
+        return false;
+
+    // Cheaper steps estimate the motion at 1/2, 1/4, 1/8 of the scale of step 0, as
+    // long as a band between the finest and the coarsest level is left to amplify
+    const int offset = (config_.motion_scale < 1.0) ? static_cast<int>(floor(-log2(config_.motion_scale) + 0.5)) : 0;
+    steps_.assign(1, cv::Ptr<FrameProcessor>());
+    step_scales_.assign(1, config_.motion_scale);
+    for (int s = 1; s <= 3 && config_.levels - offset - s >= 2; ++s)
+    {
+        MotionMagConfig config = config_;
+        config.motion_scale = ldexp(config_.motion_scale, -s);
+        cv::Ptr<FrameProcessor> step(newProcessor(config, source_size));
+        if (step.empty())
+            return false;
+        steps_.push_back(step);
+        step_scales_.push_back(config.motion_scale);
+    }
+
+    controller_.init(config_.input_fps, static_cast<int>(steps_.size()));
+    std::cout << "Real-time mode: " << controller_.getBudgetMilliSec() << " ms per frame, " << steps_.size()
+              << " quality steps" << std::endl;
+    return true;
+}
+
+void RealtimeRunner::runMode()
+{
+    // Frame f is due f periods after the first one, as it would arrive from a live
+    // source, and is not read before that. A frame whose successor is already due
+    // is skipped and the previous output is repeated, so the output keeps the rate.
+    // A skipped frame still goes through the temporal filter (not the reconstruction
+    // and color conversion back), so the filter sees every frame at its rate.
+    const double period_ms = controller_.getBudgetMilliSec();
+    std::ofstream log;
+    if (!options_.realtime_log_file.empty())
+    {
+        log.open(options_.realtime_log_file.c_str());
+        if (!log.is_open())
+            std::cerr << "Warning: Unable to create real-time log: " << options_.realtime_log_file << std::endl;
+        log << "frame,due_ms,latency_ms,cost_ms,step,skipped" << std::endl;
+    }
+
+    FrameProcessor* stage = processor_;
+    Timer clock;
+    int processed = 0;
+    int skipped = 0;
+    int changes = 0;
+    double latency_sum_ms = 0;
+    double latency_max_ms = 0;
+    for (int f = 0;; ++f)
+    {
+        const double due_ms = f * period_ms;
+        const double wait_ms = due_ms - clock.getTimeMicroSec() / 1000.0;
+        if (wait_ms > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(static_cast<int64_t>(wait_ms * 1000)));
+
+        timer_.start();
+        if (!readFrame(img_frame_))
+            break;
+        frame_num_++;
+
+        if (f > 0 && clock.getTimeMicroSec() / 1000.0 > due_ms + period_ms)
+        {
+            stage->skip(img_frame_);
+            skipped++;
+            if (output_.isOpened() && !writeFrame(img_output_))
+                break;
+            log << f << "," << due_ms << ",,," << controller_.getStep() << ",1\n";
+            continue;
+        }
+
+        beginFrameLog("Processing", f);
+
+        stage->process(img_frame_, img_output_);
+        bool keep_running = outputFrame(img_output_);
+
+        loop_time_ms_ = timer_.getTimeMicroSec() / 1000.0;
+        const double latency_ms = clock.getTimeMicroSec() / 1000.0 - due_ms;
+        latency_sum_ms += latency_ms;
+        latency_max_ms = std::max(latency_max_ms, latency_ms);
+        processed++;
+        log << f << "," << due_ms << "," << latency_ms << "," << loop_time_ms_ << "," << controller_.getStep()
+            << ",0\n";
+
+        if (!options_.headless)
+            std::cout << " | Time taken: " << loop_time_ms_ << " ms | Latency: " << latency_ms << " ms" << std::endl;
+        else
+            reportProgress(f + 1);
+
+        const int previous_step = controller_.getStep();
+        if (controller_.update(f, loop_time_ms_))
+        {
+            // The new step starts its temporal filter over from this frame on
+            const int step = controller_.getStep();
+            stage = (step == 0) ? processor_ : &*steps_[step];
+            stage->reset();
+            changes++;
+            std::cout << "Real-time: frame " << f << ", quality step " << previous_step << " -> " << step
+                      << " (motion_scale " << step_scales_[step] << "), " << controller_.getReason() << std::endl;
+        }
+
+        if (!keep_running)
+            break;
+    }
+
+    std::cout << "Real-time: " << processed << " frames processed, " << skipped << " skipped, latency avg "
+              << (processed > 0 ? latency_sum_ms / processed : 0) << " ms / max " << latency_max_ms << " ms, "
+              << changes << " quality changes, final step " << controller_.getStep() << std::endl;
+}
+
+bool AnalysisRunner::initMode(const cv::Size& source_size)
+{
+    if (options_.analysis_format != "csv" && options_.analysis_format != "binary")
+    {
+        std::cerr << "Error: Unsupported analysis format: " << options_.analysis_format << " (use csv or binary)"
+                  << std::endl;
+        return false;
+    }
+
+    // The whole frame is filtered at unit gain, ROIs are only regions to average over
+    MotionMagConfig config = config_;
+    config.unit_gain = true;
+    EulerianMotionMag* core = new EulerianMotionMag();
+    if (!core->init(config, source_size))
+    {
+        delete core;
+        return false;
+    }
+    if (!setProcessor(core) || !openPyramidCache(true))
+        return false;
+
+    // ROIs are given in source pixels, the bands are at the processing size
+    const cv::Size& size = processing_size_;
+    const cv::Rect frame_rect(0, 0, size.width, size.height);
+    regions_.clear();
+    if (!options_.rois.empty())
+    {
+        const std::vector<cv::Rect>& rois = options_.rois;
+        const double sx = static_cast<double>(size.width) / source_size.width;
+        const double sy = static_cast<double>(size.height) / source_size.height;
+        for (size_t r = 0; r < rois.size(); ++r)
+        {
+            const int x0 = static_cast<int>(floor(rois[r].x * sx));
+            const int y0 = static_cast<int>(floor(rois[r].y * sy));
+            const int x1 = static_cast<int>(ceil(rois[r].br().x * sx));
+            const int y1 = static_cast<int>(ceil(rois[r].br().y * sy));
+            const cv::Rect region = cv::Rect(x0, y0, x1 - x0, y1 - y0) & frame_rect;
+            if (region.area() <= 0)
+            {
+                std::cerr << "Error: ROI (" << rois[r].x << ", " << rois[r].y << ", " << rois[r].width << ", "
+                          << rois[r].height << ") is outside the frame" << std::endl;
+                return false;
+            }
+            regions_.push_back(region);
+        }
+    }
+    else
+    {
+        const int cols = options_.analysis_grid_cols;
+        const int rows = options_.analysis_grid_rows;
+        if (cols < 1 || rows < 1 || cols > size.width || rows > size.height)
+        {
+            std::cerr << "Error: Invalid analysis grid " << cols << "x" << rows << " for a " << size.width << "x"
+                      << size.height << " frame" << std::endl;
+            return false;
+        }
+
+        // Row-major cells, the remainder pixels go to the last row / column
+        for (int gy = 0; gy < rows; ++gy)
+            for (int gx = 0; gx < cols; ++gx)
+            {
+                const int x0 = gx * size.width / cols;
+                const int y0 = gy * size.height / rows;
+                const int x1 = (gx + 1) * size.width / cols;
+                const int y1 = (gy + 1) * size.height / rows;
+                regions_.push_back(cv::Rect(x0, y0, x1 - x0, y1 - y0));
+            }
+    }
+
+    const bool binary = (options_.analysis_format == "binary");
+    out_.open(options_.analysis_file.c_str(), binary ? std::ios::binary : std::ios::out);
+    if (!out_.is_open())
+    {
+        std::cerr << "Error: Unable to create analysis file: " << options_.analysis_file << std::endl;
+        return false;
+    }
+
+    // Header, see the record layout in run_modes.h
+    const int bands = core_->getConfig().levels + 1;
+    channels_ = core_->getConfig().luma_only ? 1 : 3;
+    record_.assign(regions_.size() * bands * channels_, 0.0f);
+    if (binary)
+    {
+        const char magic[8] = "EMMSIG1";
+        const int32_t dims[3] = {static_cast<int32_t>(regions_.size()), bands, channels_};
+        out_.write(magic, sizeof(magic));
+        out_.write(reinterpret_cast<const char*>(dims), sizeof(dims));
+        out_.write(reinterpret_cast<const char*>(&config_.input_fps), sizeof(config_.input_fps));
+    }
+    else
+    {
+        const char* names = (config_.color_space == "yiq") ? "YIQ" : "Lab";
+        out_ << "frame,time_s";
+        for (size_t r = 0; r < regions_.size(); ++r)
+            for (int l = 0; l < bands; ++l)
+                for (int c = 0; c < channels_; ++c)
+                    out_ << ",r" << r << "_l" << l << "_" << names[c];
+        out_ << std::endl;
+    }
+
+    if (!options_.output_file.empty())
+        std::cout << "Analysis mode writes no video, output_filename is ignored" << std::endl;
+    std::cout << "Analysis: " << regions_.size() << " regions x " << bands << " levels x " << channels_
+              << " channels to " << options_.analysis_file << " (" << options_.analysis_format << ")" << std::endl;
+    return true;
+}
+
+void AnalysisRunner::runMode()
+{
+    // Decode (or cache replay), pyramid and temporal filter only. Nothing is
+    // reconstructed, converted back, displayed or encoded.
+    const bool cached = isCacheReplay();
+    Timer clock;
+    for (int f = 0;; ++f)
+    {
+        timer_.start();
+
+        const std::vector<cv::Mat>* pyramid = &core_->getLaplacianPyramid();
+        if (cached)
+        {
+            if (f >= frame_count_)
+                break;
+            readCachedFrame(f, false);  // nothing is reconstructed
+            pyramid = &cached_pyramid_;
+        }
+        else if (!readFrame(img_frame_))
+        {
+            break;
+        }
+
+        beginFrameLog("Analyzing", frame_num_);
+
+        // Every band has unit gain, so decompose() builds all of them
+        core_->setFrameThreads();
+        if (!cached)
+        {
+            core_->decompose(img_frame_);
+            if (isCacheRecording())
+                cache_->append(core_->getLaplacianPyramid());
+        }
+        core_->filterBands(*pyramid);
+        analyzeBands(f == 0);
+        const bool keep_running = writeRecord(f);
+        frame_num_++;
+
+        endFrameLog(frame_num_);
+        if (!keep_running)
+            break;
+    }
+
+    out_.flush();
+    const double seconds = clock.getTimeMicroSec() / 1e6;
+    std::cout << "Analysis: " << frame_num_ << " frames written to " << options_.analysis_file << ", "
+              << ((seconds > 0) ? frame_num_ / seconds : 0) << " fps" << std::endl;
+}
+
+void AnalysisRunner::analyzeBands(bool first_frame)
+{
+    // Mean of each filtered level over each region, the first frame has no signal yet
+    const std::vector<cv::Mat>& filtered = core_->getFilteredPyramid();
+    const int bands = static_cast<int>(filtered.size());
+    for (size_t r = 0; r < regions_.size(); ++r)
+    {
+        const cv::Rect& region = regions_[r];
+        for (int l = 0; l < bands; ++l)
+        {
+            float* values = &record_[(r * bands + l) * channels_];
+            if (first_frame)
+            {
+                std::fill(values, values + channels_, 0.0f);
+                continue;
+            }
+
+            // Region at this level: every pixel that overlaps it, at least one
+            const cv::Mat& band = filtered[l];
+            const int x0 = std::min(region.x >> l, band.cols - 1);
+            const int y0 = std::min(region.y >> l, band.rows - 1);
+            const int x1 = std::max(std::min((region.br().x + (1 << l) - 1) >> l, band.cols), x0 + 1);
+            const int y1 = std::max(std::min((region.br().y + (1 << l) - 1) >> l, band.rows), y0 + 1);
+            // int16 precision bands are fixed-point
+            const double scale = (band.depth() == CV_16S) ? 1.0 / PYR_FIXED_POINT_SCALE : 1.0;
+            const cv::Scalar mean = cv::mean(band(cv::Rect(x0, y0, x1 - x0, y1 - y0)));
+            for (int c = 0; c < channels_; ++c)
+                values[c] = static_cast<float>(mean[c] * scale);
+        }
+    }
+}
+
+bool AnalysisRunner::writeRecord(int frame)
+{
+    EMM_PROFILE_SCOPE(getProfiler(), STAGE_WRITE);
+    if (options_.analysis_format == "binary")
+    {
+        const int32_t index = frame;
+        out_.write(reinterpret_cast<const char*>(&index), sizeof(index));
+        out_.write(reinterpret_cast<const char*>(&record_[0]), record_.size() * sizeof(float));
+    }
+    else
+    {
+        out_ << frame << "," << ((config_.input_fps > 0) ? frame / config_.input_fps : 0);
+        for (size_t i = 0; i < record_.size(); ++i)
+            out_ << "," << record_[i];
+        out_ << "\n";
+    }
+
+    if (!out_.good())
+    {
+        std::cerr << "Error: Unable to write analysis file: " << options_.analysis_file << std::endl;
+        return false;
+    }
+    return true;
+}
+
+Runner* createRunner(const MotionMagConfig& config, const RunOptions& options)
+{
+    const bool sweep = !options.sweep_configs.empty();
+    const bool segments = options.segments > 1;
+    if (options.realtime && (sweep || segments))
+    {
+        std::cerr << "Error: Real-time mode can not be combined with a parameter sweep or segment-parallel processing"
+                  << std::endl;
+        return NULL;
+    }
+
+    // Other modes write frames without outputFrame(), or in a timing dependent order
+    if (!options.reference_file.empty() && (sweep || segments || options.realtime))
+    {
+        std::cerr << "Error: Reference comparison can not be combined with a parameter sweep, segment-parallel"
+                  << " processing or real-time mode" << std::endl;
+        return NULL;
+    }
+
+    if (!options.analysis_file.empty() && (sweep || segments || options.realtime || !options.reference_file.empty()))
+    {
+        std::cerr << "Error: Analysis mode can not be combined with a parameter sweep, segment-parallel processing,"
+                  << " real-time mode or a reference comparison" << std::endl;
+        return NULL;
+    }
+
+    // The sweep children filter bands of the whole frame
+    if (sweep && !options.rois.empty())
+    {
+        std::cerr << "Error: Parameter sweep can not be combined with ROIs" << std::endl;
+        return NULL;
+    }
+
+    if (sweep)
+        return new SweepRunner(config, options);
+    if (!options.analysis_file.empty())
+        return new AnalysisRunner(config, options);
+    if (options.realtime)
+        return new RealtimeRunner(config, options);
+    if (segments)
+        return new SegmentRunner(config, options);
+    if (options.pipelined)
+        return new PipelinedRunner(config, options);
+    return new SerialRunner(config, options);
+}
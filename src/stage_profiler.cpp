@@ -0,0 +1,174 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "stage_profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+StageProfiler::StageProfiler()
+{
+    reset();
+}
+
+void StageProfiler::reset()
+{
+    for (int s = 0; s < NUM_PROFILE_STAGES; ++s)
+    {
+        stats_[s].count = 0;
+        stats_[s].total_ns = 0;
+        stats_[s].max_ns = 0;
+        for (int b = 0; b < kNumBuckets; ++b)
+            stats_[s].buckets[b] = 0;
+    }
+}
+
+int StageProfiler::getBucket(uint64_t ns)
+{
+    if (ns < kSubBuckets)
+        return static_cast<int>(ns);
+
+    // Position of the most significant bit, then the next 4 bits select the sub-bucket
+    int msb = 63 - __builtin_clzll(ns);
+    int shift = msb - 4;
+    return (shift + 1) * kSubBuckets + static_cast<int>((ns >> shift) - kSubBuckets);
+}
+
+double StageProfiler::getBucketValue(int bucket)
+{
+    if (bucket < kSubBuckets)
+        return bucket;
+
+    // Middle of the bucket
+    int shift = bucket / kSubBuckets - 1;
+    int sub = bucket % kSubBuckets + kSubBuckets;
+    return (sub + 0.5) * static_cast<double>(1ULL << shift);
+}
+
+void StageProfiler::record(int stage, uint64_t ns)
+{
+    Stats& stats = stats_[stage];
+    stats.count.fetch_add(1, std::memory_order_relaxed);
+    stats.total_ns.fetch_add(ns, std::memory_order_relaxed);
+    stats.buckets[getBucket(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t curr_max = stats.max_ns.load(std::memory_order_relaxed);
+    while (ns > curr_max && !stats.max_ns.compare_exchange_weak(curr_max, ns, std::memory_order_relaxed))
+    {
+    }
+}
+
+double StageProfiler::getMeanMilliSec(int stage) const
+{
+    uint64_t count = getCount(stage);
+    return count ? stats_[stage].total_ns.load(std::memory_order_relaxed) / 1e6 / count : 0;
+}
+
+double StageProfiler::getMaxMilliSec(int stage) const
+{
+    return stats_[stage].max_ns.load(std::memory_order_relaxed) / 1e6;
+}
+
+double StageProfiler::getPercentileMilliSec(int stage, double percentile) const
+{
+    uint64_t count = getCount(stage);
+    if (count == 0)
+        return 0;
+
+    uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * count + 0.5);
+    rank = std::max<uint64_t>(rank, 1);
+
+    uint64_t seen = 0;
+    for (int b = 0; b < kNumBuckets; ++b)
+    {
+        seen += stats_[stage].buckets[b].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return std::min(getBucketValue(b), static_cast<double>(stats_[stage].max_ns.load())) / 1e6;
+    }
+    return getMaxMilliSec(stage);
+}
+
+const char* StageProfiler::getStageName(int stage)
+{
+    static const char* names[NUM_PROFILE_STAGES] =
+    {
+        "read", "resize", "color_in", "pyramid", "temporal", "amplify", "reconstruct", "attenuate", "color_out", "write"
+    };
+    return names[stage];
+}
+
+void StageProfiler::print(std::ostream& out) const
+{
+    out << std::left << std::setw(12) << "stage" << std::right << std::setw(10) << "count" << std::setw(10) << "mean"
+        << std::setw(10) << "p50" << std::setw(10) << "p95" << std::setw(10) << "p99" << std::setw(10) << "max"
+        << "  (ms)" << std::endl;
+    out << std::fixed << std::setprecision(3);
+    for (int s = 0; s < NUM_PROFILE_STAGES; ++s)
+    {
+        if (getCount(s) == 0)
+            continue;
+        out << std::left << std::setw(12) << getStageName(s) << std::right << std::setw(10) << getCount(s)
+            << std::setw(10) << getMeanMilliSec(s) << std::setw(10) << getPercentileMilliSec(s, 50)
+            << std::setw(10) << getPercentileMilliSec(s, 95) << std::setw(10) << getPercentileMilliSec(s, 99)
+            << std::setw(10) << getMaxMilliSec(s) << std::endl;
+    }
+    out.unsetf(std::ios_base::floatfield);
+}
+
+void StageProfiler::writeJson(std::ostream& out) const
+{
+    out << "{\"stages\": [";
+    bool first = true;
+    for (int s = 0; s < NUM_PROFILE_STAGES; ++s)
+    {
+        if (getCount(s) == 0)
+            continue;
+        out << (first ? "" : ",") << "\n  {\"stage\": \"" << getStageName(s) << "\", \"count\": " << getCount(s)
+            << ", \"mean_ms\": " << getMeanMilliSec(s) << ", \"p50_ms\": " << getPercentileMilliSec(s, 50)
+            << ", \"p95_ms\": " << getPercentileMilliSec(s, 95) << ", \"p99_ms\": " << getPercentileMilliSec(s, 99)
+            << ", \"max_ms\": " << getMaxMilliSec(s) << ", \"total_ms\": " << getMeanMilliSec(s) * getCount(s) << "}";
+        first = false;
+    }
+    out << "\n]}" << std::endl;
+}
+
+void StageProfiler::writeCsv(std::ostream& out) const
+{
+    out << "stage,count,mean_ms,p50_ms,p95_ms,p99_ms,max_ms,total_ms" << std::endl;
+    for (int s = 0; s < NUM_PROFILE_STAGES; ++s)
+    {
+        if (getCount(s) == 0)
+            continue;
+        out << getStageName(s) << "," << getCount(s) << "," << getMeanMilliSec(s) << "," << getPercentileMilliSec(s, 50)
+            << "," << getPercentileMilliSec(s, 95) << "," << getPercentileMilliSec(s, 99) << "," << getMaxMilliSec(s)
+            << "," << getMeanMilliSec(s) * getCount(s) << std::endl;
+    }
+}
+
+bool StageProfiler::save(const std::string& file_name) const
+{
+    std::ofstream file(file_name.c_str());
+    if (!file.is_open())
+    {
+        std::cerr << "Error: Unable to create profile file: " << file_name << std::endl;
+        return false;
+    }
+
+    std::string file_extn = file_name.substr(file_name.find_last_of('.') + 1);
+    if (file_extn == "csv")
+        writeCsv(file);
+    else
+        writeJson(file);
+    return true;
+}
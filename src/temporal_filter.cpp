@@ -0,0 +1,225 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "temporal_filter.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "motion_kernels.h"
+
+void TemporalFilter::applyScaled(const cv::Mat& src, cv::Mat& dst, double gain, const float* channel_scale)
+{
+    apply(src, dst);
+    if (dst.channels() == 1)
+        dst.convertTo(dst, -1, gain * channel_scale[0]);
+    else
+        multiply(dst, cv::Scalar(gain * channel_scale[0], gain * channel_scale[1], gain * channel_scale[2]), dst);
+}
+
+IIRBandpassFilter::IIRBandpassFilter(double cutoff_low, double cutoff_high, const cv::Size& size, int state_type)
+        : cutoff_low_(cutoff_low)
+        , cutoff_high_(cutoff_high)
+        , frame_(0)
+{
+    CV_Assert(CV_MAT_DEPTH(state_type) == CV_32F || CV_MAT_DEPTH(state_type) == CV_16S);
+    lowpass_1_.create(size, state_type);
+    lowpass_2_.create(size, state_type);
+}
+
+void IIRBandpassFilter::init(const cv::Mat& src)
+{
+    // A fixed-point state takes a CV_16S band as is
+    CV_Assert(src.depth() == CV_32F || lowpass_1_.depth() == CV_16S);
+    const double scale = (lowpass_1_.depth() == CV_16S && src.depth() != CV_16S) ? IIR_FIXED_POINT_SCALE : 1.0;
+    src.convertTo(lowpass_1_, lowpass_1_.type(), scale);
+    src.convertTo(lowpass_2_, lowpass_2_.type(), scale);
+    frame_ = 0;
+}
+
+void IIRBandpassFilter::apply(const cv::Mat& src, cv::Mat& dst)
+{
+    if (lowpass_1_.depth() == CV_16S)
+    {
+        const float unit_scale[3] = {1.0f, 1.0f, 1.0f};
+        applyScaled(src, dst, 1.0, unit_scale);
+        return;
+    }
+
+    addWeighted(lowpass_1_, 1 - cutoff_high_, src, cutoff_high_, 0, lowpass_1_);
+    addWeighted(lowpass_2_, 1 - cutoff_low_, src, cutoff_low_, 0, lowpass_2_);
+    subtract(lowpass_1_, lowpass_2_, dst);
+    frame_++;
+}
+
+void IIRBandpassFilter::applyScaled(const cv::Mat& src, cv::Mat& dst, double gain, const float* channel_scale)
+{
+    frame_++;
+    if (lowpass_1_.depth() == CV_16S)
+        fusedTemporalAmplifyFixed(src, lowpass_1_, lowpass_2_, dst, static_cast<float>(cutoff_high_),
+                                  static_cast<float>(cutoff_low_), static_cast<float>(gain), channel_scale, frame_);
+    else
+        fusedTemporalAmplify(src, lowpass_1_, lowpass_2_, dst, static_cast<float>(cutoff_high_),
+                             static_cast<float>(cutoff_low_), static_cast<float>(gain), channel_scale);
+}
+
+SlidingDFTFilter::SlidingDFTFilter(int window, int bin_low, int bin_high)
+        : window_(window)
+        , oldest_(0)
+        , refresh_slot_(0)
+{
+    CV_Assert(window > 1 && bin_low >= 0 && bin_low <= bin_high && bin_high <= window / 2);
+
+    for (int k = bin_low; k <= bin_high; ++k)
+    {
+        const double theta = 2.0 * CV_PI * k / window;
+        bins_.push_back(k);
+        rotate_cos_.push_back(static_cast<float>(cos(theta)));
+        rotate_sin_.push_back(static_cast<float>(sin(theta)));
+        weight_.push_back((k == 0 || 2 * k == window) ? 1.0f / window : 2.0f / window);
+    }
+
+    // e^(-j2pi m/N) for the exact recompute, indexed by (k * m) mod N
+    twiddle_cos_.resize(window);
+    twiddle_sin_.resize(window);
+    for (int m = 0; m < window; ++m)
+    {
+        twiddle_cos_[m] = static_cast<float>(cos(2.0 * CV_PI * m / window));
+        twiddle_sin_[m] = static_cast<float>(-sin(2.0 * CV_PI * m / window));
+    }
+}
+
+bool SlidingDFTFilter::getBandBins(int window, double fps, double freq_low, double freq_high,
+                                   int& bin_low, int& bin_high)
+{
+    if (window < 2 || fps <= 0 || freq_low > freq_high)
+        return false;
+
+    // bin k is at k * fps / N Hz
+    bin_low = std::max(0, static_cast<int>(ceil(freq_low * window / fps)));
+    bin_high = std::min(window / 2, static_cast<int>(floor(freq_high * window / fps)));
+    return bin_low <= bin_high;
+}
+
+size_t SlidingDFTFilter::getStateBytes(const cv::Size& size, int type, int window, int bin_low, int bin_high)
+{
+    const size_t plane = static_cast<size_t>(size.area()) * CV_ELEM_SIZE(type);
+    return plane * (window + 2 * (bin_high - bin_low + 1));
+}
+
+void SlidingDFTFilter::init(const cv::Mat& src)
+{
+    CV_Assert(src.depth() == CV_32F);
+
+    // A window full of the first frame: all bins but DC are zero
+    samples_.resize(window_);
+    for (int i = 0; i < window_; ++i)
+        src.copyTo(samples_[i]);
+
+    bin_re_.resize(bins_.size());
+    bin_im_.resize(bins_.size());
+    for (size_t b = 0; b < bins_.size(); ++b)
+    {
+        if (bins_[b] == 0)
+            bin_re_[b] = src * window_;
+        else
+            bin_re_[b] = cv::Mat::zeros(src.size(), src.type());
+        bin_im_[b] = cv::Mat::zeros(src.size(), src.type());
+    }
+    oldest_ = 0;
+    refresh_slot_ = 0;
+}
+
+void SlidingDFTFilter::apply(const cv::Mat& src, cv::Mat& dst)
+{
+    CV_Assert(!samples_.empty() && src.size() == samples_[0].size() && src.type() == samples_[0].type());
+    dst.create(src.size(), src.type());
+
+    cv::Mat& oldest = samples_[oldest_];
+    const int len = src.cols * src.channels();
+    const int num_bins = static_cast<int>(bins_.size());
+
+    #pragma omp parallel for schedule(static)
+    for (int y = 0; y < src.rows; ++y)
+    {
+        const float* x_new = src.ptr<float>(y);
+        float* x_old = oldest.ptr<float>(y);
+        float* out = dst.ptr<float>(y);
+        std::fill(out, out + len, 0.0f);
+
+        for (int b = 0; b < num_bins; ++b)
+        {
+            float* re = bin_re_[b].ptr<float>(y);
+            float* im = bin_im_[b].ptr<float>(y);
+            const float c = rotate_cos_[b];
+            const float s = rotate_sin_[b];
+            const float w = weight_[b];
+            for (int i = 0; i < len; ++i)
+            {
+                // S_k * e^(-j2pi k/N) is the bin before the rotation, whose real
+                // part is the contribution of bin k to the newest sample
+                const float a = re[i] + x_new[i] - x_old[i];
+                const float d = im[i];
+                out[i] += w * a;
+                re[i] = a * c - d * s;
+                im[i] = a * s + d * c;
+            }
+        }
+
+        // the newest frame takes the slot of the oldest
+        std::copy(x_new, x_new + len, x_old);
+    }
+    oldest_ = (oldest_ + 1) % window_;
+
+    // Exact recompute of a slice of rows, so that every row is refreshed once per window
+    const int row_begin = src.rows * refresh_slot_ / window_;
+    const int row_end = src.rows * (refresh_slot_ + 1) / window_;
+    refreshRows(row_begin, row_end);
+    refresh_slot_ = (refresh_slot_ + 1) % window_;
+}
+
+void SlidingDFTFilter::refreshRows(int row_begin, int row_end)
+{
+    if (row_begin >= row_end)
+        return;
+
+    const int len = samples_[0].cols * samples_[0].channels();
+    const int num_bins = static_cast<int>(bins_.size());
+
+    #pragma omp parallel for schedule(static)
+    for (int y = row_begin; y < row_end; ++y)
+    {
+        for (int b = 0; b < num_bins; ++b)
+        {
+            float* re = bin_re_[b].ptr<float>(y);
+            float* im = bin_im_[b].ptr<float>(y);
+            std::fill(re, re + len, 0.0f);
+            std::fill(im, im + len, 0.0f);
+
+            // S_k = sum over the window (oldest first) of x_m * e^(-j2pi k m/N)
+            for (int m = 0; m < window_; ++m)
+            {
+                const float* x = samples_[(oldest_ + m) % window_].ptr<float>(y);
+                const int t = (bins_[b] * m) % window_;
+                const float c = twiddle_cos_[t];
+                const float s = twiddle_sin_[t];
+                for (int i = 0; i < len; ++i)
+                {
+                    re[i] += x[i] * c;
+                    im[i] += x[i] * s;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,174 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+#include "video_io.h"
+
+#include <iostream>
+
+VideoInput::VideoInput()
+        : capture_(NULL)
+        , stream_(NULL)
+        , size_()
+        , fps_(0)
+        , frame_count_(0)
+        , max_frames_(0)
+        , frames_read_(0)
+        , ended_(false)
+{
+}
+
+VideoInput::~VideoInput()
+{
+    if (capture_ != NULL)
+    {
+        capture_->release();
+        delete capture_;
+    }
+    delete stream_;
+}
+
+bool VideoInput::open(const std::string& file_name, const std::string& format, const cv::Size& raw_size, double fps)
+{
+    bool is_stream = false;
+    FrameStreamFormat stream_format = STREAM_Y4M;
+    if (!getFrameStreamFormat(file_name, format, is_stream, stream_format))
+    {
+        std::cerr << "Error: Unsupported input format: " << format << " (use video, y4m or bgr)" << std::endl;
+        return false;
+    }
+
+    if (is_stream)
+    {
+        // Input Stream (the frame count is not known for stdin):
+        stream_ = new FrameStreamReader();
+        if (!stream_->open(file_name, stream_format, raw_size, fps))
+            return false;
+
+        size_ = stream_->getSize();
+        frame_count_ = stream_->getFrameCount();
+        fps_ = stream_->getFps();
+        return true;
+    }
+
+    // Input File:
+    capture_ = new cv::VideoCapture(file_name);
+    if (!capture_->isOpened())
+    {
+        std::cerr << "Error: Unable to open input video file: " << file_name << std::endl;
+        return false;
+    }
+
+    size_ = cv::Size(capture_->get(CV_CAP_PROP_FRAME_WIDTH), capture_->get(CV_CAP_PROP_FRAME_HEIGHT));
+    frame_count_ = capture_->get(CV_CAP_PROP_FRAME_COUNT);
+    fps_ = capture_->get(CV_CAP_PROP_FPS);
+    return true;
+}
+
+bool VideoInput::seek(int frame)
+{
+    if (stream_ != NULL)
+        return stream_->seek(frame);
+
+    // Warn if the decoder lands elsewhere
+    if (frame > 0)
+    {
+        capture_->set(CV_CAP_PROP_POS_FRAMES, frame);
+        if (static_cast<int>(capture_->get(CV_CAP_PROP_POS_FRAMES)) != frame)
+            std::cerr << "Warning: Seek to frame " << frame << " was not exact" << std::endl;
+    }
+    return true;
+}
+
+bool VideoInput::read(cv::Mat& frame)
+{
+    // max_frames ends the input early, the pass is not complete (ended_ stays false)
+    if (max_frames_ > 0 && frames_read_ >= max_frames_)
+    {
+        frame.release();
+        return false;
+    }
+
+    const bool ok = (stream_ != NULL) ? stream_->read(frame) : capture_->read(frame);
+    if (ok && !frame.empty())
+        frames_read_++;
+    else
+        ended_ = true;
+    return ok && !frame.empty();
+}
+
+VideoOutput::VideoOutput()
+        : writer_(NULL)
+        , stream_(NULL)
+{
+}
+
+VideoOutput::~VideoOutput()
+{
+    if (writer_ != NULL)
+    {
+        writer_->release();
+        delete writer_;
+    }
+    delete stream_;
+}
+
+bool VideoOutput::open(const std::string& file_name, const std::string& format, const cv::Size& size, double fps)
+{
+    bool is_stream = false;
+    FrameStreamFormat stream_format = STREAM_Y4M;
+    if (!getFrameStreamFormat(file_name, format, is_stream, stream_format))
+    {
+        std::cerr << "Error: Unsupported output format: " << format << " (use video, y4m or bgr)" << std::endl;
+        return false;
+    }
+
+    if (is_stream)
+    {
+        stream_ = new FrameStreamWriter();
+        return stream_->open(file_name, stream_format, size, fps);
+    }
+
+    writer_ = new cv::VideoWriter(file_name,                   // filename
+                                  getCodecNumber(file_name),   // codec to be used
+                                  fps,                         // frame rate of the video
+                                  size,                        // frame size
+                                  true                         // color video
+    );  // NOLINT [whitespace/braces]
+    if (!writer_->isOpened())
+    {
+        std::cerr << "Error: Unable to create output video file: " << file_name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool VideoOutput::write(const cv::Mat& frame)
+{
+    if (stream_ != NULL)
+        return stream_->write(frame);
+    writer_->write(frame);
+    return true;
+}
+
+int VideoOutput::getCodecNumber(const std::string& file_name)
+{
+    std::string file_extn = file_name.substr(file_name.find_last_of('.') + 1);
+
+    // Currently supported video formats are AVI and MPEG-4
+    if (file_extn == "avi")
+        return CV_FOURCC('M', 'J', 'P', 'G');
+    else if (file_extn == "mp4")
+        return CV_FOURCC('D', 'I', 'V', 'X');
+    else
+        return -1;
+}
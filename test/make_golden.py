@@ -0,0 +1,198 @@
+#!/usr/bin/env python3
+#******************************************************************************
+# Copyright 2016 Ramsundar K G. All Rights Reserved.
+#
+# This source code is licensed as defined by the LICENSE file found in the
+# root directory of this source tree.
+#
+# Author: Ramsundar K G (kgram007@gmail.com)
+#
+# This file is a part of C++ implementation of Eulerian Motion Magnification
+# adapted from https://github.com/wzpan/QtEVM
+#
+#******************************************************************************
+
+# Golden outputs for the test/golden_*.param runs (make test).
+#
+# An independent model of the default pipeline (OpenCV pyramid, separate IIR
+# filter / amplify / attenuate, cvtColor Lab) in float32 numpy and OpenCV's
+# Python bindings. Each param file is read for its input (synthetic, raw .bgr or
+# a video), sizes and gains, and the output frames are written to its
+# reference_file as raw BGR. Kernel options
+# (fast_pyramid, fused_kernel, ...) are not modelled: every code path is checked
+# against the same reference. Needs numpy and the OpenCV bindings:
+#
+#   pip install numpy opencv-python-headless
+#
+# Run from the repository root:
+#
+#   python3 test/make_golden.py test/golden_synthetic.param test/golden_baby.param
+
+import math
+import sys
+
+import cv2
+import numpy as np
+
+
+def read_params(path):
+    params = {}
+    with open(path) as f:
+        for line in f:
+            line = line.split('#', 1)[0].strip()
+            if '=' in line:
+                key, value = line.split('=', 1)
+                params[key.strip()] = value.strip()
+    return params
+
+
+def synthetic_frames(spec, width, height, fps):
+    # Same texture and disc as FrameStreamReader::renderSynthetic(), in double
+    # precision and rounded once
+    fields = spec.split(':')[1:]
+    freq = float(fields[0]) if len(fields) > 0 else 1.0
+    amplitude = float(fields[1]) if len(fields) > 1 else 1.0
+    count = int(fields[2]) if len(fields) > 2 else 300
+    y, x = np.mgrid[0:height, 0:width].astype(np.float64)
+    texture = (112 + 40 * np.sin(2 * math.pi * x / 64) * np.sin(2 * math.pi * y / 48) +
+               16 * np.sin(2 * math.pi * (x + y) / 13))
+    disc = (70, 110, 200)
+    tint = (0.9, 1.0, 1.1)
+    for f in range(count):
+        radius = 0.25 * min(width, height) + amplitude * math.sin(2 * math.pi * freq * (f / fps))
+        d = np.sqrt((x - 0.5 * width) ** 2 + (y - 0.5 * height) ** 2) - radius
+        cover = np.clip(0.5 - d / 2, 0, 1)
+        frame = np.empty((height, width, 3), np.uint8)
+        for c in range(3):
+            frame[..., c] = np.floor(texture * tint[c] + cover * (disc[c] - texture * tint[c]) + 0.5)
+        yield frame
+
+
+def raw_frames(path, width, height):
+    # Headerless BGR frames, as FrameStreamReader reads a .bgr file
+    frame_bytes = width * height * 3
+    with open(path, 'rb') as f:
+        while True:
+            data = f.read(frame_bytes)
+            if len(data) < frame_bytes:
+                return
+            yield np.frombuffer(data, np.uint8).reshape(height, width, 3)
+
+
+def video_frames(path):
+    capture = cv2.VideoCapture(path)
+    if not capture.isOpened():
+        sys.exit('Unable to open ' + path)
+    while True:
+        ok, frame = capture.read()
+        if not ok:
+            return
+        yield frame
+
+
+def level_gains(width, height, levels, alpha, lambda_c):
+    # EulerianMotionMag::buildBandPlan(), lambda_ starts as a float
+    delta = lambda_c / 8.0 / (1.0 + alpha)
+    wavelength = float(np.float32(np.sqrt(np.float32(width * width + height * height))) / np.float32(3))
+    gains = [0.0] * (levels + 1)
+    for level in range(levels, -1, -1):
+        if level != levels and level != 0:
+            gains[level] = min(alpha, (wavelength / delta / 8 - 1) * 2.0)
+        wavelength /= 2.0
+    return gains
+
+
+def laplacian_pyramid(img, levels):
+    pyramid = []
+    for _ in range(levels):
+        down = cv2.pyrDown(img)
+        pyramid.append(img - cv2.pyrUp(down, dstsize=(img.shape[1], img.shape[0])))
+        img = down
+    pyramid.append(img)
+    return pyramid
+
+
+def collapse(pyramid, top):
+    img = pyramid[top]
+    for level in range(top - 1, -1, -1):
+        img = cv2.pyrUp(img, dstsize=(pyramid[level].shape[1], pyramid[level].shape[0])) + pyramid[level]
+    return img
+
+
+def to_lab(bgr):
+    return cv2.cvtColor(bgr.astype(np.float32) * np.float32(1.0 / 255.0), cv2.COLOR_BGR2Lab)
+
+
+def to_bgr8(lab):
+    # convertTo(CV_8UC3, 255.0, 1.0 / 255.0)
+    bgr = cv2.cvtColor(lab, cv2.COLOR_Lab2BGR) * np.float32(255.0) + np.float32(1.0 / 255.0)
+    return np.clip(np.rint(bgr), 0, 255).astype(np.uint8)
+
+
+def magnify(params):
+    source = params.get('input_filename', '')
+    fps = float(params.get('input_fps', 30))
+    if source.startswith('synthetic'):
+        frames = synthetic_frames(source, int(params.get('raw_width', 640)), int(params.get('raw_height', 480)), fps)
+    elif source.endswith('.bgr') or params.get('input_format') == 'bgr':
+        frames = raw_frames(source, int(params['raw_width']), int(params['raw_height']))
+    else:
+        frames = video_frames(source)
+
+    levels = int(params.get('levels', 5))
+    alpha = float(params.get('alpha', 20))
+    low = np.float32(float(params.get('cutoff_freq_low', 0.05)))
+    high = np.float32(float(params.get('cutoff_freq_high', 0.4)))
+    chrom = float(params.get('chrom_attenuation', 0.1))
+    max_frames = int(params.get('max_frames', 0))
+    one = np.float32(1)
+
+    lowpass_1 = lowpass_2 = gains = None
+    size = output_size = None
+    for n, frame in enumerate(frames):
+        if max_frames > 0 and n >= max_frames:
+            return
+        if size is None:
+            size = (int(params.get('input_width', 0)) or frame.shape[1],
+                    int(params.get('input_height', 0)) or frame.shape[0])
+            output_size = (int(params.get('output_width', 0)) or size[0],
+                           int(params.get('output_height', 0)) or size[1])
+            gains = level_gains(size[0], size[1], levels, alpha, float(params.get('lambda_c', 16)))
+
+        lab = to_lab(cv2.resize(frame, size))
+        pyramid = laplacian_pyramid(lab, levels)
+        if n == 0:
+            lowpass_1 = [p.copy() for p in pyramid]
+            lowpass_2 = [p.copy() for p in pyramid]
+            output = lab
+        else:
+            filtered = []
+            for level in range(levels + 1):
+                lowpass_1[level] = (one - high) * lowpass_1[level] + high * pyramid[level]
+                lowpass_2[level] = (one - low) * lowpass_2[level] + low * pyramid[level]
+                filtered.append((lowpass_1[level] - lowpass_2[level]) * np.float32(gains[level]))
+            active = [level for level in range(levels + 1) if gains[level] != 0]
+            if active:
+                motion = collapse(filtered, max(active)) * np.array([1, chrom, chrom], np.float32)
+                output = lab + motion
+            else:
+                output = lab
+        yield cv2.resize(to_bgr8(output), output_size)
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit('usage: make_golden.py <param_file> ...')
+    for path in sys.argv[1:]:
+        params = read_params(path)
+        golden = params['reference_file']
+        count = 0
+        with open(golden, 'wb') as out:
+            for frame in magnify(params):
+                out.write(np.ascontiguousarray(frame).tobytes())
+                count += 1
+        print('%s: %d frames to %s' % (path, count, golden))
+
+
+if __name__ == '__main__':
+    main()
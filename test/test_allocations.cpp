@@ -0,0 +1,159 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// Heap allocations of process() after warm-up, counted by replacing the global
+// operator new. cv::Mat::create() allocates through it, so any workspace that
+// is not reused shows up here.
+// OpenCV's own pyrDown / pyrUp, cvtColor and resize (between different sizes)
+// allocate scratch buffers inside each call, so the count covers the repo's
+// kernels only: fast pyramid, fused temporal kernel and fused color. On the
+// default (OpenCV) path every workspace buffer has to keep its storage instead.
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "eulerian_motion_mag.h"
+#include "frame_stream.h"
+#include "test_util.h"
+
+namespace
+{
+
+std::atomic<bool> g_counting(false);
+std::atomic<long> g_allocations(0);
+
+}  // namespace
+
+void* operator new(size_t size)
+{
+    if (g_counting)
+        g_allocations++;
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+namespace
+{
+
+const int kWarmupFrames = 3;
+
+void checkSteadyState(const std::vector<cv::Mat>& frames, bool direct, const std::string& precision,
+                      const std::string& color_space)
+{
+    MotionMagConfig config;
+    config.levels = 4;
+    config.fast_pyramid = true;
+    config.fused_kernel = true;
+    config.fused_color = true;
+    config.direct_output = direct;
+    config.precision = precision;
+    config.color_space = color_space;
+    EulerianMotionMag motion_mag;
+    CHECK(motion_mag.init(config, frames[0].size()));
+
+    cv::Mat output;
+    for (int f = 0; f < kWarmupFrames; ++f)
+        motion_mag.process(frames[f], output);
+
+    g_allocations = 0;
+    g_counting = true;
+    for (size_t f = kWarmupFrames; f < frames.size(); ++f)
+        motion_mag.process(frames[f], output);
+    g_counting = false;
+
+    if (!CHECK_LE(g_allocations.load(), 0))
+        std::cerr << "  direct output " << direct << ", " << precision << ", " << color_space << std::endl;
+}
+
+// Storage of every buffer process() writes into, and of the output
+void getBuffers(const EulerianMotionMag& motion_mag, const cv::Mat& output, std::vector<const uchar*>& buffers)
+{
+    buffers.clear();
+    buffers.push_back(motion_mag.getInputImage().data);
+    buffers.push_back(motion_mag.getMotionImage().data);
+    buffers.push_back(output.data);
+    const std::vector<cv::Mat>* levels[4] = {&motion_mag.getLaplacianPyramid(), &motion_mag.getFilteredPyramid(),
+                                             &motion_mag.getLowpassState1(), &motion_mag.getLowpassState2()};
+    for (int i = 0; i < 4; ++i)
+        for (size_t l = 0; l < levels[i]->size(); ++l)
+            buffers.push_back((*levels[i])[l].data);
+}
+
+void checkWorkspaceReuse(const std::vector<cv::Mat>& frames, bool direct)
+{
+    MotionMagConfig config;
+    config.levels = 4;
+    config.direct_output = direct;
+    EulerianMotionMag motion_mag;
+    CHECK(motion_mag.init(config, frames[0].size()));
+
+    cv::Mat output;
+    for (int f = 0; f < kWarmupFrames; ++f)
+        motion_mag.process(frames[f], output);
+
+    std::vector<const uchar*> warm, steady;
+    getBuffers(motion_mag, output, warm);
+    for (size_t f = kWarmupFrames; f < frames.size(); ++f)
+    {
+        motion_mag.process(frames[f], output);
+        getBuffers(motion_mag, output, steady);
+        if (!CHECK(steady == warm))
+        {
+            std::cerr << "  default path, direct output " << direct << ", frame " << f << std::endl;
+            break;
+        }
+    }
+}
+
+}  // namespace
+
+int main()
+{
+    // Decode up front, the reader allocates its frames
+    FrameStreamReader reader;
+    CHECK(reader.open("synthetic:2:2:16", STREAM_SYNTHETIC, cv::Size(160, 120), 30));
+    std::vector<cv::Mat> frames;
+    cv::Mat frame;
+    while (reader.read(frame))
+        frames.push_back(frame.clone());
+
+    for (int direct = 0; direct < 2; ++direct)
+    {
+        checkSteadyState(frames, direct == 1, "float", "lab");
+        checkSteadyState(frames, direct == 1, "int16", "lab");
+        checkSteadyState(frames, direct == 1, "float", "yiq");
+        checkWorkspaceReuse(frames, direct == 1);
+    }
+
+    return test::testResult("test_allocations");
+}
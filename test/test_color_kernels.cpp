@@ -0,0 +1,113 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// Fused Lab kernels against convertTo + cvtColor over every 8-bit color (a
+// 4096x4096 image of the whole BGR cube). The bounds are the ones measured
+// against OpenCV 5.0 with some headroom, see color_kernels.h.
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "color_kernels.h"
+#include "test_util.h"
+
+namespace
+{
+
+// Pixel i is (b, g, r) = (i & 255, (i >> 8) & 255, i >> 16)
+void makeColorCube(cv::Mat& cube)
+{
+    cube.create(cv::Size(4096, 4096), CV_8UC3);
+    for (int y = 0; y < cube.rows; ++y)
+    {
+        unsigned char* row = cube.ptr<unsigned char>(y);
+        for (int x = 0; x < cube.cols; ++x)
+        {
+            const int i = y * cube.cols + x;
+            row[3 * x] = static_cast<unsigned char>(i & 255);
+            row[3 * x + 1] = static_cast<unsigned char>((i >> 8) & 255);
+            row[3 * x + 2] = static_cast<unsigned char>(i >> 16);
+        }
+    }
+}
+
+// Largest difference of every channel
+void maxChannelDiff(const cv::Mat& a, const cv::Mat& b, double error[3])
+{
+    cv::Mat diff;
+    cv::absdiff(a, b, diff);
+    for (int c = 0; c < 3; ++c)
+    {
+        cv::Mat channel;
+        cv::extractChannel(diff, channel, c);
+        cv::minMaxLoc(channel, NULL, &error[c]);
+    }
+}
+
+// Fraction of the values of two 8-bit images that differ
+double differingFraction(const cv::Mat& a, const cv::Mat& b)
+{
+    cv::Mat diff;
+    cv::absdiff(a, b, diff);
+    return static_cast<double>(cv::countNonZero(diff.reshape(1))) / (a.total() * a.channels());
+}
+
+}  // namespace
+
+int main()
+{
+    cv::Mat cube;
+    makeColorCube(cube);
+
+    // BGR to Lab
+    cv::Mat reference_lab;
+    cv::Mat lab;
+    cube.convertTo(reference_lab, CV_32FC3, 1.0 / 255.0);
+    cv::cvtColor(reference_lab, reference_lab, CV_BGR2Lab);
+    convertBGR8ToLab(cube, lab);
+    double lab_error[3];
+    maxChannelDiff(lab, reference_lab, lab_error);
+    std::cout << "BGR8 to Lab max error: L " << lab_error[0] << ", a " << lab_error[1] << ", b " << lab_error[2]
+              << std::endl;
+    CHECK_LE(lab_error[0], 0.25);
+    CHECK_LE(lab_error[1], 0.6);
+    CHECK_LE(lab_error[2], 0.45);
+
+    // Every color makes it back unchanged
+    cv::Mat round_trip;
+    convertLabToBGR8(lab, round_trip);
+    CHECK(test::maxDiff(round_trip, cube) == 0);
+
+    // Lab to BGR on cvtColor's Lab, in gamut and pushed around as amplified motion does
+    cv::Mat noise(reference_lab.size(), CV_32FC3);
+    cv::RNG rng(1);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar::all(-8), cv::Scalar::all(8));
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        if (pass == 1)
+            reference_lab += noise;
+
+        cv::Mat reference_bgr;
+        cv::Mat bgr;
+        cv::cvtColor(reference_lab, reference_bgr, CV_Lab2BGR);
+        reference_bgr.convertTo(reference_bgr, CV_8UC3, 255.0);
+        convertLabToBGR8(reference_lab, bgr);
+
+        const double fraction = differingFraction(bgr, reference_bgr);
+        std::cout << "Lab to BGR8" << (pass == 1 ? " (+-8)" : "") << ": max error " << test::maxDiff(bgr, reference_bgr)
+                  << ", " << 100 * fraction << "% of the values differ" << std::endl;
+        CHECK_LE(test::maxDiff(bgr, reference_bgr), 1);
+        CHECK_LE(fraction, 0.01);
+    }
+
+    return test::testResult("test_color_kernels");
+}
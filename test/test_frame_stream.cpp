@@ -0,0 +1,185 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// FrameStreamWriter / FrameStreamReader round trips through raw BGR and Y4M
+// files and through a named pipe, which has to be read through without
+// counting or seeking, and the Y4M colorspaces that are accepted.
+
+#include "frame_stream.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "test_util.h"
+
+namespace
+{
+
+const int kFrames = 5;
+const cv::Size kSize(48, 36);
+const double kFps = 25;
+
+std::vector<cv::Mat> makeFrames()
+{
+    cv::RNG rng(16);
+    std::vector<cv::Mat> frames(kFrames);
+    for (int f = 0; f < kFrames; ++f)
+    {
+        frames[f].create(kSize, CV_8UC3);
+        rng.fill(frames[f], cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+    }
+    return frames;
+}
+
+// What a frame looks like after the trip through Y4M: I420 subsampling
+cv::Mat throughI420(const cv::Mat& frame)
+{
+    cv::Mat planar, bgr;
+    cv::cvtColor(frame, planar, CV_BGR2YUV_I420);
+    cv::cvtColor(planar, bgr, CV_YUV2BGR_I420);
+    return bgr;
+}
+
+bool writeFrames(const std::string& path, FrameStreamFormat format, const std::vector<cv::Mat>& frames)
+{
+    FrameStreamWriter writer;
+    if (!writer.open(path, format, kSize, kFps))
+        return false;
+    bool ok = true;
+    for (size_t f = 0; f < frames.size(); ++f)
+        ok &= writer.write(frames[f]);
+    writer.close();
+    return ok;
+}
+
+void checkFile(const std::string& path, FrameStreamFormat format)
+{
+    const std::vector<cv::Mat> frames = makeFrames();
+    std::vector<cv::Mat> expected(kFrames);
+    for (int f = 0; f < kFrames; ++f)
+        expected[f] = (format == STREAM_Y4M) ? throughI420(frames[f]) : frames[f];
+
+    if (!CHECK(writeFrames(path, format, frames)))
+        return;
+
+    // Raw BGR needs size and rate, Y4M takes them from the header
+    FrameStreamReader reader;
+    const bool raw = (format == STREAM_BGR);
+    if (!CHECK(reader.open(path, format, raw ? kSize : cv::Size(), raw ? kFps : 0)))
+        return;
+    CHECK(reader.getSize() == kSize);
+    CHECK(reader.getFps() == kFps);
+    CHECK(reader.getFrameCount() == kFrames);
+
+    cv::Mat frame;
+    for (int f = 0; f < kFrames; ++f)
+        if (CHECK(reader.read(frame)))
+            CHECK(test::maxDiff(frame, expected[f]) == 0);
+    CHECK(!reader.read(frame) && frame.empty());
+
+    // Backwards and forwards, and one past the end
+    const int order[] = {3, 0, 4, 1};
+    for (int i = 0; i < 4; ++i)
+        if (CHECK(reader.seek(order[i])) && CHECK(reader.read(frame)))
+            CHECK(test::maxDiff(frame, expected[order[i]]) == 0);
+    CHECK(reader.seek(kFrames) && !reader.read(frame));
+    CHECK(!reader.seek(kFrames + 1));
+    reader.close();
+}
+
+void checkPipe(const std::string& path)
+{
+    const std::vector<cv::Mat> frames = makeFrames();
+    if (!CHECK(mkfifo(path.c_str(), 0600) == 0))
+        return;
+
+    // Opening a pipe blocks until both ends are open
+    bool written = false;
+    std::thread writer([&]() { written = writeFrames(path, STREAM_Y4M, frames); });
+
+    FrameStreamReader reader;
+    if (CHECK(reader.open(path, STREAM_Y4M, cv::Size(), 0)))
+    {
+        CHECK(reader.getSize() == kSize);
+        CHECK(reader.getFrameCount() == 0);
+        CHECK(!reader.seek(0));
+
+        cv::Mat frame;
+        int count = 0;
+        while (reader.read(frame))
+        {
+            if (count < kFrames)
+                CHECK(test::maxDiff(frame, throughI420(frames[count])) == 0);
+            count++;
+        }
+        CHECK(count == kFrames);
+    }
+    reader.close();
+    writer.join();
+    CHECK(written);
+    unlink(path.c_str());
+}
+
+bool openHeader(const std::string& path, const char* header)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL)
+        return false;
+    fputs(header, file);
+    fclose(file);
+
+    FrameStreamReader reader;
+    return reader.open(path, STREAM_Y4M, cv::Size(), 0);
+}
+
+void checkColorspaces(const std::string& path)
+{
+    CHECK(openHeader(path, "YUV4MPEG2 W48 H36 F25:1\n"));
+    CHECK(openHeader(path, "YUV4MPEG2 W48 H36 F25:1 C420\n"));
+    CHECK(openHeader(path, "YUV4MPEG2 W48 H36 F25:1 C420jpeg\n"));
+    CHECK(openHeader(path, "YUV4MPEG2 W48 H36 F25:1 C420mpeg2\n"));
+    CHECK(openHeader(path, "YUV4MPEG2 W48 H36 F25:1 C420paldv\n"));
+    CHECK(!openHeader(path, "YUV4MPEG2 W48 H36 F25:1 C420p10\n"));
+    CHECK(!openHeader(path, "YUV4MPEG2 W48 H36 F25:1 C420p12\n"));
+    CHECK(!openHeader(path, "YUV4MPEG2 W48 H36 F25:1 C422\n"));
+    CHECK(!openHeader(path, "YUV4MPEG2 W47 H36 F25:1 C420jpeg\n"));
+    unlink(path.c_str());
+}
+
+}  // namespace
+
+int main()
+{
+    char dir[] = "/tmp/test_frame_stream.XXXXXX";
+    if (!CHECK(mkdtemp(dir) != NULL))
+        return test::testResult("test_frame_stream");
+    const std::string base(dir);
+
+    checkFile(base + "/clip.bgr", STREAM_BGR);
+    checkFile(base + "/clip.y4m", STREAM_Y4M);
+    checkPipe(base + "/pipe.y4m");
+    checkColorspaces(base + "/header.y4m");
+
+    unlink((base + "/clip.bgr").c_str());
+    unlink((base + "/clip.y4m").c_str());
+    rmdir(dir);
+    return test::testResult("test_frame_stream");
+}
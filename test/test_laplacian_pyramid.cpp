@@ -0,0 +1,223 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// LaplacianPyramidEngine against cv::pyrDown / cv::pyrUp on odd and even sizes,
+// including the degenerate 1 and 2 pixel sides where the borders meet, the
+// whole-pyramid kernels against the single level ones, and CV_16S fixed-point
+// levels against the float ones.
+
+#include "laplacian_pyramid.h"
+
+#include <math.h>
+
+#include <vector>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "test_util.h"
+
+namespace
+{
+
+// Values are in [-50, 50]: float rounding stays far below this
+const double kTolerance = 1e-3;
+
+void checkSize(int width, int height, int cn)
+{
+    const int type = CV_MAKETYPE(CV_32F, cn);
+    const cv::Size size(width, height);
+    const cv::Size coarse_size((width + 1) / 2, (height + 1) / 2);
+    cv::RNG rng(width * 1000 + height * 10 + cn);
+    cv::Mat src(size, type);
+    cv::Mat coarse(coarse_size, type);
+    rng.fill(src, cv::RNG::UNIFORM, cv::Scalar::all(-50), cv::Scalar::all(50));
+    rng.fill(coarse, cv::RNG::UNIFORM, cv::Scalar::all(-50), cv::Scalar::all(50));
+
+    cv::Mat ref_down, ref_up, ref_lap, ref_collapse;
+    cv::pyrDown(src, ref_down);
+    cv::pyrUp(ref_down, ref_up, size);
+    cv::subtract(src, ref_up, ref_lap);
+    cv::pyrUp(coarse, ref_up, size);
+    cv::add(ref_up, ref_lap, ref_collapse);
+
+    LaplacianPyramidEngine engine;
+    cv::Mat down, lap, down_only, up, collapse;
+    engine.buildLevel(src, down, lap);
+    engine.downLevel(src, down_only);
+    engine.upLevel(coarse, size, up);
+    engine.collapseLevel(coarse, ref_lap, collapse);
+
+    bool ok = true;
+    ok &= CHECK(down.size() == ref_down.size() && lap.size() == size && up.size() == size);
+    ok &= CHECK_LE(test::maxDiff(down, ref_down), kTolerance);
+    ok &= CHECK_LE(test::maxDiff(down_only, ref_down), kTolerance);
+    ok &= CHECK_LE(test::maxDiff(lap, ref_lap), kTolerance);
+    ok &= CHECK_LE(test::maxDiff(up, ref_up), kTolerance);
+    ok &= CHECK_LE(test::maxDiff(collapse, ref_collapse), kTolerance);
+    if (!ok)
+        std::cerr << "  " << width << "x" << height << ", " << cn << " channel(s)" << std::endl;
+}
+
+// pyrUp filters the zero-stuffed image at twice the coarse width and crops,
+// the last column of an odd width is 8 / 64 of the last coarse sample
+void checkOddBorder()
+{
+    float values[5] = {0, 0, 0, 0, 64};
+    const cv::Mat coarse(1, 5, CV_32FC1, values);
+    LaplacianPyramidEngine engine;
+    cv::Mat up;
+    engine.upLevel(coarse, cv::Size(9, 1), up);
+    CHECK_LE(fabs(up.at<float>(0, 8) - 56.0f), 1e-4);
+    CHECK_LE(fabs(up.at<float>(0, 7) - 32.0f), 1e-4);
+}
+
+// buildPyramid / collapsePyramid run the same row kernels as the single level
+// calls, for every level count the results match exactly, with and without a
+// band mask
+void checkPyramid(int width, int height, int cn, int levels, bool masked)
+{
+    const int type = CV_MAKETYPE(CV_32F, cn);
+    cv::RNG rng(width * 1000 + levels * 10 + cn);
+    cv::Mat src(height, width, type);
+    rng.fill(src, cv::RNG::UNIFORM, cv::Scalar::all(-50), cv::Scalar::all(50));
+
+    // Top band and level 0 off, like a band plan with zero gain there
+    std::vector<bool> bands(levels + 1, true);
+    bands[levels] = false;
+    bands[0] = false;
+    const std::vector<bool>* mask = masked ? &bands : NULL;
+    const int top = masked ? levels - 1 : levels;
+
+    LaplacianPyramidEngine engine;
+    engine.init(width, cn);
+    std::vector<cv::Mat> ref_down(levels), ref_pyramid(levels + 1);
+    std::vector<cv::Size> sizes(levels + 1);
+    const cv::Mat* current = &src;
+    for (int l = 0; l <= levels; ++l)
+    {
+        sizes[l] = current->size();
+        if (l == levels)
+            break;
+        if (mask == NULL || bands[l])
+            engine.buildLevel(*current, ref_down[l], ref_pyramid[l]);
+        else
+            engine.downLevel(*current, ref_down[l]);
+        current = &ref_down[l];
+    }
+    if (!masked)
+        current->copyTo(ref_pyramid[levels]);
+
+    std::vector<cv::Mat> down, pyramid;
+    engine.buildPyramid(src, levels, mask, down, pyramid);
+
+    // Collapse from the unmasked pyramid, the top level is the lowpass or the
+    // coarsest residual
+    std::vector<cv::Mat> full_down, full;
+    engine.buildPyramid(src, levels, NULL, full_down, full);
+    cv::Mat ref_collapse;
+    std::vector<cv::Mat> ref_up(levels);
+    current = &full[top];
+    for (int l = top - 1; l >= 0; --l)
+    {
+        cv::Mat& dst = (l > 0) ? ref_up[l] : ref_collapse;
+        if (mask == NULL || bands[l])
+            engine.collapseLevel(*current, full[l], dst);
+        else
+            engine.upLevel(*current, sizes[l], dst);
+        current = &dst;
+    }
+    if (top == 0)
+        full[0].copyTo(ref_collapse);
+    std::vector<cv::Mat> up;
+    cv::Mat collapse;
+    engine.collapsePyramid(full, sizes, top, 0, mask, up, collapse);
+
+    bool ok = true;
+    ok &= CHECK(pyramid.size() == static_cast<size_t>(levels + 1));
+    for (int l = 0; l <= levels; ++l)
+        if (!ref_pyramid[l].empty())
+            ok &= CHECK(test::maxDiff(pyramid[l], ref_pyramid[l]) == 0);
+    ok &= CHECK(test::maxDiff(collapse, ref_collapse) == 0);
+    if (!masked)
+        ok &= CHECK_LE(test::maxDiff(collapse, src), kTolerance);
+    if (!ok)
+        std::cerr << "  " << width << "x" << height << ", " << cn << " channel(s), " << levels << " levels"
+                  << (masked ? ", masked" : "") << std::endl;
+}
+
+// CV_16S levels are the float ones rounded to Q8.7, and collapse within the
+// rounding error of one step per level
+void checkFixedPoint(int width, int height, int cn, int levels)
+{
+    const int type = CV_MAKETYPE(CV_32F, cn);
+    cv::RNG rng(width * 1000 + levels * 10 + cn);
+    cv::Mat src(height, width, type);
+    rng.fill(src, cv::RNG::UNIFORM, cv::Scalar::all(-50), cv::Scalar::all(50));
+
+    LaplacianPyramidEngine engine;
+    std::vector<cv::Mat> down, pyramid, fixed_down, fixed;
+    engine.buildPyramid(src, levels, NULL, down, pyramid);
+    engine.buildPyramid(src, levels, NULL, fixed_down, fixed, CV_16S);
+
+    bool ok = true;
+    std::vector<cv::Size> sizes(levels + 1);
+    cv::Mat quantized;
+    for (int l = 0; l <= levels; ++l)
+    {
+        sizes[l] = pyramid[l].size();
+        pyramid[l].convertTo(quantized, CV_MAKETYPE(CV_16S, cn), PYR_FIXED_POINT_SCALE);
+        ok &= CHECK(fixed[l].type() == CV_MAKETYPE(CV_16S, cn));
+        ok &= CHECK_LE(test::maxDiff(fixed[l], quantized), 1);  // ties may round either way
+    }
+
+    std::vector<cv::Mat> up;
+    cv::Mat collapse, fixed_collapse;
+    engine.collapsePyramid(pyramid, sizes, levels, 0, NULL, up, collapse);
+    engine.collapsePyramid(fixed, sizes, levels, 0, NULL, up, fixed_collapse);
+    ok &= CHECK(fixed_collapse.type() == type);
+    ok &= CHECK_LE(test::maxDiff(fixed_collapse, collapse), (levels + 1.0) / PYR_FIXED_POINT_SCALE);
+    if (!ok)
+        std::cerr << "  fixed point " << width << "x" << height << ", " << cn << " channel(s), " << levels
+                  << " levels" << std::endl;
+}
+
+}  // namespace
+
+int main()
+{
+    const int sides[] = {1, 2, 3, 4, 5, 8, 9, 16, 17, 33, 64, 99};
+    const int num_sides = sizeof(sides) / sizeof(sides[0]);
+    for (int w = 0; w < num_sides; ++w)
+        for (int h = 0; h < num_sides; h += 2)
+            for (int cn = 1; cn <= 3; ++cn)
+                checkSize(sides[w], sides[h], cn);
+    checkSize(640, 480, 3);
+    checkSize(161, 121, 1);
+
+    checkOddBorder();
+
+    for (int levels = 1; levels <= 9; ++levels)
+        for (int cn = 1; cn <= 3; ++cn)
+        {
+            checkPyramid(161, 121, cn, levels, false);
+            checkPyramid(161, 121, cn, levels, true);
+        }
+
+    for (int levels = 1; levels <= 6; ++levels)
+    {
+        checkFixedPoint(161, 121, 3, levels);
+        checkFixedPoint(96, 72, 1, levels);
+    }
+
+    return test::testResult("test_laplacian_pyramid");
+}
@@ -0,0 +1,172 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// fusedTemporalAmplify() against the unfused stages it replaces
+// (temporalIIRFilter + amplify + attenuate), on widths that leave a scalar tail
+// after the SSE blocks and on non-continuous rows, and fusedTemporalAmplifyFixed()
+// on one and on several threads.
+
+#include <omp.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "eulerian_motion_mag.h"
+#include "frame_stream.h"
+#include "test_util.h"
+
+namespace
+{
+
+const float kCutoffHigh = 0.4f;
+const float kCutoffLow = 0.05f;
+const float kGain = 10.0f;
+const float kChrom = 0.1f;
+
+// Same operations as EulerianMotionMag::temporalIIRFilter(), amplify() and attenuate()
+void referenceStep(const cv::Mat& src, cv::Mat& lowpass_1, cv::Mat& lowpass_2, cv::Mat& dst)
+{
+    cv::addWeighted(lowpass_1, 1 - kCutoffHigh, src, kCutoffHigh, 0, lowpass_1);
+    cv::addWeighted(lowpass_2, 1 - kCutoffLow, src, kCutoffLow, 0, lowpass_2);
+    cv::subtract(lowpass_1, lowpass_2, dst);
+    dst = dst * kGain;
+    if (src.channels() == 3)
+        cv::multiply(dst, cv::Scalar(1.0, kChrom, kChrom), dst);
+}
+
+// src is a view into a wider Mat when padded, so rows are not merged into one run
+void checkKernel(int width, int height, int cn, bool padded)
+{
+    const int type = CV_MAKETYPE(CV_32F, cn);
+    cv::Mat storage(height, width + (padded ? 3 : 0), type);
+    cv::Mat src = storage(cv::Rect(0, 0, width, height));
+
+    cv::RNG rng(width * 131 + height * 7 + cn);
+    rng.fill(src, cv::RNG::UNIFORM, cv::Scalar::all(-50), cv::Scalar::all(50));
+    cv::Mat fused_1 = src.clone();
+    cv::Mat fused_2 = src.clone();
+    cv::Mat ref_1 = src.clone();
+    cv::Mat ref_2 = src.clone();
+    cv::Mat fused_dst;
+    cv::Mat ref_dst;
+
+    const float chrom_scale[3] = {1.0f, kChrom, kChrom};
+    double worst = 0;
+    for (int step = 0; step < 8; ++step)
+    {
+        rng.fill(src, cv::RNG::UNIFORM, cv::Scalar::all(-50), cv::Scalar::all(50));
+        fusedTemporalAmplify(src, fused_1, fused_2, fused_dst, kCutoffHigh, kCutoffLow, kGain, chrom_scale);
+        referenceStep(src, ref_1, ref_2, ref_dst);
+        worst = std::max(worst, test::maxDiff(fused_dst, ref_dst));
+        worst = std::max(worst, test::maxDiff(fused_1, ref_1));
+        worst = std::max(worst, test::maxDiff(fused_2, ref_2));
+    }
+
+    // Outputs are up to ~1000, the only difference is the order of the float multiplies
+    if (!CHECK_LE(worst, 1e-3))
+        std::cerr << "  width " << width << ", height " << height << ", " << cn << " channel(s)"
+                  << (padded ? ", padded rows" : "") << std::endl;
+}
+
+// States and output of the fixed-point kernel after a few frames, on threads threads
+void runFixed(int threads, cv::Mat& lowpass_1, cv::Mat& lowpass_2, cv::Mat& dst)
+{
+    const cv::Size size(61, 47);
+    cv::Mat src(size, CV_32FC3);
+    lowpass_1 = cv::Mat::zeros(size, CV_16SC3);
+    lowpass_2 = cv::Mat::zeros(size, CV_16SC3);
+
+    const int saved_threads = omp_get_max_threads();
+    omp_set_num_threads(threads);
+    cv::RNG rng(61);
+    const float chrom_scale[3] = {1.0f, kChrom, kChrom};
+    for (int frame = 0; frame < 8; ++frame)
+    {
+        rng.fill(src, cv::RNG::UNIFORM, cv::Scalar::all(-50), cv::Scalar::all(50));
+        fusedTemporalAmplifyFixed(src, lowpass_1, lowpass_2, dst, kCutoffHigh, kCutoffLow, kGain, chrom_scale,
+                                  frame);
+    }
+    omp_set_num_threads(saved_threads);
+}
+
+// The dither of an element does not depend on which thread rounds it
+void checkFixedThreads()
+{
+    cv::Mat serial_1, serial_2, serial_dst;
+    cv::Mat parallel_1, parallel_2, parallel_dst;
+    runFixed(1, serial_1, serial_2, serial_dst);
+    runFixed(4, parallel_1, parallel_2, parallel_dst);
+    CHECK(test::maxDiff(serial_1, parallel_1) == 0);
+    CHECK(test::maxDiff(serial_2, parallel_2) == 0);
+    CHECK(test::maxDiff(serial_dst, parallel_dst) == 0);
+}
+
+// Full pipeline with and without the fused kernel, on a frame whose pyramid
+// levels have odd widths
+void checkPipeline(bool luma_only)
+{
+    FrameStreamReader reader;
+    CHECK(reader.open("synthetic:2:2:12", STREAM_SYNTHETIC, cv::Size(45, 37), 30));
+
+    EulerianMotionMag fused;
+    EulerianMotionMag unfused;
+    EulerianMotionMag* instances[2] = {&fused, &unfused};
+    for (int i = 0; i < 2; ++i)
+    {
+        MotionMagConfig config;
+        config.levels = 4;
+        config.alpha = 20;
+        config.lambda_c = 4;
+        config.chrom_attenuation = kChrom;
+        config.luma_only = luma_only;
+        config.fused_kernel = (i == 0);
+        CHECK(instances[i]->init(config, reader.getSize()));
+    }
+
+    cv::Mat frame;
+    cv::Mat fused_output;
+    cv::Mat unfused_output;
+    double worst = 0;
+    while (reader.read(frame))
+    {
+        fused.process(frame, fused_output);
+        unfused.process(frame, unfused_output);
+        worst = std::max(worst, test::maxDiff(fused_output, unfused_output));
+    }
+
+    // Per level vs. after reconstruction attenuation only differs in float rounding
+    if (!CHECK_LE(worst, 1.0))
+        std::cerr << "  pipeline" << (luma_only ? ", luma only" : "") << std::endl;
+}
+
+}  // namespace
+
+int main()
+{
+    const int widths[] = {1, 2, 3, 5, 7, 13, 17, 64};
+    for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w)
+    {
+        for (int cn = 1; cn <= 3; cn += 2)
+        {
+            checkKernel(widths[w], 1, cn, false);
+            checkKernel(widths[w], 5, cn, false);
+            checkKernel(widths[w], 5, cn, true);
+        }
+    }
+
+    checkFixedThreads();
+    checkPipeline(false);
+    checkPipeline(true);
+
+    return test::testResult("test_motion_kernels");
+}
@@ -0,0 +1,205 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// A synthetic clip recorded into a PyramidCache and replayed (dequantized
+// pyramid, collapsed color image, processBands() without a source frame) gives
+// the output of a fresh run within the tolerance the README states, and a
+// change of levels, size, color space or source file invalidates the cache.
+
+#include "pyramid_cache.h"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "eulerian_motion_mag.h"
+#include "frame_stream.h"
+#include "run_modes.h"
+#include "test_util.h"
+
+namespace
+{
+
+const int kFrames = 30;
+const cv::Size kSize(96, 72);
+const double kFps = 30;
+
+// Replay of the cache against a fresh run: the README promises over 60 dB on
+// baby.mp4, the synthetic clip has sharper edges
+const double kMinPsnr = 50.0;
+const double kMaxError = 2.0;
+
+std::vector<cv::Mat> readFrames(const std::string& path)
+{
+    FrameStreamReader reader;
+    std::vector<cv::Mat> frames;
+    cv::Mat frame;
+    if (!CHECK(reader.open(path, STREAM_BGR, kSize, kFps)))
+        return frames;
+    while (reader.read(frame))
+        frames.push_back(frame.clone());
+    return frames;
+}
+
+bool writeClip(const std::string& path, int frames)
+{
+    FrameStreamReader reader;
+    FrameStreamWriter writer;
+    if (!reader.open("synthetic:2:2:" + std::to_string(frames), STREAM_SYNTHETIC, kSize, kFps) ||
+        !writer.open(path, STREAM_BGR, kSize, kFps))
+        return false;
+
+    bool ok = true;
+    cv::Mat frame;
+    while (reader.read(frame))
+        ok &= writer.write(frame);
+    writer.close();
+    return ok;
+}
+
+bool getKey(const std::string& clip, const cv::Size& size, const MotionMagConfig& config, PyramidCacheKey& key)
+{
+    return PyramidCache::getKey(clip, size, config.levels, config.color_space, config.fast_pyramid,
+                                config.fused_color, key);
+}
+
+void checkReplay(const std::string& clip, const std::string& cache_file, const MotionMagConfig& config)
+{
+    const std::vector<cv::Mat> frames = readFrames(clip);
+    if (!CHECK(static_cast<int>(frames.size()) == kFrames))
+        return;
+
+    PyramidCacheKey key;
+    if (!CHECK(getKey(clip, kSize, config, key)))
+        return;
+
+    // Fresh run, and a recording run through the recorder the runners use
+    EulerianMotionMag fresh;
+    EulerianMotionMag recorded;
+    PyramidCache cache;
+    CHECK(fresh.init(config, kSize));
+    CHECK(recorded.init(config, kSize));
+    std::string reason;
+    CHECK(!cache.openRead(cache_file, key, reason));
+    CHECK(reason == "missing");
+    if (!CHECK(cache.openWrite(cache_file, key)))
+        return;
+
+    PyramidCacheRecorder recorder(&recorded, &cache);
+    std::vector<cv::Mat> fresh_outputs(kFrames);
+    cv::Mat recorded_output;
+    for (int f = 0; f < kFrames; ++f)
+    {
+        fresh.process(frames[f], fresh_outputs[f]);
+        recorder.process(frames[f], recorded_output);
+        CHECK(test::maxDiff(fresh_outputs[f], recorded_output) == 0);
+    }
+    CHECK(cache.finish());
+
+    // Replay
+    PyramidCache replay;
+    if (!CHECK(replay.openRead(cache_file, key, reason)))
+        return;
+    CHECK(replay.getFrameCount() == kFrames);
+
+    EulerianMotionMag replayed;
+    CHECK(replayed.init(config, kSize));
+    std::vector<cv::Mat> pyramid;
+    cv::Mat image, output;
+    double min_psnr = 100;
+    double max_error = 0;
+    for (int f = 0; f < kFrames; ++f)
+    {
+        replay.getFrame(f, pyramid);
+        replayed.reconImgFromLaplacianPyramid(pyramid, config.levels, image);
+        replayed.processBands(image, pyramid, NULL, output);
+        min_psnr = std::min(min_psnr, test::psnr(fresh_outputs[f], output));
+        max_error = std::max(max_error, test::maxDiff(fresh_outputs[f], output));
+    }
+    std::cout << "replay (" << config.color_space << "): min PSNR " << min_psnr << " dB, max error " << max_error
+              << std::endl;
+    CHECK_LE(kMinPsnr, min_psnr);
+    CHECK_LE(max_error, kMaxError);
+}
+
+// Every key differing from the recorded one in one field is rejected as stale
+void checkInvalidation(const std::string& clip, const std::string& cache_file, const MotionMagConfig& config)
+{
+    PyramidCache cache;
+    PyramidCacheKey key;
+    std::string reason;
+    CHECK(getKey(clip, kSize, config, key));
+    CHECK(cache.openRead(cache_file, key, reason));
+
+    MotionMagConfig levels = config;
+    levels.levels = config.levels - 1;
+    CHECK(getKey(clip, kSize, levels, key));
+    reason.clear();
+    CHECK(!cache.openRead(cache_file, key, reason));
+    CHECK(reason == "stale");
+
+    CHECK(getKey(clip, cv::Size(kSize.width / 2, kSize.height / 2), config, key));
+    reason.clear();
+    CHECK(!cache.openRead(cache_file, key, reason));
+    CHECK(reason == "stale");
+
+    MotionMagConfig color_space = config;
+    color_space.color_space = (config.color_space == "lab") ? "yiq" : "lab";
+    CHECK(getKey(clip, kSize, color_space, key));
+    reason.clear();
+    CHECK(!cache.openRead(cache_file, key, reason));
+    CHECK(reason == "stale");
+
+    // The source file replaced by a longer clip
+    CHECK(writeClip(clip, kFrames + 1));
+    CHECK(getKey(clip, kSize, config, key));
+    reason.clear();
+    CHECK(!cache.openRead(cache_file, key, reason));
+    CHECK(reason == "stale");
+}
+
+}  // namespace
+
+int main()
+{
+    char dir[] = "/tmp/test_pyramid_cache.XXXXXX";
+    if (!CHECK(mkdtemp(dir) != NULL))
+        return test::testResult("test_pyramid_cache");
+    const std::string base(dir);
+    const std::string clip = base + "/clip.bgr";
+    const std::string cache_file = base + "/clip.pyr";
+
+    MotionMagConfig config;
+    config.levels = 4;
+    config.alpha = 20;
+    config.lambda_c = 8;
+
+    const char* color_spaces[2] = {"lab", "yiq"};
+    for (int i = 0; i < 2; ++i)
+    {
+        config.color_space = color_spaces[i];
+        if (CHECK(writeClip(clip, kFrames)))
+        {
+            checkReplay(clip, cache_file, config);
+            checkInvalidation(clip, cache_file, config);
+        }
+        unlink(cache_file.c_str());
+        unlink(clip.c_str());
+    }
+
+    rmdir(dir);
+    return test::testResult("test_pyramid_cache");
+}
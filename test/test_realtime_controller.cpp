@@ -0,0 +1,160 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// RealtimeController on synthetic cost sequences: stepping down after
+// REALTIME_DOWN_FRAMES slow frames, stepping up after REALTIME_UP_SEC of low
+// load, and no step up to a step that was too slow within REALTIME_RETRY_SEC.
+// A skipped frame has to leave the temporal filter where process() leaves it.
+
+#include "realtime_controller.h"
+
+#include <math.h>
+
+#include "eulerian_motion_mag.h"
+#include "frame_stream.h"
+#include "test_util.h"
+
+namespace
+{
+
+const double kFps = 30;
+const int kUpFrames = static_cast<int>(ceil(REALTIME_UP_SEC * kFps));
+const int kRetryFrames = static_cast<int>(ceil(REALTIME_RETRY_SEC * kFps));
+
+// Costs relative to the 33.3 ms budget
+const double kSlowMs = 1.2 * 1000 / kFps;
+const double kBusyMs = 0.7 * 1000 / kFps;  // between the two thresholds
+const double kIdleMs = 0.2 * 1000 / kFps;
+
+// Feeds cost_ms from frame first up to (not including) end, returns the frame at
+// which the step changed or -1
+int feed(RealtimeController& controller, int first, int end, double cost_ms)
+{
+    for (int f = first; f < end; ++f)
+        if (controller.update(f, cost_ms))
+            return f;
+    return -1;
+}
+
+void checkStepDown()
+{
+    RealtimeController controller;
+    controller.init(kFps, 3);
+    CHECK(controller.getStep() == 0);
+
+    // The average is over budget from the first frame, but the step only changes
+    // once it stayed there for REALTIME_DOWN_FRAMES frames
+    const int down = feed(controller, 0, 100, kSlowMs);
+    CHECK(down == REALTIME_DOWN_FRAMES - 1);
+    CHECK(controller.getStep() == 1);
+
+    // The frame count restarts with the step
+    const int down_again = feed(controller, down + 1, 100, kSlowMs);
+    CHECK(down_again == down + REALTIME_DOWN_FRAMES);
+    CHECK(controller.getStep() == 2);
+
+    // No step below the last one
+    CHECK(feed(controller, down_again + 1, 1000, kSlowMs) == -1);
+    CHECK(controller.getStep() == 2);
+}
+
+void checkRetryLockout()
+{
+    RealtimeController controller;
+    controller.init(kFps, 2);
+    const int down = feed(controller, 0, 100, kSlowMs);
+    CHECK(controller.getStep() == 1);
+
+    // Idle well past REALTIME_UP_SEC: step 0 was too slow at frame down, so it is
+    // not tried again before REALTIME_RETRY_SEC
+    const int up = feed(controller, down + 1, down + 2 * kRetryFrames, kIdleMs);
+    CHECK(up == down + kRetryFrames);
+    CHECK(controller.getStep() == 0);
+}
+
+void checkStepUp()
+{
+    RealtimeController controller;
+    controller.init(kFps, 3);
+    const int down = feed(controller, 0, 100, kSlowMs);
+    const int down_again = feed(controller, down + 1, 100, kSlowMs);
+    CHECK(controller.getStep() == 2);
+
+    // Busy but within budget until both lockouts are over: no change
+    const int idle_from = down_again + kRetryFrames + 1;
+    CHECK(feed(controller, down_again + 1, idle_from, kBusyMs) == -1);
+    CHECK(controller.getStep() == 2);
+
+    // Step 2 has run for long enough, so it goes up as soon as the average is low
+    const int up = feed(controller, idle_from, idle_from + 100, kIdleMs);
+    CHECK(up >= idle_from && up < idle_from + 10);
+    CHECK(controller.getStep() == 1);
+
+    // Step 1 has to run REALTIME_UP_SEC on its own first
+    const int up_again = feed(controller, up + 1, up + 10 * kUpFrames, kIdleMs);
+    CHECK(up_again == up + kUpFrames);
+    CHECK(controller.getStep() == 0);
+}
+
+// Frames 3 and 4 skipped in one run and processed in the other: the filter states
+// and every later output are the same
+void checkSkip()
+{
+    FrameStreamReader reader;
+    CHECK(reader.open("synthetic:2:2:10", STREAM_SYNTHETIC, cv::Size(64, 48), kFps));
+
+    MotionMagConfig config;
+    config.levels = 4;
+    config.alpha = 20;
+    config.lambda_c = 8;
+    EulerianMotionMag processed;
+    EulerianMotionMag skipped;
+    CHECK(processed.init(config, reader.getSize()));
+    CHECK(skipped.init(config, reader.getSize()));
+
+    cv::Mat frame;
+    cv::Mat processed_output;
+    cv::Mat skipped_output;
+    for (int f = 0; reader.read(frame); ++f)
+    {
+        processed.process(frame, processed_output);
+        if (f == 3 || f == 4)
+        {
+            skipped.skip(frame);
+            continue;
+        }
+        skipped.process(frame, skipped_output);
+        CHECK(test::maxDiff(processed_output, skipped_output) == 0);
+    }
+
+    CHECK(processed.getFrameNum() == skipped.getFrameNum());
+    for (size_t l = 0; l < processed.getLowpassState1().size(); ++l)
+    {
+        if (processed.getLowpassState1()[l].empty())
+            continue;
+        CHECK(test::maxDiff(processed.getLowpassState1()[l], skipped.getLowpassState1()[l]) == 0);
+        CHECK(test::maxDiff(processed.getLowpassState2()[l], skipped.getLowpassState2()[l]) == 0);
+    }
+}
+
+}  // namespace
+
+int main()
+{
+    checkStepDown();
+    checkRetryLockout();
+    checkStepUp();
+    checkSkip();
+
+    return test::testResult("test_realtime_controller");
+}
@@ -0,0 +1,156 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// SlidingDFTFilter against a DFT of the same window computed offline in double
+// precision, frame by frame for several windows, so that every row goes through
+// the exact refresh a few times and the recursion runs in between. The input
+// is an in-band and an out-of-band sinusoid on a DC offset, with a phase that
+// varies over the pixels; on bin frequencies the band passes the first one
+// unchanged and blocks the other.
+
+#include "temporal_filter.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "test_util.h"
+
+namespace
+{
+
+const int kWindow = 32;
+const int kBinLow = 3;
+const int kBinHigh = 5;
+
+struct Signal
+{
+    double dc;
+    double in_amplitude;
+    double in_bin;  // frequency in bins of the window
+    double out_amplitude;
+    double out_bin;
+};
+
+// Sample of pixel i at time t
+double sample(const Signal& signal, int i, int t)
+{
+    const double phase = 0.37 * i;
+    return signal.dc + signal.in_amplitude * cos(2 * M_PI * signal.in_bin * t / kWindow + phase) +
+           signal.out_amplitude * cos(2 * M_PI * signal.out_bin * t / kWindow + 2 * phase);
+}
+
+// Band-limited inverse DFT of the window ending at frame t, at its newest sample.
+// The window starts filled with frame 0, like init() leaves it
+double reference(const Signal& signal, int i, int t)
+{
+    double out = 0;
+    for (int k = kBinLow; k <= kBinHigh; ++k)
+    {
+        double re = 0;
+        double im = 0;
+        for (int m = 0; m < kWindow; ++m)
+        {
+            const double x = sample(signal, i, std::max(t - kWindow + 1 + m, 0));
+            re += x * cos(2 * M_PI * k * m / kWindow);
+            im -= x * sin(2 * M_PI * k * m / kWindow);
+        }
+        // S_k * e^(j2pi k (N-1)/N), real part
+        const double angle = 2 * M_PI * k * (kWindow - 1) / kWindow;
+        const double weight = (k == 0 || 2 * k == kWindow) ? 1.0 / kWindow : 2.0 / kWindow;
+        out += weight * (re * cos(angle) - im * sin(angle));
+    }
+    return out;
+}
+
+void fillFrame(const Signal& signal, int t, cv::Mat& frame)
+{
+    for (int y = 0; y < frame.rows; ++y)
+    {
+        float* row = frame.ptr<float>(y);
+        for (int x = 0; x < frame.cols * frame.channels(); ++x)
+            row[x] = static_cast<float>(sample(signal, y * frame.cols * frame.channels() + x, t));
+    }
+}
+
+// rows > window, so that the refresh slices have one or two rows
+void checkFilter(const Signal& signal, int cn, double tolerance)
+{
+    const cv::Size size(5, 45);
+    cv::Mat frame(size, CV_MAKETYPE(CV_32F, cn));
+    cv::Mat out;
+    SlidingDFTFilter filter(kWindow, kBinLow, kBinHigh);
+
+    fillFrame(signal, 0, frame);
+    filter.init(frame);
+
+    double worst = 0;
+    double worst_passband = 0;
+    for (int t = 1; t <= 5 * kWindow; ++t)
+    {
+        fillFrame(signal, t, frame);
+        filter.apply(frame, out);
+
+        const int len = size.width * cn;
+        for (int y = 0; y < size.height; ++y)
+        {
+            const float* row = out.ptr<float>(y);
+            for (int x = 0; x < len; ++x)
+            {
+                const int i = y * len + x;
+                worst = std::max(worst, fabs(row[x] - reference(signal, i, t)));
+
+                // Once the window has only the signal, on bin frequencies: the
+                // in-band sinusoid as is, nothing of the DC or the other one
+                if (t >= kWindow && signal.in_bin == floor(signal.in_bin) &&
+                    signal.out_bin == floor(signal.out_bin))
+                {
+                    const double passband = signal.in_amplitude *
+                                            cos(2 * M_PI * signal.in_bin * t / kWindow + 0.37 * i);
+                    worst_passband = std::max(worst_passband, fabs(row[x] - passband));
+                }
+            }
+        }
+    }
+
+    if (!CHECK_LE(worst, tolerance) || !CHECK_LE(worst_passband, tolerance))
+        std::cerr << "  in-band bin " << signal.in_bin << ", out-of-band bin " << signal.out_bin << ", " << cn
+                  << " channel(s)" << std::endl;
+}
+
+}  // namespace
+
+int main()
+{
+    // Amplitudes around 50 on an offset of 100: the bins reach a few thousand and
+    // the float recursion stays within about 7e-5 of the double DFT
+    const Signal on_bins = {100, 50, 4, 40, 9};
+    const Signal below_band = {100, 50, 4, 40, 1};
+    const Signal between_bins = {100, 50, 3.6, 40, 11.3};
+    for (int cn = 1; cn <= 3; cn += 2)
+    {
+        checkFilter(on_bins, cn, 5e-4);
+        checkFilter(below_band, cn, 5e-4);
+        checkFilter(between_bins, cn, 5e-4);
+    }
+
+    // The bin range for a band in Hz
+    int bin_low = 0;
+    int bin_high = 0;
+    CHECK(SlidingDFTFilter::getBandBins(kWindow, 30, 2.5, 5.0, bin_low, bin_high));
+    CHECK(bin_low == 3 && bin_high == 5);
+    CHECK(!SlidingDFTFilter::getBandBins(kWindow, 30, 1.0, 1.5, bin_low, bin_high));
+
+    return test::testResult("test_sliding_dft");
+}
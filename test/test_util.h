@@ -0,0 +1,87 @@
+//*****************************************************************************
+// Copyright 2016 Ramsundar K G. All Rights Reserved.
+//
+// This source code is licensed as defined by the LICENSE file found in the
+// root directory of this source tree.
+//
+// Author: Ramsundar K G (kgram007@gmail.com)
+//
+// This file is a part of C++ implementation of Eulerian Motion Magnification
+// adapted from https://github.com/wzpan/QtEVM
+//
+//*****************************************************************************
+
+// Minimal checks for the test executables: every failed check is reported with
+// its location, main() returns testResult() so that ctest sees a non-zero exit.
+
+#ifndef TEST_UTIL_H_
+#define TEST_UTIL_H_
+
+#include <math.h>
+
+#include <iostream>
+
+#include <opencv2/core/core.hpp>
+
+namespace test
+{
+
+inline int& failures()
+{
+    static int count = 0;
+    return count;
+}
+
+inline bool check(bool ok, const char* expr, const char* file, int line)
+{
+    if (!ok)
+    {
+        std::cerr << file << ":" << line << ": check failed: " << expr << std::endl;
+        failures()++;
+    }
+    return ok;
+}
+
+template <typename A, typename B>
+inline bool checkLE(const A& a, const B& b, const char* expr, const char* file, int line)
+{
+    if (!(a <= b))
+    {
+        std::cerr << file << ":" << line << ": check failed: " << expr << " (" << a << " > " << b << ")" << std::endl;
+        failures()++;
+        return false;
+    }
+    return true;
+}
+
+// Largest absolute difference of two Mats of the same size and type
+inline double maxDiff(const cv::Mat& a, const cv::Mat& b)
+{
+    return cv::norm(a, b, cv::NORM_INF);
+}
+
+// PSNR of 8-bit frames, 0 for identical frames is reported as 100 dB
+inline double psnr(const cv::Mat& a, const cv::Mat& b)
+{
+    const double l2 = cv::norm(a, b, cv::NORM_L2);
+    if (l2 == 0)
+        return 100;
+    const double mse = l2 * l2 / (static_cast<double>(a.total()) * a.channels());
+    return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+inline int testResult(const char* name)
+{
+    if (failures() == 0)
+        std::cout << name << ": passed" << std::endl;
+    else
+        std::cout << name << ": " << failures() << " check(s) failed" << std::endl;
+    return failures() == 0 ? 0 : 1;
+}
+
+}  // namespace test
+
+#define CHECK(expr) test::check((expr), #expr, __FILE__, __LINE__)
+#define CHECK_LE(a, b) test::checkLE((a), (b), #a " <= " #b, __FILE__, __LINE__)
+
+#endif  // TEST_UTIL_H_